@@ -30,4 +30,22 @@ float FirstOrderFilterIIR::process(float input) {
 	lastY_ = output;
 	
 	return output;
+}
+
+void FirstOrderFilterIIR::processBlock(const float* in, float* out, unsigned int n) {
+	// Local copies of coefficients and state for the whole block
+	const float b0 = coeffB0_, b1 = coeffB1_, a1 = coeffA1_;
+	float x1 = lastX_, y1 = lastY_;
+	
+	for (unsigned int i = 0; i < n; i++) {
+		float input = in[i];
+		float output = b0 * input + b1 * x1 - a1 * y1;
+		x1 = input;
+		y1 = output;
+		out[i] = output;
+	}
+	
+	// Save filter state
+	lastX_ = x1;
+	lastY_ = y1;
 }
\ No newline at end of file
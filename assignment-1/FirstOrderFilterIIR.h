@@ -18,6 +18,9 @@ public:
 	// To be called once for each sample
 	float process(float input);
 	
+	// Filters n samples (in and out may be the same buffer)
+	void processBlock(const float* in, float* out, unsigned int n);
+	
 	// Destructor
 	~FirstOrderFilterIIR() {}
 	
@@ -0,0 +1,71 @@
+/***** LadderCascade.cpp *****/
+/* Implementation of the resonant four-stage ladder of the synth filter
+ *
+ * ECS7012P - Queen Mary University of London
+ * Assignment 1, Max Tamussino
+ */
+
+#include "LadderCascade.h"
+#include <libraries/math_neon/math_neon.h>
+
+LadderCascade::LadderCascade() {
+	// Pass through until the coefficients are set
+	set_coefficients(1.0, 0.0, 0.0, 0.0);
+	
+	// Zero state at beginning
+	lastX_ = 0.0;
+	for (unsigned int i = 0; i < kStages; i++) {
+		lastY_[i] = 0.0;
+	}
+}
+
+void LadderCascade::set_coefficients(float coeffB0, float coeffB1, float coeffA1, float gainRes) {
+	// Filter coefficients and feedback gain
+	coeffB0_ = coeffB0;
+	coeffB1_ = coeffB1;
+	coeffA1_ = coeffA1;
+	gainRes_ = gainRes;
+}
+
+float LadderCascade::process(float input) {
+	float output;
+	processBlock(&input, &output, 1);
+	return output;
+}
+
+void LadderCascade::processBlock(const float* in, float* out, unsigned int n) {
+	// Local copies, so that the compiler can keep them in registers for
+	// the whole block
+	const float b0 = coeffB0_, b1 = coeffB1_, a1 = coeffA1_;
+	const float feedback = 4 * gainRes_;
+	float x0 = lastX_;
+	float y0 = lastY_[0], y1 = lastY_[1], y2 = lastY_[2], y3 = lastY_[3];
+	
+	for (unsigned int i = 0; i < n; i++) {
+		// Feedback path and nonlinearity (same arithmetic as the loop over
+		// the single filters, so the results are identical)
+		float input = in[i];
+		float x = input - feedback * (y3 - 0.5 * input);
+		x = tanhf_neon(x);
+		
+		// The four stages, each one's last input being the previous
+		// stage's last output
+		float z0 = b0 * x + b1 * x0 - a1 * y0;
+		float z1 = b0 * z0 + b1 * y0 - a1 * y1;
+		float z2 = b0 * z1 + b1 * y1 - a1 * y2;
+		float z3 = b0 * z2 + b1 * y2 - a1 * y3;
+		x0 = x;
+		y0 = z0;
+		y1 = z1;
+		y2 = z2;
+		y3 = z3;
+		out[i] = z3;
+	}
+	
+	// Save filter state
+	lastX_ = x0;
+	lastY_[0] = y0;
+	lastY_[1] = y1;
+	lastY_[2] = y2;
+	lastY_[3] = y3;
+}
\ No newline at end of file
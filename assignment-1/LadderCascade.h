@@ -0,0 +1,47 @@
+/***** LadderCascade.h *****/
+/* Implementation of the resonant four-stage ladder of the synth filter:
+ * the feedback path with its tanh nonlinearity and the four first-order
+ * sections in one object, so that a whole block is filtered with the
+ * coefficients and the state held in local variables
+ *
+ * ECS7012P - Queen Mary University of London
+ * Assignment 1, Max Tamussino
+ */
+
+#pragma once
+
+class LadderCascade {
+public:
+	static const unsigned int kStages = 4;
+	
+	// Constructor
+	LadderCascade();
+	
+	// Sets new coefficients of all stages and the resonance gain of the
+	// feedback path
+	void set_coefficients(float coeffB0, float coeffB1, float coeffA1, float gainRes);
+	
+	// To be called once for each sample
+	float process(float input);
+	
+	// Filters n samples (in and out may be the same buffer)
+	void processBlock(const float* in, float* out, unsigned int n);
+	
+	// Output of the last stage, which is fed back
+	float last_output() const { return lastY_[kStages - 1]; }
+	
+	// Destructor
+	~LadderCascade() {}
+	
+private:
+	// Coefficients (the same for all stages)
+	float coeffB0_;
+	float coeffB1_;
+	float coeffA1_;
+	float gainRes_;
+	
+	// State: last input of the first stage and last output of every stage
+	// (which is the last input of the next one)
+	float lastX_;
+	float lastY_[kStages];
+};
\ No newline at end of file
@@ -0,0 +1,125 @@
+/***** LadderParameters.cpp *****/
+/* Implementation of the parameter layer of the ladder
+ *
+ * ECS7012P - Queen Mary University of London
+ * Assignment 1, Max Tamussino
+ */
+
+#include "LadderParameters.h"
+#include <cmath>
+
+// Differences below which a smoothed value jumps to its target
+static const float kOctaveTolerance = 1e-4;
+static const float kResonanceTolerance = 1e-4;
+
+// Table over the cutoff range at this rate (NOT REAL-TIME SAFE, use at
+// beginning)
+bool LadderParameters::setup(float sampleRate, float smoothingTime) {
+	if (kMaxCutoff * sampleRate <= 2 * kMinCutoff) {
+		return false;
+	}
+	maxOctave_ = log2f(kMaxCutoff * sampleRate / kMinCutoff);
+	const unsigned int points = ceilf(maxOctave_ * kPointsPerOctave) + 2;
+	gainTable_.resize(points);
+	resonanceTable_.resize(points);
+	for (unsigned int i = 0; i < points; i++) {
+		float omega = 2 * M_PI * kMinCutoff * powf(2.0, (float)i / kPointsPerOctave) / sampleRate;
+		gainTable_[i] = cutoff_gain(omega);
+		resonanceTable_[i] = resonance_gain(omega);
+	}
+
+	// Smoothing once per sub-block
+	smoothing_ = 1.0 - expf(-(float)kSubBlockSize / (smoothingTime * sampleRate));
+
+	lastCutoff_ = -1;
+	lastResonance_ = -1;
+	changed_ = true;
+	first_ = true;
+	return true;
+}
+
+void LadderParameters::set_cutoff(float frequencyHz) {
+	if (frequencyHz == lastCutoff_) {
+		return;
+	}
+	lastCutoff_ = frequencyHz;
+	targetOctave_ = log2f(fmaxf(frequencyHz, kMinCutoff) / kMinCutoff);
+	if (targetOctave_ > maxOctave_) {
+		targetOctave_ = maxOctave_;
+	}
+	if (first_) {
+		octave_ = targetOctave_;
+	}
+	changed_ = true;
+}
+
+void LadderParameters::set_resonance(float resonance) {
+	if (resonance == lastResonance_) {
+		return;
+	}
+	lastResonance_ = resonance;
+	targetResonance_ = resonance;
+	if (first_) {
+		resonance_ = targetResonance_;
+	}
+	changed_ = true;
+}
+
+float LadderParameters::cutoff() const {
+	return kMinCutoff * powf(2.0, octave_);
+}
+
+// Same models as the original calculate_coefficients() of render.cpp
+float LadderParameters::cutoff_gain(float omega) {
+	float omega2 = omega * omega;
+	float omega3 = omega2 * omega;
+	float omega4 = omega3 * omega;
+	return 0.9892 * omega - 0.4342 * omega2 + 0.1381 * omega3 - 0.0202 * omega4;
+}
+
+float LadderParameters::resonance_gain(float omega) {
+	float omega2 = omega * omega;
+	float omega3 = omega2 * omega;
+	return 1.0029 + 0.0526 * omega - 0.0926 * omega2 + 0.0218 * omega3;
+}
+
+void LadderParameters::update_coefficients(LadderCascade& ladder) {
+	// Linear interpolation between the two table points around the cutoff
+	float position = octave_ * kPointsPerOctave;
+	unsigned int index = position;
+	float fraction = position - index;
+	float g = gainTable_[index] + fraction * (gainTable_[index + 1] - gainTable_[index]);
+	float gRes = resonanceTable_[index] + fraction * (resonanceTable_[index + 1] - resonanceTable_[index]);
+	ladder.set_coefficients(g * 1.0 / 1.3, g * 0.3 / 1.3, g - 1.0, resonance_ * gRes);
+}
+
+void LadderParameters::processBlock(LadderCascade& ladder, const float* in, float* out, unsigned int n) {
+	first_ = false;
+
+	// Nothing moves: the coefficients stay unless a target was set (and
+	// taken at once) since the last block
+	if (settled()) {
+		if (changed_) {
+			update_coefficients(ladder);
+			changed_ = false;
+		}
+		ladder.processBlock(in, out, n);
+		return;
+	}
+
+	// Smoothing, with new coefficients for every sub-block
+	for (unsigned int start = 0; start < n; start += kSubBlockSize) {
+		octave_ += smoothing_ * (targetOctave_ - octave_);
+		resonance_ += smoothing_ * (targetResonance_ - resonance_);
+		if (fabsf(targetOctave_ - octave_) < kOctaveTolerance) {
+			octave_ = targetOctave_;
+		}
+		if (fabsf(targetResonance_ - resonance_) < kResonanceTolerance) {
+			resonance_ = targetResonance_;
+		}
+		update_coefficients(ladder);
+		unsigned int length = n - start < kSubBlockSize ? n - start : kSubBlockSize;
+		ladder.processBlock(in + start, out + start, length);
+	}
+	changed_ = false;
+}
\ No newline at end of file
@@ -0,0 +1,85 @@
+/***** LadderParameters.h *****/
+/* Implementation of the parameter layer of the ladder: cutoff and
+ * resonance are smoothed towards the values of the sliders, and the
+ * coefficients are only calculated again when they move.
+ *
+ * The coefficients come from a table of the two polynomial models (the
+ * cutoff gain g and the factor of the resonance gain), calculated at setup
+ * for the sample rate with kPointsPerOctave points per octave of cutoff
+ * and interpolated linearly. The cutoff is smoothed in octaves, so that a
+ * change sweeps at the same speed over every octave. While it moves, the
+ * block is filtered in sub-blocks of kSubBlockSize samples with new
+ * coefficients for each one, instead of a step once per block.
+ *
+ * ECS7012P - Queen Mary University of London
+ * Assignment 1, Max Tamussino
+ */
+
+#pragma once
+
+#include <vector>
+#include "LadderCascade.h"
+
+class LadderParameters {
+public:
+	static const unsigned int kPointsPerOctave = 32;	// Table resolution
+	static const unsigned int kSubBlockSize = 8;		// Samples per coefficient update while smoothing
+	static constexpr float kMinCutoff = 10.0;			// Lowest cutoff of the table (Hz)
+	static constexpr float kMaxCutoff = 0.25;			// Highest cutoff of the table, relative to the sample rate
+	static constexpr float kSmoothingTime = 0.01;		// Time constant of the smoothing (s)
+
+	// Constructor
+	LadderParameters() {}
+
+	// Setup (NOT REAL-TIME SAFE) of the table for the rate the ladder runs
+	// at. Returns false if the sample rate is too low for the table.
+	bool setup(float sampleRate, float smoothingTime = kSmoothingTime);
+
+	// New targets, ignored if they have not changed. The first values after
+	// setup are taken at once.
+	void set_cutoff(float frequencyHz);
+	void set_resonance(float resonance);
+
+	// Filters n samples through the ladder, with new coefficients for every
+	// sub-block while the parameters move and none while they stay
+	void processBlock(LadderCascade& ladder, const float* in, float* out, unsigned int n);
+
+	// Smoothed cutoff (Hz) and resonance, and whether they reached their
+	// targets
+	float cutoff() const;
+	float resonance() const { return resonance_; }
+	bool settled() const { return octave_ == targetOctave_ && resonance_ == targetResonance_; }
+
+	// Polynomial models of the cutoff gain g and of the resonance gain
+	// (for a resonance of 1), omega being the cutoff in radians per sample
+	static float cutoff_gain(float omega);
+	static float resonance_gain(float omega);
+
+	// Destructor
+	~LadderParameters() {}
+
+private:
+	// Sets the coefficients of the ladder from the table
+	void update_coefficients(LadderCascade& ladder);
+
+	// Table of both models over octaves of cutoff from kMinCutoff on
+	std::vector<float> gainTable_;
+	std::vector<float> resonanceTable_;
+	float maxOctave_ = 0;
+
+	// Smoothing factor per sub-block
+	float smoothing_ = 1.0;
+
+	// Last values set, their targets and the smoothed values (the cutoff in
+	// octaves above kMinCutoff)
+	float lastCutoff_ = -1;
+	float lastResonance_ = -1;
+	float targetOctave_ = 0;
+	float targetResonance_ = 0;
+	float octave_ = 0;
+	float resonance_ = 0;
+
+	// Whether the next block needs coefficients even if settled
+	bool changed_ = true;
+	bool first_ = true;
+};
\ No newline at end of file
@@ -0,0 +1,204 @@
+/***** Oversampler.cpp *****/
+/* Implementation of oversampling with half-band FIR filters in polyphase form
+ *
+ * ECS7012P - Queen Mary University of London
+ * Assignment 1, Max Tamussino
+ */
+
+#include "Oversampler.h"
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+// Zeroth order modified Bessel function of the first kind (for the Kaiser window)
+static double bessel_i0(double x) {
+	double sum = 1.0, term = 1.0;
+	for (int k = 1; k < 50; k++) {
+		term *= (x / (2.0 * k)) * (x / (2.0 * k));
+		sum += term;
+		if (term < 1e-12 * sum) break;
+	}
+	return sum;
+}
+
+// Kaiser-windowed half-band lowpass with the passband edge relative to the
+// sample rate it runs at. Stores one tap of each symmetric pair of the
+// non-zero taps (the centre tap is 0.5) and returns the number of taps.
+static unsigned int design_half_band(float passband, float attenuationDb, std::vector<float>& pairCoefficients) {
+	// Kaiser estimate of the length for the transition band between the
+	// passband edge and its mirror image around a quarter of the sample
+	// rate, rounded up to 4k+3 so that the outer taps are non-zero
+	double transition = 2.0 * M_PI * (0.5 - 2.0 * passband);
+	int length = ceil((attenuationDb - 7.95) / (2.285 * transition)) + 1;
+	if (length < 3) length = 3;
+	while (length % 4 != 3) length++;
+	
+	double beta = 0;
+	if (attenuationDb > 50) beta = 0.1102 * (attenuationDb - 8.7);
+	else if (attenuationDb > 21) beta = 0.5842 * pow(attenuationDb - 21, 0.4) + 0.07886 * (attenuationDb - 21);
+	
+	// Windowed sinc with the cutoff at a quarter of the sample rate,
+	// normalised to unity gain at DC
+	int centre = (length - 1) / 2;
+	pairCoefficients.clear();
+	double sum = 0;
+	for (int j = 0; j < centre; j += 2) {
+		double t = j - centre;
+		double window = bessel_i0(beta * sqrt(1.0 - (t / centre) * (t / centre))) / bessel_i0(beta);
+		double h = sin(M_PI * t / 2.0) / (M_PI * t) * window;
+		pairCoefficients.push_back(h);
+		sum += 2 * h;
+	}
+	for (unsigned int k = 0; k < pairCoefficients.size(); k++) {
+		pairCoefficients[k] *= 0.5 / sum;
+	}
+	return length;
+}
+
+
+void HalfBandUpsampler::setup(float passband, float attenuationDb, unsigned int maxBlockSize) {
+	numTaps_ = design_half_band(passband, attenuationDb, pairCoefficients_);
+	
+	// The zero-stuffed input halves the gain, so the taps are doubled
+	for (unsigned int k = 0; k < pairCoefficients_.size(); k++) {
+		pairCoefficients_[k] *= 2;
+	}
+	
+	// History of (numTaps - 1) / 2 input samples, then the block
+	historyLength_ = (numTaps_ - 1) / 2;
+	history_.resize(historyLength_ + maxBlockSize);
+	evenOutputs_.resize(maxBlockSize);
+	reset();
+}
+
+void HalfBandUpsampler::reset() {
+	std::fill(history_.begin(), history_.end(), 0);
+}
+
+void HalfBandUpsampler::process(const float* input, unsigned int frames, float* output) {
+	// Append the block to the history
+	float* x = history_.data();
+	memcpy(x + historyLength_, input, frames * sizeof(float));
+	
+	// Even outputs from the symmetric pairs, each pair as a whole pass over
+	// the block so that the inner loops vectorise
+	float* even = evenOutputs_.data();
+	for (unsigned int m = 0; m < frames; m++) {
+		even[m] = 0;
+	}
+	for (unsigned int k = 0; k < pairCoefficients_.size(); k++) {
+		const float coefficient = pairCoefficients_[k];
+		const float* newer = x + historyLength_ - k;
+		const float* older = x + k;
+		for (unsigned int m = 0; m < frames; m++) {
+			even[m] += coefficient * (newer[m] + older[m]);
+		}
+	}
+	
+	// Odd outputs are the input, delayed to the centre tap
+	const float* delayed = x + historyLength_ - (historyLength_ - 1) / 2;
+	for (unsigned int m = 0; m < frames; m++) {
+		output[2 * m] = even[m];
+		output[2 * m + 1] = delayed[m];
+	}
+	
+	// History for the next block
+	memmove(x, x + frames, historyLength_ * sizeof(float));
+}
+
+
+void HalfBandDownsampler::setup(float passband, float attenuationDb, unsigned int maxBlockSize) {
+	numTaps_ = design_half_band(passband, attenuationDb, pairCoefficients_);
+	historyLength_ = numTaps_ - 1;
+	history_.resize(historyLength_ + 2 * maxBlockSize);
+	reset();
+}
+
+void HalfBandDownsampler::reset() {
+	std::fill(history_.begin(), history_.end(), 0);
+}
+
+void HalfBandDownsampler::process(const float* input, unsigned int frames, float* output) {
+	// Append the block to the history
+	float* x = history_.data();
+	memcpy(x + historyLength_, input, 2 * frames * sizeof(float));
+	
+	// Only every second output is computed: the centre tap, then the
+	// symmetric pairs, each as a whole pass over the outputs
+	const float* centre = x + historyLength_ / 2 + 1;
+	for (unsigned int m = 0; m < frames; m++) {
+		output[m] = 0.5f * centre[2 * m];
+	}
+	for (unsigned int k = 0; k < pairCoefficients_.size(); k++) {
+		const float coefficient = pairCoefficients_[k];
+		const float* newer = x + historyLength_ + 1 - 2 * k;
+		const float* older = x + 1 + 2 * k;
+		for (unsigned int m = 0; m < frames; m++) {
+			output[m] += coefficient * (newer[2 * m] + older[2 * m]);
+		}
+	}
+	
+	// History for the next block
+	memmove(x, x + 2 * frames, historyLength_ * sizeof(float));
+}
+
+
+bool Oversampler::setup(unsigned int factor, unsigned int maxBlockSize, float passband, float attenuationDb) {
+	if (factor != 1 && factor != 2 && factor != 4 && factor != 8) return false;
+	factor_ = factor;
+	
+	unsigned int numStages = 0;
+	while ((1u << numStages) < factor) numStages++;
+	upStages_.resize(numStages);
+	downStages_.resize(numStages);
+	
+	// Passband edge relative to the rate of every stage: up stage s runs
+	// from 2^s to 2^(s+1) times the base rate, down stage s the other way
+	// round, from the highest rate down
+	float passbandEdge = passband * 0.5;
+	for (unsigned int s = 0; s < numStages; s++) {
+		upStages_[s].setup(passbandEdge / (2u << s), attenuationDb, maxBlockSize << s);
+		downStages_[s].setup(passbandEdge / (factor >> s), attenuationDb, maxBlockSize * (factor >> (s + 1)));
+	}
+	
+	// Intermediate buffers for the largest block
+	scratch_[0].resize(maxBlockSize * factor);
+	scratch_[1].resize(maxBlockSize * factor);
+	return true;
+}
+
+void Oversampler::reset() {
+	for (unsigned int s = 0; s < upStages_.size(); s++) {
+		upStages_[s].reset();
+		downStages_[s].reset();
+	}
+}
+
+void Oversampler::upsample(const float* input, unsigned int frames, float* output) {
+	if (upStages_.empty()) {
+		memmove(output, input, frames * sizeof(float));
+		return;
+	}
+	
+	// Alternate between the scratch buffers, the last stage writes the output
+	const float* in = input;
+	for (unsigned int s = 0; s < upStages_.size(); s++) {
+		float* out = (s + 1 == upStages_.size()) ? output : scratch_[s % 2].data();
+		upStages_[s].process(in, frames << s, out);
+		in = out;
+	}
+}
+
+void Oversampler::downsample(const float* input, unsigned int frames, float* output) {
+	if (downStages_.empty()) {
+		memmove(output, input, frames * sizeof(float));
+		return;
+	}
+	
+	const float* in = input;
+	for (unsigned int s = 0; s < downStages_.size(); s++) {
+		float* out = (s + 1 == downStages_.size()) ? output : scratch_[s % 2].data();
+		downStages_[s].process(in, frames * (factor_ >> (s + 1)), out);
+		in = out;
+	}
+}
\ No newline at end of file
@@ -0,0 +1,117 @@
+/***** Oversampler.h *****/
+/* Implementation of 2x, 4x and 8x oversampling around a nonlinear
+ * process: cascades of half-band FIR filters in polyphase form for the
+ * upsampling and the downsampling, processing whole blocks. A half-band
+ * filter has only every second tap non-zero, so upsampling by 2 computes
+ * one output of every pair with the symmetric taps and copies the other
+ * one from the delayed input, and downsampling only computes the outputs
+ * that are kept.
+ *
+ * Each stage only has to keep images and aliases out of the passband of
+ * the base rate, so the stages at the higher rates get a wide transition
+ * band and very few taps.
+ *
+ * ECS7012P - Queen Mary University of London
+ * Assignment 1, Max Tamussino
+ */
+
+#pragma once
+#include <vector>
+
+// One half-band stage of the upsampling, from the input rate to twice it
+class HalfBandUpsampler {
+public:
+	// Constructor
+	HalfBandUpsampler() {}
+	
+	// Designs the filter (NOT REAL-TIME SAFE), with the passband edge
+	// relative to the output sample rate
+	void setup(float passband, float attenuationDb, unsigned int maxBlockSize);
+	
+	// Upsamples frames input samples to 2 * frames output samples
+	void process(const float* input, unsigned int frames, float* output);
+	
+	// Clears the filter state
+	void reset();
+	
+	unsigned int num_taps() const { return numTaps_; }
+	
+	// Destructor
+	~HalfBandUpsampler() {}
+	
+private:
+	// Symmetric pairs of the non-zero taps, each stored once
+	unsigned int numTaps_ = 0;
+	std::vector<float> pairCoefficients_;
+	
+	// Input history followed by the current block, and the filtered phase
+	std::vector<float> history_;
+	unsigned int historyLength_ = 0;
+	std::vector<float> evenOutputs_;
+};
+
+// One half-band stage of the downsampling, from the input rate to half of it
+class HalfBandDownsampler {
+public:
+	// Constructor
+	HalfBandDownsampler() {}
+	
+	// Designs the filter (NOT REAL-TIME SAFE), with the passband edge
+	// relative to the input sample rate
+	void setup(float passband, float attenuationDb, unsigned int maxBlockSize);
+	
+	// Downsamples 2 * frames input samples to frames output samples
+	void process(const float* input, unsigned int frames, float* output);
+	
+	// Clears the filter state
+	void reset();
+	
+	unsigned int num_taps() const { return numTaps_; }
+	
+	// Destructor
+	~HalfBandDownsampler() {}
+	
+private:
+	unsigned int numTaps_ = 0;
+	std::vector<float> pairCoefficients_;
+	std::vector<float> history_;
+	unsigned int historyLength_ = 0;
+};
+
+class Oversampler {
+public:
+	static const unsigned int kMaxFactor = 8;
+	
+	// Constructor
+	Oversampler() {}
+	
+	// Sets up the stages for a factor of 1, 2, 4 or 8 (NOT REAL-TIME SAFE).
+	// The passband is given as a fraction of the Nyquist frequency of the
+	// base rate. Returns false for other factors.
+	bool setup(unsigned int factor, unsigned int maxBlockSize, float passband = 0.8, float attenuationDb = 70);
+	
+	// Upsamples frames samples to frames * factor samples
+	void upsample(const float* input, unsigned int frames, float* output);
+	
+	// Downsamples frames * factor samples to frames samples
+	void downsample(const float* input, unsigned int frames, float* output);
+	
+	// Clears the state of all stages
+	void reset();
+	
+	unsigned int factor() const { return factor_; }
+	unsigned int num_stages() const { return upStages_.size(); }
+	const HalfBandUpsampler& up_stage(unsigned int n) const { return upStages_[n]; }
+	const HalfBandDownsampler& down_stage(unsigned int n) const { return downStages_[n]; }
+	
+	// Destructor
+	~Oversampler() {}
+	
+private:
+	unsigned int factor_ = 1;
+	std::vector<HalfBandUpsampler> upStages_;
+	std::vector<HalfBandDownsampler> downStages_;
+	
+	// Outputs of the intermediate stages
+	std::vector<float> scratch_[2];
+};
\ No newline at end of file
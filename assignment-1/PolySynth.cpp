@@ -0,0 +1,257 @@
+/***** PolySynth.cpp *****/
+/* Implementation of the polyphonic synth
+ *
+ * ECS7012P - Queen Mary University of London
+ * Assignment 1, Max Tamussino
+ */
+
+#include "PolySynth.h"
+#include "LadderParameters.h"
+#include <cmath>
+#include <cstring>
+
+// Setup of the arrays of all voices (NOT REAL-TIME SAFE, use at beginning)
+bool PolySynth::setup(float sampleRate, unsigned int numVoices, const std::vector<float>& table,
+					  unsigned int maxBlockSize) {
+	if (numVoices == 0 || numVoices > kMaxVoices || table.empty()) {
+		return false;
+	}
+	sampleRate_ = sampleRate;
+	numVoices_ = (numVoices + kLanes - 1) / kLanes * kLanes;
+	maxBlockSize_ = maxBlockSize;
+	attackRate_ = 1.0 - expf(-1.0 / (kAttackTime * sampleRate));
+	releaseRate_ = 1.0 - expf(-1.0 / (kReleaseTime * sampleRate));
+
+	table_ = table;
+	table_.push_back(table[0]);
+
+	note_.assign(numVoices_, -1);
+	started_.assign(numVoices_, 0);
+	noteCounter_ = 0;
+	phase_.assign(numVoices_, 0);
+	increment_.assign(numVoices_, 0);
+	velocity_.assign(numVoices_, 0);
+	envelope_.assign(numVoices_, 0);
+	target_.assign(numVoices_, 0);
+	rate_.assign(numVoices_, 0);
+	coeffB0_.assign(numVoices_, 1.0);
+	coeffB1_.assign(numVoices_, 0);
+	coeffA1_.assign(numVoices_, 0);
+	feedback_.assign(numVoices_, 0);
+	lastX_.assign(numVoices_, 0);
+	lastY0_.assign(numVoices_, 0);
+	lastY1_.assign(numVoices_, 0);
+	lastY2_.assign(numVoices_, 0);
+	lastY3_.assign(numVoices_, 0);
+	keyFactor_.assign(numVoices_, 1.0);
+	mix_.assign(maxBlockSize * kLanes, 0);
+
+	for (unsigned int voice = 0; voice < numVoices_; voice++) {
+		calculate_coefficients(voice);
+	}
+	return true;
+}
+
+void PolySynth::note_on(int note, int velocity) {
+	if (velocity == 0) {
+		note_off(note);
+		return;
+	}
+	if (numVoices_ == 0) {
+		return;
+	}
+
+	// A free voice, else the oldest released one, else the oldest one
+	unsigned int chosen = 0;
+	int chosenRank = -1;
+	for (unsigned int voice = 0; voice < numVoices_; voice++) {
+		int rank = note_[voice] < 0 ? 2 : target_[voice] == 0 ? 1 : 0;
+		if (rank > chosenRank || (rank == chosenRank && started_[voice] < started_[chosen])) {
+			chosen = voice;
+			chosenRank = rank;
+		}
+	}
+
+	// Start the voice from zero state
+	float frequency = 440.0 * powf(2.0, (note - 69) / 12.0);
+	note_[chosen] = note;
+	started_[chosen] = noteCounter_++;
+	phase_[chosen] = 0;
+	increment_[chosen] = (table_.size() - 1) * frequency / sampleRate_;
+	velocity_[chosen] = velocity / 127.0;
+	envelope_[chosen] = 0;
+	target_[chosen] = 1.0;
+	rate_[chosen] = attackRate_;
+	lastX_[chosen] = 0;
+	lastY0_[chosen] = 0;
+	lastY1_[chosen] = 0;
+	lastY2_[chosen] = 0;
+	lastY3_[chosen] = 0;
+	keyFactor_[chosen] = powf(2.0, keyTracking_ * (note - 60) / 12.0);
+	calculate_coefficients(chosen);
+}
+
+void PolySynth::note_off(int note) {
+	for (unsigned int voice = 0; voice < numVoices_; voice++) {
+		if (note_[voice] == note && target_[voice] != 0) {
+			target_[voice] = 0;
+			rate_[voice] = releaseRate_;
+		}
+	}
+}
+
+void PolySynth::all_notes_off() {
+	for (unsigned int voice = 0; voice < numVoices_; voice++) {
+		if (note_[voice] >= 0) {
+			target_[voice] = 0;
+			rate_[voice] = releaseRate_;
+		}
+	}
+}
+
+void PolySynth::set_filter(float cutoffHz, float resonance, float keyTracking) {
+	if (cutoffHz == cutoff_ && resonance == resonance_ && keyTracking == keyTracking_) {
+		return;
+	}
+	if (keyTracking != keyTracking_) {
+		keyTracking_ = keyTracking;
+		for (unsigned int voice = 0; voice < numVoices_; voice++) {
+			if (note_[voice] >= 0) {
+				keyFactor_[voice] = powf(2.0, keyTracking_ * (note_[voice] - 60) / 12.0);
+			}
+		}
+	}
+	cutoff_ = cutoffHz;
+	resonance_ = resonance;
+	for (unsigned int voice = 0; voice < numVoices_; voice++) {
+		calculate_coefficients(voice);
+	}
+}
+
+// Same polynomial models as the single ladder (LadderParameters)
+void PolySynth::calculate_coefficients(unsigned int voice) {
+	float frequencyHz = fminf(cutoff_ * keyFactor_[voice], kMaxCutoff * sampleRate_);
+	float omega = 2 * M_PI * frequencyHz / sampleRate_;
+	float g = LadderParameters::cutoff_gain(omega);
+	float gRes = resonance_ * LadderParameters::resonance_gain(omega);
+	coeffB0_[voice] = g * 1.0 / 1.3;
+	coeffB1_[voice] = g * 0.3 / 1.3;
+	coeffA1_[voice] = g - 1.0;
+	feedback_[voice] = 4 * gRes;
+}
+
+unsigned int PolySynth::active_voices() const {
+	unsigned int active = 0;
+	for (unsigned int voice = 0; voice < numVoices_; voice++) {
+		active += note_[voice] >= 0;
+	}
+	return active;
+}
+
+void PolySynth::processBlock(float* out, unsigned int n, float gain) {
+	// Unaligned loads and stores of the lanes (the arrays are only aligned
+	// to their elements)
+	auto load = [](const float* p) { Lanes v; memcpy(&v, p, sizeof(v)); return v; };
+	auto store = [](float* p, Lanes v) { memcpy(p, &v, sizeof(v)); };
+	auto splat = [](float x) { Lanes v; for (unsigned int l = 0; l < kLanes; l++) v[l] = x; return v; };
+
+	// Rational approximation of tanh (Lambert's continued fraction, error
+	// below 1e-4), exactly 1 beyond the clamp
+	const Lanes limit = splat(4.97);
+	auto tanhLanes = [&](Lanes x) {
+		LaneInts low = x < -limit, high = x > limit;
+		x = (Lanes)(((LaneInts)-limit & low) | (~low & (LaneInts)x));
+		x = (Lanes)(((LaneInts)limit & high) | (~high & (LaneInts)x));
+		Lanes x2 = x * x;
+		Lanes numerator = x * (135135.0f + x2 * (17325.0f + x2 * (378.0f + x2)));
+		Lanes denominator = 135135.0f + x2 * (62370.0f + x2 * (3150.0f + x2 * 28.0f));
+		return numerator / denominator;
+	};
+
+	if (n > maxBlockSize_) {
+		n = maxBlockSize_;
+	}
+	memset(mix_.data(), 0, n * kLanes * sizeof(float));
+	const Lanes tableSize = splat(table_.size() - 1);
+	const float* table = table_.data();
+
+	for (unsigned int first = 0; first < numVoices_; first += kLanes) {
+		// Skip groups without a voice playing
+		bool active = false;
+		for (unsigned int l = 0; l < kLanes; l++) {
+			active |= note_[first + l] >= 0;
+		}
+		if (!active) {
+			continue;
+		}
+
+		// State and coefficients of the group in registers for the block
+		Lanes phase = load(&phase_[first]), increment = load(&increment_[first]);
+		Lanes velocity = load(&velocity_[first]);
+		Lanes envelope = load(&envelope_[first]), target = load(&target_[first]), rate = load(&rate_[first]);
+		const Lanes b0 = load(&coeffB0_[first]), b1 = load(&coeffB1_[first]), a1 = load(&coeffA1_[first]);
+		const Lanes feedback = load(&feedback_[first]);
+		Lanes x0 = load(&lastX_[first]);
+		Lanes y0 = load(&lastY0_[first]), y1 = load(&lastY1_[first]);
+		Lanes y2 = load(&lastY2_[first]), y3 = load(&lastY3_[first]);
+
+		for (unsigned int i = 0; i < n; i++) {
+			// Oscillators: advance and wrap the phase, then interpolate
+			// linearly between the two table samples around it
+			phase += increment;
+			LaneInts wrap = phase >= tableSize;
+			phase -= (Lanes)((LaneInts)tableSize & wrap);
+			LaneInts index = __builtin_convertvector(phase, LaneInts);
+			Lanes fraction = phase - __builtin_convertvector(index, Lanes);
+			Lanes below, above;
+			for (unsigned int l = 0; l < kLanes; l++) {
+				below[l] = table[index[l]];
+				above[l] = table[index[l] + 1];
+			}
+			Lanes input = velocity * (below + fraction * (above - below));
+
+			// Feedback path and nonlinearity
+			Lanes x = tanhLanes(input - feedback * (y3 - 0.5f * input));
+
+			// The four stages
+			Lanes z0 = b0 * x + b1 * x0 - a1 * y0;
+			Lanes z1 = b0 * z0 + b1 * y0 - a1 * y1;
+			Lanes z2 = b0 * z1 + b1 * y1 - a1 * y2;
+			Lanes z3 = b0 * z2 + b1 * y2 - a1 * y3;
+			x0 = x;
+			y0 = z0;
+			y1 = z1;
+			y2 = z2;
+			y3 = z3;
+
+			// Envelope on the output, so that the filter rings on
+			envelope += (target - envelope) * rate;
+			store(&mix_[i * kLanes], load(&mix_[i * kLanes]) + z3 * envelope);
+		}
+
+		// Save the state of the group
+		store(&phase_[first], phase);
+		store(&envelope_[first], envelope);
+		store(&lastX_[first], x0);
+		store(&lastY0_[first], y0);
+		store(&lastY1_[first], y1);
+		store(&lastY2_[first], y2);
+		store(&lastY3_[first], y3);
+
+		// Released voices that have faded out are free
+		for (unsigned int voice = first; voice < first + kLanes; voice++) {
+			if (note_[voice] >= 0 && target_[voice] == 0 && envelope_[voice] < kSilence) {
+				note_[voice] = -1;
+			}
+		}
+	}
+
+	// Sum of the lanes
+	for (unsigned int i = 0; i < n; i++) {
+		float sum = 0;
+		for (unsigned int l = 0; l < kLanes; l++) {
+			sum += mix_[i * kLanes + l];
+		}
+		out[i] += gain * sum;
+	}
+}
\ No newline at end of file
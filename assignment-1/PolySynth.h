@@ -0,0 +1,120 @@
+/***** PolySynth.h *****/
+/* Implementation of a polyphonic version of the synth: every voice is a
+ * wavetable oscillator through its own resonant ladder (feedback path,
+ * tanh nonlinearity and four first-order stages). The state of all voices
+ * is stored structure-of-arrays, one array per variable with a voice per
+ * element, so that kLanes voices are processed at once in the lanes of a
+ * vector from the oscillator through the tanh to the last stage. Groups of
+ * kLanes voices that are all free are skipped.
+ *
+ * Voices are started and released by MIDI notes: a note on takes a free
+ * voice, or steals the oldest released one (the oldest held one if none
+ * is released), and a note off releases the voices of its note. A released
+ * voice fades out and becomes free once it is below kSilence.
+ *
+ * ECS7012P - Queen Mary University of London
+ * Assignment 1, Max Tamussino
+ */
+
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+class PolySynth {
+public:
+	static const unsigned int kLanes = 4;		// Voices per vector (a NEON or SSE register)
+	static const unsigned int kMaxVoices = 128;
+	static constexpr float kAttackTime = 0.005;	// Time constant of the envelope at note on (s)
+	static constexpr float kReleaseTime = 0.1;	// Time constant of the envelope at note off (s)
+	static constexpr float kSilence = 1e-4;		// Envelope below which a released voice is free
+	static constexpr float kMaxCutoff = 0.2;	// Highest cutoff relative to the sample rate
+
+	// Constructor
+	PolySynth() {}
+
+	// Setup (NOT REAL-TIME SAFE) for numVoices voices (rounded up to a
+	// multiple of kLanes) playing one cycle of the wavetable, for blocks of
+	// up to maxBlockSize samples. Returns false if numVoices is 0 or above
+	// kMaxVoices.
+	bool setup(float sampleRate, unsigned int numVoices, const std::vector<float>& table,
+			   unsigned int maxBlockSize);
+
+	// MIDI note on (a velocity of 0 is a note off) and note off
+	void note_on(int note, int velocity);
+	void note_off(int note);
+
+	// Releases all voices
+	void all_notes_off();
+
+	// Cutoff and resonance of all voices, only calculated again if they
+	// changed. With key tracking, the cutoff of every voice follows its
+	// note (1 moves it an octave per octave, from middle C).
+	void set_filter(float cutoffHz, float resonance, float keyTracking = 0);
+
+	// Adds n samples (up to maxBlockSize) of the mix of all voices, times
+	// gain, to out
+	void processBlock(float* out, unsigned int n, float gain = 1.0);
+
+	// Number of voices and of voices playing or fading out
+	unsigned int num_voices() const { return numVoices_; }
+	unsigned int active_voices() const;
+
+	// Destructor
+	~PolySynth() {}
+
+private:
+	typedef float Lanes __attribute__((vector_size(kLanes * sizeof(float))));
+	typedef int32_t LaneInts __attribute__((vector_size(kLanes * sizeof(int32_t))));
+
+	// Ladder coefficients of one voice from the filter settings
+	void calculate_coefficients(unsigned int voice);
+
+	// Settings
+	float sampleRate_ = 0;
+	unsigned int numVoices_ = 0;
+	unsigned int maxBlockSize_ = 0;
+	float cutoff_ = 1000;
+	float resonance_ = 0;
+	float keyTracking_ = 0;
+	float attackRate_ = 0;
+	float releaseRate_ = 0;
+
+	// Wavetable with the first sample repeated at the end, so that the
+	// interpolation never wraps
+	std::vector<float> table_;
+
+	// Voice allocation: MIDI note (-1 if free) and when it started
+	std::vector<int> note_;
+	std::vector<unsigned int> started_;
+	unsigned int noteCounter_ = 0;
+
+	// Oscillators: phase and increment per sample in table samples, and
+	// amplitude from the velocity
+	std::vector<float> phase_;
+	std::vector<float> increment_;
+	std::vector<float> velocity_;
+
+	// Envelopes: level, target (1 held, 0 released) and rate towards it
+	std::vector<float> envelope_;
+	std::vector<float> target_;
+	std::vector<float> rate_;
+
+	// Ladders: coefficients, feedback gain (four times the resonance gain),
+	// last input of the first stage and last output of every stage
+	std::vector<float> coeffB0_;
+	std::vector<float> coeffB1_;
+	std::vector<float> coeffA1_;
+	std::vector<float> feedback_;
+	std::vector<float> lastX_;
+	std::vector<float> lastY0_;
+	std::vector<float> lastY1_;
+	std::vector<float> lastY2_;
+	std::vector<float> lastY3_;
+
+	// Cutoff of every voice relative to cutoff_, from the key tracking
+	std::vector<float> keyFactor_;
+
+	// Outputs of the lanes of every sample, summed once per block
+	std::vector<float> mix_;
+};
\ No newline at end of file
@@ -11,11 +11,17 @@
 #include <libraries/GuiController/GuiController.h>
 #include <libraries/Scope/Scope.h>
 #include <libraries/math_neon/math_neon.h>
+#include <libraries/Midi/Midi.h>
+#include <algorithm>
 #include <cmath>
 #include <iostream>
+#include <vector>
 
 #include "Wavetable.h"
-#include "FirstOrderFilterIIR.h"
+#include "LadderCascade.h"
+#include "LadderParameters.h"
+#include "Oversampler.h"
+#include "PolySynth.h"
 
 // Control the creation of data for a bode diagram
 // Use BODE_ACTIVATE to toggle the use
@@ -28,6 +34,17 @@
 // Oscillator selection (1 is sine, 0 is sawtooth)
 #define OSC_SINE 0
 
+// Oversampling factor of the ladder (1, 2, 4 or 8), against the aliasing
+// of the nonlinearity at high resonance and high oscillator frequencies
+// (1 runs the ladder at the audio rate, see the cost table in the README)
+#define OVERSAMPLING 1
+
+// Polyphonic synth played from MIDI instead of the single oscillator
+// (0 is off, otherwise the number of voices; the voices run at the audio
+// rate, without oversampling)
+#define POLYPHONY 0
+#define MIDI_PORT "hw:1,0,0"
+
 // Browser-based GUI to adjust parameters
 Gui gGui;
 GuiController gGuiController;
@@ -38,12 +55,23 @@ Scope gScope;
 // Oscillator objects
 Wavetable gSineOscillator, gSawtoothOscillator;
 
-// Filters
-FirstOrderFilterIIR filters[4];
+// Four-stage ladder with its feedback path, and its cutoff and resonance
+// smoothed, with coefficients from a table
+LadderCascade gLadder;
+LadderParameters gLadderParameters;
+
+// Half-band up- and downsampling around the ladder
+Oversampler gOversampler;
+
+// Polyphonic synth and its MIDI input
+#if POLYPHONY
+PolySynth gSynth;
+Midi gMidi;
+#endif
 
-// Feedback path global variables
-float gGres = 0.0;
-float gLastOutput = 0.0;
+// Oscillator output, the same at the oversampled rate and filter output of
+// one block
+std::vector<float> gInBlock, gOversampledBlock, gOutBlock;
 
 // Bode plot generation
 // Most of them only used if bode creation needed
@@ -79,6 +107,22 @@ bool setup(BelaContext *context, void *userData)
 	
 	// Initialise the sine oscillator
 	gSineOscillator.setup(context->audioSampleRate, wavetable);
+	
+	// Initialise the polyphonic synth with the selected wavetable and open
+	// the MIDI input
+	#if POLYPHONY
+	if (!OSC_SINE) {
+		for(unsigned int n = 0; n < wavetableSize; n++) {
+			wavetable[n] = -1.0 + 2.0 * (float)n / (float)(wavetableSize - 1);
+		}
+	}
+	if (!gSynth.setup(context->audioSampleRate, POLYPHONY, wavetable, context->audioFrames)) {
+		rt_printf("Invalid number of voices %d\n", POLYPHONY);
+		return false;
+	}
+	gMidi.readFrom(MIDI_PORT);
+	gMidi.enableParser(true);
+	#endif
 
 	// Set up the GUI
 	gGui.setup(context->projectName);
@@ -91,8 +135,30 @@ bool setup(BelaContext *context, void *userData)
 	gGuiController.addSlider("Cutoff frequency", 1000, 100, 5000, 1);
 	gGuiController.addSlider("Resonance", 0.5, 0, 1, 0.01);
 	
-	// Set up the scope
+	// Set up the scope (the synth has no single oscillator, so only its
+	// output is shown)
+	#if POLYPHONY
+	gScope.setup(1, context->audioSampleRate);
+	#else
 	gScope.setup(2, context->audioSampleRate);
+	#endif
+	
+	// Block buffers, and the oversampling and coefficient table of the
+	// single ladder (the synth has its own filters)
+	gOutBlock.resize(context->audioFrames);
+	#if !POLYPHONY
+	if (!gOversampler.setup(OVERSAMPLING, context->audioFrames)) {
+		rt_printf("Invalid oversampling factor %d\n", OVERSAMPLING);
+		return false;
+	}
+	gInBlock.resize(context->audioFrames);
+	gOversampledBlock.resize(context->audioFrames * OVERSAMPLING);
+	
+	if (!gLadderParameters.setup(context->audioSampleRate * OVERSAMPLING)) {
+		rt_printf("Sample rate too low for the ladder\n");
+		return false;
+	}
+	#endif
 	
 	// Set up bode frequencies if needed
 	#if BODE_ACTIVATE
@@ -107,33 +173,6 @@ bool setup(BelaContext *context, void *userData)
 	return true;
 }
 
-// Calculate filter coefficients given specifications
-// frequencyHz -- filter frequency in Hertz (needs to be converted to discrete time frequency)
-// resonance -- normalised parameter 0-1 which is related to filter Q
-void calculate_coefficients(float sampleRate, float frequencyHz, float resonance) {
-	// Calculate powers of omega_c
-	float omega_c1 = 2 * M_PI * frequencyHz / sampleRate;
-	float omega_c2 = omega_c1 * omega_c1;
-	float omega_c3 = omega_c2 * omega_c1;
-	float omega_c4 = omega_c3 * omega_c1;
-	
-	// Polynomial model for g
-	float g = 0.9892 * omega_c1 - 0.4342 * omega_c2 + 0.1381 * omega_c3 - 0.0202 * omega_c4;
-	
-	// Polynomial model for G_res
-	gGres = resonance * (1.0029 + 0.0526 * omega_c1 - 0.0926 * omega_c2 + 0.0218 * omega_c3);
-	
-	// Filter coefficients
-	float coeffB0 = g * 1.0 / 1.3;
-	float coeffB1 = g * 0.3 / 1.3;
-	float coeffA1 = g - 1.0;
-	
-	// Set new coefficients for all filters
-	for (unsigned int i = 0; i < 4; i++) {
-		filters[i].set_coefficients(coeffB0, coeffB1, coeffA1);
-	}
-}
-
 void render(BelaContext *context, void *userData)
 {
 	// Read the slider values
@@ -172,32 +211,47 @@ void render(BelaContext *context, void *userData)
 	gSineOscillator.setFrequency(oscFrequency);
 	gSawtoothOscillator.setFrequency(oscFrequency);
 
-	// Calculate new filter coefficients
-	calculate_coefficients(context->audioSampleRate, cutoffFrequency, resonance);
+	// MIDI notes start and release voices, the amplitude slider sets the
+	// volume of their mix
+	#if POLYPHONY
+	while (gMidi.getParser()->numAvailableMessages() > 0) {
+		MidiChannelMessage message = gMidi.getParser()->getNextChannelMessage();
+		if (message.getType() == kmmNoteOn) {
+			gSynth.note_on(message.getDataByte(0), message.getDataByte(1));
+		} else if (message.getType() == kmmNoteOff) {
+			gSynth.note_off(message.getDataByte(0));
+		}
+	}
+	gSynth.set_filter(cutoffFrequency, resonance);
+	std::fill(gOutBlock.begin(), gOutBlock.end(), 0.0f);
+	gSynth.processBlock(gOutBlock.data(), context->audioFrames, oscAmplitude);
+	#else
+	// New targets for the smoothing (the coefficients are only calculated
+	// again when the sliders moved)
+	gLadderParameters.set_cutoff(cutoffFrequency);
+	gLadderParameters.set_resonance(resonance);
 	
-    for(unsigned int n = 0; n < context->audioFrames; n++) {
-    	
-    	// Choose sine or sawtooth oscillator
-    	float in = oscAmplitude;
-    	if (gBodeActive || OSC_SINE) {
+	// Choose sine or sawtooth oscillator
+	for(unsigned int n = 0; n < context->audioFrames; n++) {
+		float in = oscAmplitude;
+		if (gBodeActive || OSC_SINE) {
 			in *= gSineOscillator.process();
 		} else {
 			in *= gSawtoothOscillator.process();
 		}
-        
-        // Feedback path
-        float out = in - 4 * gGres * (gLastOutput - 0.5 * in);
-        
-        // Apply nonlinearity
-		out = tanhf_neon(out);
-		
-		// Apply the filters
-		for (unsigned int i = 0; i < 4; i++) {
-			out = filters[i].process(out);
-		}
-		
-		// Save the state for feedback
-		gLastOutput = out;
+		gInBlock[n] = in;
+	}
+	
+	// Feedback path, nonlinearity and the four filters over the whole
+	// block at the oversampled rate
+	gOversampler.upsample(gInBlock.data(), context->audioFrames, gOversampledBlock.data());
+	gLadderParameters.processBlock(gLadder, gOversampledBlock.data(), gOversampledBlock.data(),
+								   context->audioFrames * OVERSAMPLING);
+	gOversampler.downsample(gOversampledBlock.data(), context->audioFrames, gOutBlock.data());
+	#endif
+	
+    for(unsigned int n = 0; n < context->audioFrames; n++) {
+    	float out = gOutBlock[n];
 		
 		// Calculate and save bode gain if needed
 		#if BODE_ACTIVATE
@@ -222,7 +276,11 @@ void render(BelaContext *context, void *userData)
     		audioWrite(context, n, channel, out);
     	}
     	
-    	gScope.log(in, out);
+    	#if POLYPHONY
+    	gScope.log(out);
+    	#else
+    	gScope.log(gInBlock[n], out);
+    	#endif
     }
 }
 
@@ -0,0 +1,1865 @@
+/***** bench.cpp *****/
+/* Host microbenchmarks of the building blocks of the project.
+ * Usage: bench [name ...]   (runs all benchmarks if no name is given)
+ *
+ * ECS7012P - Queen Mary University of London
+ * Final project, Max Tamussino
+ */
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <complex>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+#include <pthread.h>
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#endif
+
+#include <Bela.h>
+#include <libraries/AudioFile/AudioFile.h>
+#include <libraries/math_neon/math_neon.h>
+
+#include "AnalyzerSlot.h"
+#include "CircularBuffer.h"
+#include "CircularBufferStaticReturn.h"
+#include "ConstantQKernel.h"
+#include "Decimator.h"
+#include "FirstOrderFilterIIR.h"
+#include "FixedCircularBuffer.h"
+#include "HarmonicPitchDetector.h"
+#include "LadderCascade.h"
+#include "LadderParameters.h"
+#include "MonoFilePlayer.h"
+#include "MultiChannelAnalyzer.h"
+#include "Oversampler.h"
+#include "PeakTracker.h"
+#include "PitchDetector.h"
+#include "PolySynth.h"
+#include "PolyphonicDetector.h"
+#include "SpectrumAnalyzer.h"
+#include "SpectrumEncoder.h"
+#include "SpectrumStage.h"
+#include "SpscCircularBuffer.h"
+#include "Wavetable.h"
+
+// Results are accumulated here, so that the compiler cannot drop the work
+volatile float gSink;
+
+// Average time per call in nanoseconds (best of five runs)
+template <typename F>
+double time_per_call_ns(F function, unsigned int calls) {
+	double best = 1e30;
+	for (unsigned int run = 0; run < 5; run++) {
+		auto before = std::chrono::steady_clock::now();
+		for (unsigned int i = 0; i < calls; i++) function();
+		auto after = std::chrono::steady_clock::now();
+		double ns = std::chrono::duration<double, std::nano>(after - before).count() / calls;
+		if (ns < best) best = ns;
+	}
+	return best;
+}
+
+// Average number of CPU cycles per call (best of five runs). Uses the time
+// stamp counter on x86, elsewhere 0 is returned.
+template <typename F>
+double cycles_per_call(F function, unsigned int calls) {
+#if defined(__x86_64__) || defined(__i386__)
+	double best = 1e30;
+	for (unsigned int run = 0; run < 5; run++) {
+		uint64_t before = __rdtsc();
+		for (unsigned int i = 0; i < calls; i++) function();
+		uint64_t after = __rdtsc();
+		double cycles = (double)(after - before) / calls;
+		if (cycles < best) best = cycles;
+	}
+	return best;
+#else
+	return 0;
+#endif
+}
+
+// Print one result line, with the speedup relative to a reference time
+void report(const char *label, double ns, double referenceNs) {
+	printf("  %-40s %10.1f ns  %6.2fx\n", label, ns, referenceNs / ns);
+}
+
+
+// Window unwrap as done before the mirrored buffer: one modulo per element
+// and the return buffer copied into a new vector on return
+struct LegacyCircularBuffer {
+	std::vector<float> buffer, returnBuffer;
+	unsigned int writePointer = 0;
+	LegacyCircularBuffer(unsigned int length, unsigned int returnLength) : buffer(length), returnBuffer(returnLength) {}
+	void write_element(float element) {
+		buffer[writePointer] = element;
+		if (++writePointer == buffer.size()) writePointer = 0;
+	}
+	std::vector<float> get_last_elements() {
+		for (unsigned int i = 0; i < returnBuffer.size(); i++) {
+			unsigned int index = (writePointer - returnBuffer.size() + buffer.size() + i) % buffer.size();
+			returnBuffer[i] = buffer[index];
+		}
+		return returnBuffer;
+	}
+};
+
+// Reading the FFT window (2048 of 16384 elements) as render() does every
+// hop, and writing the hop of samples in between
+void bench_circular_buffer() {
+	const unsigned int kLength = 16384, kWindow = 2048, kHop = 512, kCalls = 5000;
+	printf("circular-buffer: last %u of %u elements, %u writes per read\n", kWindow, kLength, kHop);
+
+	LegacyCircularBuffer legacy(kLength, kWindow);
+	CircularBufferStaticReturn<float> buffer(kLength, kWindow);
+	buffer.setup();
+	std::vector<float> input(kHop), window(kWindow), unwrapped(kWindow);
+	for (unsigned int i = 0; i < kHop; i++) input[i] = i;
+
+	// Writes: the mirrored buffer stores every element twice
+	double legacyWriteNs = time_per_call_ns([&]() {
+		for (unsigned int i = 0; i < kHop; i++) legacy.write_element(input[i]);
+	}, kCalls);
+	report("write hop, single copy", legacyWriteNs, legacyWriteNs);
+	double mirroredWriteNs = time_per_call_ns([&]() {
+		for (unsigned int i = 0; i < kHop; i++) buffer.write_element(input[i]);
+	}, kCalls);
+	report("write hop, mirrored", mirroredWriteNs, legacyWriteNs);
+
+	// Reads (the write position is arbitrary, so that the window wraps)
+	double legacyNs = time_per_call_ns([&]() {
+		unwrapped = legacy.get_last_elements();
+		gSink = unwrapped[kWindow / 2];
+	}, kCalls);
+	report("read window, modulo + return by value", legacyNs, legacyNs);
+	report("read window, get_last_elements()", time_per_call_ns([&]() {
+		gSink = buffer.get_last_elements()[kWindow / 2];
+	}, kCalls), legacyNs);
+	double viewCopyNs = time_per_call_ns([&]() {
+		memcpy(window.data(), buffer.get_last_N_view(kWindow), kWindow * sizeof(float));
+		gSink = window[kWindow / 2];
+	}, kCalls);
+	report("read window, view + one memcpy", viewCopyNs, legacyNs);
+	report("read window, view in place", time_per_call_ns([&]() {
+		gSink = buffer.get_last_N_view(kWindow)[kWindow / 2];
+	}, kCalls), legacyNs);
+
+	// What the audio thread pays per hop in SpectrumAnalyzer
+	report("hop total, before", legacyWriteNs + legacyNs, legacyWriteNs + legacyNs);
+	report("hop total, mirrored + view + memcpy", mirroredWriteNs + viewCopyNs, legacyWriteNs + legacyNs);
+}
+
+// The compile-time, power-of-two buffer against CircularBuffer: a hop
+// written element by element and in blocks of 16, the window read into a
+// vector, and single elements at random distances. Then the block writes
+// and window reads of other element types. As on the board, the block size
+// is only known at run time (with a constant one, GCC inlines the memcpy
+// of up to 64 bytes as a slow rep movs on x86).
+volatile unsigned int gBlockSize = 16;
+
+template <typename T>
+void bench_fixed_circular_buffer_type(const char *label) {
+	const unsigned int kHop = 512, kWindow = 2048, kBlock = gBlockSize, kCalls = 5000;
+	FixedCircularBuffer<T, 16384> buffer;
+	std::vector<T> input(kHop), window(kWindow);
+	double ns = time_per_call_ns([&]() {
+		for (unsigned int i = 0; i < kHop; i += kBlock) buffer.write(&input[i], kBlock);
+		buffer.read(window.data(), kWindow);
+		gSink = gSink + sizeof(window[kWindow / 2]);
+	}, kCalls);
+	printf("  %-40s %10.1f ns\n", label, ns);
+}
+
+void bench_fixed_circular_buffer() {
+	const unsigned int kLength = 16384, kWindow = 2048, kHop = 512, kBlock = gBlockSize, kCalls = 5000;
+	printf("fixed-circular-buffer: %u elements, window of %u, hop of %u in blocks of %u\n", kLength, kWindow,
+		kHop, kBlock);
+
+	CircularBuffer<float> mirrored(kLength);
+	mirrored.setup();
+	FixedCircularBuffer<float, kLength> fixed;
+	std::vector<float> input(kHop), window(kWindow);
+	for (unsigned int i = 0; i < kHop; i++) input[i] = i;
+
+	double mirroredWriteNs = time_per_call_ns([&]() {
+		for (unsigned int i = 0; i < kHop; i++) mirrored.write_element(input[i]);
+	}, kCalls);
+	report("write hop, CircularBuffer", mirroredWriteNs, mirroredWriteNs);
+	report("write hop, fixed, element by element", time_per_call_ns([&]() {
+		for (unsigned int i = 0; i < kHop; i++) fixed.write(input[i]);
+	}, kCalls), mirroredWriteNs);
+	report("write hop, fixed, blocks of 16", time_per_call_ns([&]() {
+		for (unsigned int i = 0; i < kHop; i += kBlock) fixed.write(&input[i], kBlock);
+	}, kCalls), mirroredWriteNs);
+
+	// The write positions of both are arbitrary now, so the fixed buffer's
+	// window wraps in some of the reads
+	double viewNs = time_per_call_ns([&]() {
+		memcpy(window.data(), mirrored.get_last_N_view(kWindow), kWindow * sizeof(float));
+		mirrored.write_element(window[0]);
+		gSink = window[kWindow / 2];
+	}, kCalls);
+	report("read window, CircularBuffer view + memcpy", viewNs, viewNs);
+	report("read window, fixed, two memcpy", time_per_call_ns([&]() {
+		fixed.read(window.data(), kWindow);
+		fixed.write(window[0]);
+		gSink = window[kWindow / 2];
+	}, kCalls), viewNs);
+
+	// Single elements at pseudo-random distances
+	std::vector<unsigned int> distances(1024);
+	for (unsigned int i = 0; i < distances.size(); i++) distances[i] = 1 + (i * 2654435761u) % kLength;
+	double agoNs = time_per_call_ns([&]() {
+		float sum = 0;
+		for (unsigned int distance : distances) sum += mirrored.get_element_N_ago(distance);
+		gSink = sum;
+	}, kCalls);
+	report("1024 elements N ago, CircularBuffer", agoNs, agoNs);
+	report("1024 elements N ago, fixed", time_per_call_ns([&]() {
+		float sum = 0;
+		for (unsigned int distance : distances) sum += fixed.get_element_N_ago(distance);
+		gSink = sum;
+	}, kCalls), agoNs);
+
+	// Other element types, hop in blocks and window read (CircularBuffer
+	// only holds float)
+	struct Peak {
+		float frequency, amplitude;
+		int bin;
+	};
+	bench_fixed_circular_buffer_type<int16_t>("int16_t");
+	bench_fixed_circular_buffer_type<float>("float");
+	bench_fixed_circular_buffer_type<std::complex<float>>("complex<float>");
+	bench_fixed_circular_buffer_type<Peak>("struct of 12 bytes");
+}
+
+// The ring behind a mutex, the usual way to share a buffer between threads
+template <typename T, unsigned int Capacity>
+struct LockedCircularBuffer {
+	FixedCircularBuffer<T, Capacity> buffer;
+	unsigned int readIndex = 0;
+	std::mutex mutex;
+	unsigned int push(const T* elements, unsigned int N) {
+		std::lock_guard<std::mutex> lock(mutex);
+		unsigned int space = Capacity - (buffer.write_index() - readIndex);
+		if (N > space) N = space;
+		buffer.write(elements, N);
+		return N;
+	}
+	unsigned int pop(T* out, unsigned int N) {
+		std::lock_guard<std::mutex> lock(mutex);
+		unsigned int available = buffer.write_index() - readIndex;
+		if (N > available) N = available;
+		for (unsigned int i = 0; i < N; i++) out[i] = buffer.get_element_N_ago(available - i);
+		readIndex += N;
+		return N;
+	}
+};
+
+// Run a thread on one core (if there is such a core)
+void pin_to_core(std::thread& thread, unsigned int core) {
+	if (core >= std::thread::hardware_concurrency()) return;
+	cpu_set_t set;
+	CPU_ZERO(&set);
+	CPU_SET(core, &set);
+	pthread_setaffinity_np(thread.native_handle(), sizeof(set), &set);
+}
+
+// Producer on core 0 and consumer on core 1: throughput with blocks of 16
+// pushed and up to 256 popped as fast as possible, and the latency from
+// push to pop of single time stamps pushed every 20 us, against the same
+// ring behind a mutex
+template <template <typename, unsigned int> class Ring>
+void bench_spsc_ring(const char *label) {
+	const unsigned int kElements = 1 << 24, kPushBlock = 16, kPopBlock = 256, kStamps = 20000;
+	std::unique_ptr<Ring<float, 4096>> ring(new Ring<float, 4096>);
+
+	// Throughput, the producer retries what did not fit
+	std::vector<float> block(kPushBlock, 1.0f);
+	auto before = std::chrono::steady_clock::now();
+	std::thread consumer([&]() {
+		std::vector<float> out(kPopBlock);
+		float sum = 0;
+		for (unsigned int popped = 0; popped < kElements;) {
+			unsigned int count = ring->pop(out.data(), kPopBlock);
+			for (unsigned int i = 0; i < count; i++) sum += out[i];
+			popped += count;
+			if (count == 0) std::this_thread::yield();
+		}
+		gSink = sum;
+	});
+	pin_to_core(consumer, 1);
+	std::thread producer([&]() {
+		for (unsigned int pushed = 0; pushed < kElements;) {
+			unsigned int count = ring->push(block.data(), kPushBlock);
+			pushed += count;
+			if (count < kPushBlock) std::this_thread::yield();
+		}
+	});
+	pin_to_core(producer, 0);
+	producer.join();
+	consumer.join();
+	double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - before).count();
+
+	// Latency of time stamps (the pushes do not overflow at this rate)
+	std::unique_ptr<Ring<int64_t, 1024>> stampRing(new Ring<int64_t, 1024>);
+	auto now_ns = []() {
+		return (int64_t)std::chrono::duration_cast<std::chrono::nanoseconds>(
+			std::chrono::steady_clock::now().time_since_epoch()).count();
+	};
+	std::vector<double> latencies;
+	latencies.reserve(kStamps);
+	std::thread stampConsumer([&]() {
+		int64_t stamp;
+		while (latencies.size() < kStamps) {
+			if (stampRing->pop(&stamp, 1)) latencies.push_back(now_ns() - stamp);
+		}
+	});
+	pin_to_core(stampConsumer, 1);
+	std::thread stampProducer([&]() {
+		for (unsigned int i = 0; i < kStamps; i++) {
+			int64_t due = now_ns() + 20000;
+			while (now_ns() < due) {}
+			int64_t stamp = now_ns();
+			stampRing->push(&stamp, 1);
+		}
+	});
+	pin_to_core(stampProducer, 0);
+	stampProducer.join();
+	stampConsumer.join();
+	std::sort(latencies.begin(), latencies.end());
+
+	printf("  %-40s %8.1f M elements/s, latency %.2f us median, %.2f us p99\n", label, kElements / seconds / 1e6,
+		latencies[kStamps / 2] / 1000, latencies[kStamps * 99 / 100] / 1000);
+}
+
+void bench_spsc() {
+	const unsigned int kCores = std::thread::hardware_concurrency();
+	printf("spsc: producer on core 0, consumer on core 1 (%u cores%s)\n", kCores,
+		kCores < 2 ? ", both share one: the latency is mostly the time slice" : "");
+
+	SpscCircularBuffer<float, 4096> overflowing;
+	std::vector<float> block(1000);
+	for (unsigned int i = 0; i < 5; i++) overflowing.push(block.data(), block.size());
+	printf("  5 pushes of 1000 into 4096: %u overflows, %u elements dropped\n", overflowing.overflows(),
+		overflowing.dropped());
+
+	bench_spsc_ring<LockedCircularBuffer>("ring behind a mutex");
+	bench_spsc_ring<SpscCircularBuffer>("lock-free SPSC ring");
+}
+
+
+// Cost of the decimation by 16 in cycles per input sample, and its stopband
+// rejection measured with sines that would alias into the passband
+void bench_decimator() {
+	const unsigned int kFactor = 16, kCalls = 20000;
+	const float kSampleRate = 44100, kPassband = 0.8, kAttenuation = 80;
+	printf("decimator: factor %u at %.0f Hz, passband %.0f Hz, %.0f dB design attenuation\n", kFactor, kSampleRate,
+		kPassband * kSampleRate / kFactor / 2, kAttenuation);
+
+	std::vector<float> input(1024), output(1024);
+	for (unsigned int n = 0; n < input.size(); n++) input[n] = sinf(0.01f * n);
+
+	// Previous sample picking for reference (one Bela block of 16 frames)
+	unsigned int picked = 0;
+	double pickCycles = cycles_per_call([&]() {
+		for (unsigned int n = 0; n < 16; n++) {
+			if (n % kFactor == 0) output[picked++ % 64] = input[n];
+		}
+	}, kCalls) / 16;
+	printf("  %-40s %10.2f cycles/sample\n", "n % 16 sample picking, block 16", pickCycles);
+
+	for (unsigned int blockSize : {16u, 64u, 256u}) {
+		Decimator decimator;
+		decimator.setup(kFactor, blockSize, kPassband, kAttenuation);
+		double cycles = cycles_per_call([&]() {
+			decimator.process(input.data(), blockSize, output.data());
+		}, kCalls) / blockSize;
+		char label[64];
+		snprintf(label, sizeof(label), "half-band cascade, block %u", blockSize);
+		printf("  %-40s %10.2f cycles/sample\n", label, cycles);
+	}
+
+	Decimator decimator;
+	decimator.setup(kFactor, 256, kPassband, kAttenuation);
+	printf("  stages:");
+	for (unsigned int s = 0; s < decimator.num_stages(); s++) printf(" %u", decimator.stage(s).num_taps());
+	printf(" taps\n");
+
+	// Output level of a sine after the transient, relative to the input level
+	auto gain_db = [&](float frequency) {
+		decimator.reset();
+		std::vector<float> block(256), out(256);
+		double energy = 0;
+		unsigned int count = 0, n = 0;
+		for (unsigned int b = 0; b < 512; b++) {
+			for (unsigned int i = 0; i < block.size(); i++, n++) block[i] = sin(2.0 * M_PI * frequency * n / kSampleRate);
+			unsigned int frames = decimator.process(block.data(), block.size(), out.data());
+			if (b < 32) continue;
+			for (unsigned int i = 0; i < frames; i++) energy += out[i] * out[i];
+			count += frames;
+		}
+		return 10 * log10(energy / count / 0.5);
+	};
+
+	// Sines above the output Nyquist frequency whose alias lands in the
+	// passband (aliases in the transition band above it are allowed)
+	const float outputRate = kSampleRate / kFactor;
+	const float passbandEdge = outputRate * kPassband / 2;
+	double worstStop = -1000;
+	for (float f = outputRate / 2; f < kSampleRate / 2; f += 37) {
+		float alias = fmodf(f, outputRate);
+		if (alias > outputRate / 2) alias = outputRate - alias;
+		if (alias > passbandEdge) continue;
+		double gain = gain_db(f);
+		if (gain > worstStop) worstStop = gain;
+	}
+	double worstPass = 0;
+	for (float f = 20; f < passbandEdge; f += 37) {
+		double gain = fabs(gain_db(f));
+		if (gain > worstPass) worstPass = gain;
+	}
+	printf("  rejection of aliases into the passband %.1f dB: %s\n", -worstStop, -worstStop >= kAttenuation - 6 ? "PASS" : "FAIL");
+	printf("  passband ripple %.3f dB: %s\n", worstPass, worstPass < 0.1 ? "PASS" : "FAIL");
+}
+
+
+// FFT magnitude spectrum with global maximum: the previous rectangular
+// window with the scalar fda() loop against the windowed spectrum stage
+void bench_spectrum() {
+	const unsigned int kFftSize = 2048, kCalls = 5000;
+	printf("spectrum: %u point FFT, %u bins with global maximum\n", kFftSize, kFftSize / 2);
+
+	// Two partials in some noise
+	std::vector<float> input(kFftSize), spectrum(kFftSize / 2);
+	srand(1);
+	for (unsigned int n = 0; n < kFftSize; n++) {
+		input[n] = sinf(0.3f * n) + 0.5f * sinf(0.61f * n) + 0.01f * (rand() / (float)RAND_MAX - 0.5f);
+	}
+	Fft fft(kFftSize);
+	fft.fft(input);
+
+	// Scalar loop over fda() as in the previous process_fft()
+	double loopNs = time_per_call_ns([&]() {
+		float dominantMag = 0;
+		unsigned int dominantIdx = 0;
+		for (unsigned int n = 0; n < kFftSize / 2; n++) {
+			float current = fft.fda(n);
+			spectrum[n] = current;
+			if (current > dominantMag) {
+				dominantMag = current;
+				dominantIdx = n;
+			}
+		}
+		gSink = dominantMag + dominantIdx;
+	}, kCalls);
+	report("bin pass, fda() loop", loopNs, loopNs);
+	double loopDbNs = time_per_call_ns([&]() {
+		for (unsigned int n = 0; n < kFftSize / 2; n++) spectrum[n] = 20 * log10f(fft.fda(n));
+		gSink = spectrum[1];
+	}, kCalls);
+	report("bin pass, fda() loop + 20 log10f()", loopDbNs, loopNs);
+
+	// Single pass of the spectrum stage over the same bins
+	const SpectrumStage::Scale scales[] = {SpectrumStage::kScaleMagnitude, SpectrumStage::kScalePower, SpectrumStage::kScaleDecibels};
+	const char *scaleNames[] = {"magnitude", "power", "dB"};
+	for (unsigned int s = 0; s < 3; s++) {
+		SpectrumStage stage;
+		stage.setup(kFftSize, SpectrumStage::kWindowHann, scales[s]);
+		char label[64];
+		snprintf(label, sizeof(label), "bin pass, stage %s", scaleNames[s]);
+		report(label, time_per_call_ns([&]() {
+			stage.compute_spectrum(fft);
+			gSink = stage.peak_value();
+		}, kCalls), loopNs);
+	}
+
+	// Whole stage including the window and the FFT itself
+	SpectrumStage stage;
+	stage.setup(kFftSize, SpectrumStage::kWindowHann, SpectrumStage::kScaleMagnitude);
+	double fullNs = time_per_call_ns([&]() {
+		fft.fft(input);
+		float dominantMag = 0;
+		for (unsigned int n = 0; n < kFftSize / 2; n++) {
+			float current = fft.fda(n);
+			spectrum[n] = current;
+			if (current > dominantMag) dominantMag = current;
+		}
+		gSink = dominantMag;
+	}, kCalls);
+	report("FFT + bins, fda() loop", fullNs, fullNs);
+	report("window + FFT + bins, stage magnitude", time_per_call_ns([&]() {
+		stage.process(fft, input.data());
+		gSink = stage.peak_value();
+	}, kCalls), fullNs);
+}
+
+
+// Cost per hop and accuracy of the pitch detectors at one analysis rate,
+// on harmonic tones. The weak fundamental tones have their first partial
+// 20 dB below the second.
+void bench_detectors_at(float kSampleRate) {
+	const unsigned int kFftSize = 2048, kCalls = 200;
+	const float kFrequencies[] = {82.41, 110.0, 146.83, 196.0, 246.94, 329.63, 440.0, 493.88, 659.26};
+	printf("detectors: %u point window at %.1f Hz, error in cents over %u tones\n", kFftSize, kSampleRate,
+		(unsigned int)(sizeof(kFrequencies) / sizeof(kFrequencies[0])));
+
+	Fft fft(kFftSize);
+	SpectrumStage stage;
+	stage.setup(kFftSize, SpectrumStage::kWindowHann, SpectrumStage::kScaleMagnitude);
+	std::vector<float> window(kFftSize);
+
+	// Harmonic tone with 1/h partials up to 0.9 times the Nyquist frequency
+	auto make_tone = [&](float frequency, float fundamentalGain) {
+		srand(1);
+		for (unsigned int n = 0; n < kFftSize; n++) {
+			float sample = 0.001f * (rand() / (float)RAND_MAX - 0.5f);
+			for (unsigned int h = 1; h * frequency < 0.45f * kSampleRate; h++) {
+				sample += (h == 1 ? fundamentalGain : 1.0f) / h * sinf(2.0 * M_PI * h * frequency * n / kSampleRate + h);
+			}
+			window[n] = sample;
+		}
+	};
+
+	for (unsigned int t = 0; t < PitchDetector::kNumTypes; t++) {
+		PitchDetector *detector = PitchDetector::create((PitchDetector::Type)t);
+		detector->setup(kFftSize);
+
+		for (float fundamentalGain : {1.0f, 0.1f}) {
+			double errorSum = 0, worstError = 0, ns = 0;
+			unsigned int octaveErrors = 0, count = 0;
+			for (float frequency : kFrequencies) {
+				make_tone(frequency, fundamentalGain);
+				PitchInput input;
+				input.window = window.data();
+				input.fft = &fft;
+				input.fftSize = kFftSize;
+				input.sampleRate = kSampleRate;
+				input.peaks = nullptr;
+
+				// The spectrum is recalculated for every call, as the
+				// detectors may overwrite the FFT
+				float result = 0;
+				ns += time_per_call_ns([&]() {
+					stage.process(fft, window.data());
+					input.spectrum = &stage.spectrum();
+					input.peakIndex = stage.peak_index();
+					result = detector->process(input);
+				}, kCalls);
+
+				double cents = result > 0 ? 1200 * log2(result / frequency) : 1e4;
+				if (fabs(cents) > 600) {
+					octaveErrors++;
+					continue;
+				}
+				errorSum += fabs(cents);
+				if (fabs(cents) > worstError) worstError = fabs(cents);
+				count++;
+			}
+
+			char label[64];
+			snprintf(label, sizeof(label), "%s, %s", PitchDetector::type_name((PitchDetector::Type)t),
+				fundamentalGain < 1 ? "weak fundamental" : "full fundamental");
+			printf("  %-34s %7.1f us/hop (%.1f us detector)  %6.2f cents mean, %6.2f max, %u wrong\n", label,
+				ns / 1000 / (sizeof(kFrequencies) / sizeof(kFrequencies[0])), detector->mean_cost_us(),
+				count ? errorSum / count : 0.0, worstError, octaveErrors);
+			detector->reset_cost();
+		}
+		delete detector;
+	}
+}
+
+// Detectors at 44.1 kHz downsampled by 16 (the previous single analysis
+// rate) and at a four times higher rate
+void bench_detectors() {
+	for (unsigned int downsample : {16u, 4u}) bench_detectors_at(44100.0 / downsample);
+}
+
+
+// Cost per second of audio of the whole analysis: the previous single rate
+// chain (decimation by 16, one 2048 point FFT every 512 decimated samples)
+// against the multi-rate pyramid of the SpectrumAnalyzer, both with the
+// harmonic detector and fed in blocks of 16 frames
+void bench_pyramid() {
+	const float kSampleRate = 44100;
+	const unsigned int kBlockSize = 16, kSeconds = 10;
+	printf("pyramid: %u s of audio at %.0f Hz in blocks of %u\n", kSeconds, kSampleRate, kBlockSize);
+
+	std::vector<float> input(kSeconds * kSampleRate);
+	srand(1);
+	for (unsigned int n = 0; n < input.size(); n++) {
+		input[n] = 0.3f * sinf(2 * M_PI * 196.0 * n / kSampleRate) + 0.1f * sinf(2 * M_PI * 392.0 * n / kSampleRate)
+			+ 0.001f * (rand() / (float)RAND_MAX - 0.5f);
+	}
+
+	// Previous chain, built from the same parts
+	const unsigned int kFftSize = 2048, kHopSize = 512;
+	Decimator decimator;
+	decimator.setup(16, kBlockSize);
+	CircularBuffer<float> buffer(16384);
+	buffer.setup();
+	Fft fft(kFftSize);
+	SpectrumStage stage;
+	stage.setup(kFftSize, SpectrumStage::kWindowHann, SpectrumStage::kScaleMagnitude);
+	HarmonicPitchDetector detector;
+	detector.setup(kFftSize);
+	std::vector<float> decimated(kBlockSize), window(kFftSize);
+	unsigned int hopCounter = 0;
+	double singleMs = time_per_call_ns([&]() {
+		for (unsigned int start = 0; start + kBlockSize <= input.size(); start += kBlockSize) {
+			unsigned int frames = decimator.process(&input[start], kBlockSize, decimated.data());
+			for (unsigned int n = 0; n < frames; n++) {
+				buffer.write_element(decimated[n]);
+				if (++hopCounter < kHopSize) continue;
+				hopCounter = 0;
+				memcpy(window.data(), buffer.get_last_N_view(kFftSize), kFftSize * sizeof(float));
+				stage.process(fft, window.data());
+				PitchInput pitchInput = {window.data(), &stage.spectrum(), stage.peak_index(), &fft, kFftSize, kSampleRate / 16,
+										  nullptr};
+				gSink = detector.process(pitchInput);
+			}
+		}
+	}, 1) / 1e6 / kSeconds;
+
+	// Pyramid, audio thread and worker in turn, on every hop
+	SpectrumAnalyzer analyzer;
+	SpectrumAnalyzer::Config ungated;
+	ungated.gate.enabled = false;
+	analyzer.setup(kSampleRate, ungated);
+	double pyramidMs = time_per_call_ns([&]() {
+		for (unsigned int start = 0; start + kBlockSize <= input.size(); start += kBlockSize) {
+			if (analyzer.process_block(&input[start], kBlockSize)) {
+				while (analyzer.analyse_next_window()) gSink = analyzer.fundamental_frequency();
+			}
+		}
+	}, 1) / 1e6 / kSeconds;
+
+	printf("  %-40s %10.3f ms/s  %6.2fx\n", "single rate, 2048 point FFT", singleMs, 1.0);
+	printf("  %-40s %10.3f ms/s  %6.2fx\n", "pyramid, 6 levels of 256 point FFTs", pyramidMs, singleMs / pyramidMs);
+	printf("  result %.2f Hz (196.00 Hz expected)\n", analyzer.fundamental_frequency());
+}
+
+// Cost per second of audio of the analysis with the tuning bank locked onto
+// the note (FFT on every fourth hop) against the analysis alone, and the
+// time needed to follow a step of +20 cents to within 2 cents, read from the
+// bank after every block and from the FFT path after every hop
+void bench_tuning_bank() {
+	const float kSampleRate = 44100, kFrequency = 196.0;
+	const unsigned int kBlockSize = 16, kSeconds = 10;
+	printf("tuning-bank: %.0f Hz tone, %u s of audio at %.0f Hz in blocks of %u\n", kFrequency, kSeconds,
+		kSampleRate, kBlockSize);
+
+	// Tone with a step of +20 cents half way, continuous in phase
+	const unsigned int kStep = kSeconds * kSampleRate / 2;
+	std::vector<float> input(kSeconds * kSampleRate);
+	double phase = 0;
+	srand(1);
+	for (unsigned int n = 0; n < input.size(); n++) {
+		input[n] = 0.3f * sinf(phase) + 0.1f * sinf(2 * phase) + 0.001f * (rand() / (float)RAND_MAX - 0.5f);
+		phase += 2 * M_PI * kFrequency * (n < kStep ? 1.0 : pow(2.0, 20.0 / 1200.0)) / kSampleRate;
+		if (phase > 2 * M_PI) phase -= 2 * M_PI;
+	}
+
+	// Run the analysis over the whole input, with the time of the first
+	// reading within 2 cents of the step after it
+	auto run = [&](SpectrumAnalyzer& analyzer, SpectrumAnalyzer::TuningMode mode, double& latencyMs) {
+		SpectrumAnalyzer::Config config;
+		config.gate.enabled = false;
+		config.tuningMode = mode;
+		config.tuningReference = kFrequency;
+		analyzer.setup(kSampleRate, config);
+		latencyMs = -1;
+		double ns = time_per_call_ns([&]() {
+			for (unsigned int start = 0; start + kBlockSize <= input.size(); start += kBlockSize) {
+				if (analyzer.process_block(&input[start], kBlockSize)) {
+					while (analyzer.analyse_next_window()) gSink = analyzer.fundamental_frequency();
+				}
+			}
+		}, 1);
+
+		analyzer.setup(kSampleRate, config);
+		for (unsigned int start = 0; start + kBlockSize <= input.size(); start += kBlockSize) {
+			bool newWindow = analyzer.process_block(&input[start], kBlockSize);
+			while (newWindow && analyzer.analyse_next_window()) {}
+			if (start < kStep || latencyMs >= 0) continue;
+			float cents = mode == SpectrumAnalyzer::kTuningOff ?
+				1200.0 * log2(analyzer.fundamental_frequency() / kFrequency) : analyzer.tuning_cents();
+			if (fabsf(cents - 20) < 2) latencyMs = (start + kBlockSize - kStep) * 1000.0 / kSampleRate;
+		}
+		return ns / 1e6 / kSeconds;
+	};
+
+	SpectrumAnalyzer fftOnly, tuned;
+	double fftLatency, bankLatency;
+	double fftMs = run(fftOnly, SpectrumAnalyzer::kTuningOff, fftLatency);
+	double bankMs = run(tuned, SpectrumAnalyzer::kTuningReference, bankLatency);
+	unsigned int hops = tuned.total_hops();
+
+	printf("  %-40s %10.3f ms/s  %6.2fx  %8.1f ms to +20 cents\n", "FFT on every hop", fftMs, 1.0, fftLatency);
+	printf("  %-40s %10.3f ms/s  %6.2fx  %8.1f ms to +20 cents\n", "tuning bank, FFT while unlocked", bankMs,
+		fftMs / bankMs, bankLatency);
+	printf("  FFT on %u of %u hops, bank result %+.2f cents (+20.00 expected)\n", tuned.hop_count(), hops,
+		tuned.tuning_cents());
+}
+
+// Cost per second of audio of the analysis with and without the level and
+// onset gate, on plucked notes decaying into silence, of which the worker
+// part is what the gate saves, and the time from each onset to the first
+// result on the new note
+void bench_gate() {
+	const float kSampleRate = 44100;
+	const unsigned int kBlockSize = 16, kSeconds = 12;
+	const float kNotes[] = {196.0, 246.9, 293.7, 329.6};
+	const unsigned int kNumNotes = 4;
+	const float kNoteSeconds = kSeconds / (float)kNumNotes;
+	printf("gate: %u plucked notes of %.0f s, %u s of audio at %.0f Hz in blocks of %u\n", kNumNotes, kNoteSeconds,
+		kSeconds, kSampleRate, kBlockSize);
+
+	// Decaying notes with three partials over a noise floor at -80 dBFS
+	std::vector<float> input(kSeconds * kSampleRate);
+	srand(1);
+	for (unsigned int n = 0; n < input.size(); n++) {
+		unsigned int note = n / (kNoteSeconds * kSampleRate);
+		float t = n / kSampleRate - note * kNoteSeconds;
+		float phase = 2 * M_PI * kNotes[note] * t;
+		input[n] = expf(-t / 0.4f) * (0.3f * sinf(phase) + 0.15f * sinf(2 * phase) + 0.05f * sinf(3 * phase))
+			+ 0.0002f * (rand() / (float)RAND_MAX - 0.5f);
+	}
+
+	auto run = [&](SpectrumAnalyzer& analyzer, bool enabled, double& workerMs, double latencyMs[]) {
+		SpectrumAnalyzer::Config config;
+		config.gate.enabled = enabled;
+		analyzer.setup(kSampleRate, config);
+		double ns = time_per_call_ns([&]() {
+			for (unsigned int start = 0; start + kBlockSize <= input.size(); start += kBlockSize) {
+				if (analyzer.process_block(&input[start], kBlockSize)) {
+					while (analyzer.analyse_next_window()) gSink = analyzer.fundamental_frequency();
+				}
+			}
+		}, 1);
+
+		analyzer.setup(kSampleRate, config);
+		for (unsigned int note = 0; note < kNumNotes; note++) latencyMs[note] = -1;
+		double workerNs = 0;
+		for (unsigned int start = 0; start + kBlockSize <= input.size(); start += kBlockSize) {
+			if (!analyzer.process_block(&input[start], kBlockSize)) continue;
+			auto before = std::chrono::steady_clock::now();
+			bool analysed = analyzer.analyse_next_window();
+			workerNs += std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - before).count();
+			if (analysed) {
+				double time = analyzer.window_end_time();
+				unsigned int note = time / kNoteSeconds;
+				if (note >= kNumNotes || latencyMs[note] >= 0) continue;
+				float cents = 1200.0 * log2(analyzer.fundamental_frequency() / kNotes[note]);
+				if (fabsf(cents) < 50) latencyMs[note] = (time - note * kNoteSeconds) * 1000.0;
+			}
+		}
+		workerMs = workerNs / 1e6 / kSeconds;
+		return ns / 1e6 / kSeconds;
+	};
+
+	SpectrumAnalyzer everyHop, gated;
+	double everyLatency[kNumNotes], gatedLatency[kNumNotes], everyWorkerMs, gatedWorkerMs;
+	double everyMs = run(everyHop, false, everyWorkerMs, everyLatency);
+	double gatedMs = run(gated, true, gatedWorkerMs, gatedLatency);
+
+	printf("  %-40s %10.3f ms/s  %6.2fx  worker %.3f ms/s, %u of %u hops\n", "every hop", everyMs, 1.0,
+		everyWorkerMs, everyHop.hop_count(), everyHop.total_hops());
+	printf("  %-40s %10.3f ms/s  %6.2fx  worker %.3f ms/s, %u of %u hops (%.0f%% skipped)\n", "gated", gatedMs,
+		everyMs / gatedMs, gatedWorkerMs, gated.hop_count(), gated.total_hops(), 100.0 * gated.skipped_fraction());
+	printf("  onset to first result on the note [ms]:");
+	for (unsigned int note = 0; note < kNumNotes; note++) printf(" %.0f/%.0f", everyLatency[note], gatedLatency[note]);
+	printf(" (every hop/gated)\n");
+}
+
+// Accuracy of the fundamental from the phase vocoder refinement against the
+// interpolated peak frequency: the error on tones of known frequency, and
+// on the bundled recordings (no true frequency known) the mean change in
+// cents from hop to hop while the note stays the same. Also the cost per
+// second of audio with and without the refinement.
+void bench_phase_vocoder() {
+	const float kSampleRate = 44100;
+	const unsigned int kBlockSize = 16, kTones = 24;
+	const float kToneSeconds = 1.5, kSettleSeconds = 1.0;
+	printf("phase-vocoder: %u tones of %.1f s at %.0f Hz, lag of %u samples per level\n", kTones, kToneSeconds,
+		kSampleRate, SpectrumAnalyzer::Config().levelFftSize / 4);
+
+	SpectrumAnalyzer::Config ungated;
+	ungated.gate.enabled = false;
+	auto analyse = [&](SpectrumAnalyzer& analyzer, const std::vector<float>& input, std::function<void()> onResult) {
+		for (unsigned int start = 0; start + kBlockSize <= input.size(); start += kBlockSize) {
+			if (!analyzer.process_block(&input[start], kBlockSize)) continue;
+			while (analyzer.analyse_next_window()) onResult();
+		}
+	};
+
+	// Tones with three partials, from A1 to A6 with random detuning
+	std::vector<float> frequencies(kTones);
+	srand(3);
+	for (unsigned int t = 0; t < kTones; t++) frequencies[t] = 55.0 * powf(2.0, 5.0 * rand() / (float)RAND_MAX);
+	double interpolatedSum = 0, refinedSum = 0, interpolatedMax = 0, refinedMax = 0;
+	unsigned int results = 0;
+	std::vector<float> input(kToneSeconds * kSampleRate);
+	SpectrumAnalyzer analyzer;
+	for (unsigned int t = 0; t < kTones; t++) {
+		for (unsigned int n = 0; n < input.size(); n++) {
+			float phase = 2 * M_PI * frequencies[t] * n / kSampleRate;
+			input[n] = 0.3f * sinf(phase) + 0.15f * sinf(2 * phase + 1) + 0.1f * sinf(3 * phase + 2)
+				+ 0.0003f * (rand() / (float)RAND_MAX - 0.5f);
+		}
+		analyzer.setup(kSampleRate, ungated);
+		analyse(analyzer, input, [&]() {
+			if (analyzer.window_end_time() < kSettleSeconds) return;
+			double interpolated = fabs(1200.0 * log2(analyzer.detected_frequency() / frequencies[t]));
+			double refined = fabs(1200.0 * log2(analyzer.fundamental_frequency() / frequencies[t]));
+			interpolatedSum += interpolated;
+			refinedSum += refined;
+			interpolatedMax = std::max(interpolatedMax, interpolated);
+			refinedMax = std::max(refinedMax, refined);
+			results++;
+		});
+	}
+	printf("  %-40s %8.3f cents mean, %7.3f max\n", "interpolated peak", interpolatedSum / results, interpolatedMax);
+	printf("  %-40s %8.3f cents mean, %7.3f max\n", "phase vocoder", refinedSum / results, refinedMax);
+
+	// Hop to hop changes on the recordings
+	const char *kFiles[] = {"project/guitar-b.wav", "project/guitar-c3.wav", "project/piano-a4-g4-b4-c5.wav",
+		"project/piano-c4.wav", "project/piano-e3.wav"};
+	for (const char *file : kFiles) {
+		std::vector<float> samples = AudioFileUtilities::loadMono(file);
+		int sampleRate = AudioFileUtilities::getSampleRate(file);
+		if (samples.empty() || sampleRate <= 0) continue;
+		SpectrumAnalyzer fileAnalyzer;
+		fileAnalyzer.setup(sampleRate, ungated);
+		float lastDetected = 0, lastRefined = 0;
+		double detectedChange = 0, refinedChange = 0;
+		unsigned int pairs = 0;
+		analyse(fileAnalyzer, samples, [&]() {
+			float detected = fileAnalyzer.detected_frequency(), refined = fileAnalyzer.fundamental_frequency();
+			if (detected > 0 && lastDetected > 0 && lroundf(12 * log2f(detected / lastDetected)) == 0) {
+				detectedChange += fabs(1200.0 * log2(detected / lastDetected));
+				refinedChange += fabs(1200.0 * log2(refined / lastRefined));
+				pairs++;
+			}
+			lastDetected = detected;
+			lastRefined = refined;
+		});
+		if (pairs == 0) continue;
+		printf("  %-40s %8.3f / %.3f cents hop to hop (interpolated/phase, %u hops)\n", file,
+			detectedChange / pairs, refinedChange / pairs, pairs);
+	}
+
+	// Cost on a steady tone
+	std::vector<float> tone(10 * kSampleRate);
+	for (unsigned int n = 0; n < tone.size(); n++) tone[n] = 0.3f * sinf(2 * M_PI * 196.0 * n / kSampleRate);
+	double costMs[2];
+	for (int refine = 0; refine < 2; refine++) {
+		SpectrumAnalyzer costAnalyzer;
+		SpectrumAnalyzer::Config config = ungated;
+		config.phaseRefinement = refine;
+		costAnalyzer.setup(kSampleRate, config);
+		costMs[refine] = time_per_call_ns([&]() {
+			analyse(costAnalyzer, tone, [&]() { gSink = costAnalyzer.fundamental_frequency(); });
+		}, 1) / 1e6 / 10;
+	}
+	printf("  %-40s %10.3f ms/s  %6.2fx\n", "interpolation only", costMs[0], 1.0);
+	printf("  %-40s %10.3f ms/s  %6.2fx\n", "with phase refinement", costMs[1], costMs[0] / costMs[1]);
+}
+
+// Bytes per frame and encoding time of the spectrum sent to the GUI: the
+// 1024 float bins of the previous single rate spectrum, the merged log
+// spectrum as floats, and the rebinned and quantised frames
+void bench_spectrum_transport() {
+	const float kSampleRate = 44100;
+	printf("spectrum-transport: log spectrum of %d bins, 20 Hz to 5 kHz at 24 bins per octave\n",
+		SpectrumAnalyzer::kNumLogBins);
+
+	std::vector<float> spectrum(SpectrumAnalyzer::kNumLogBins);
+	srand(1);
+	for (unsigned int i = 0; i < spectrum.size(); i++) spectrum[i] = 0.01f * rand() / (float)RAND_MAX;
+
+	// Frames per second: one per hop before, at most 10 now
+	const double hopRate = kSampleRate / SpectrumAnalyzer::Config().hopSize;
+	const double previousBytes = 1024 * sizeof(float);
+	const double floatBytes = spectrum.size() * sizeof(float);
+	printf("  %-40s %10.0f bytes %8.0f bytes/s %12s\n", "previous 1024 float bins", previousBytes, previousBytes * hopRate, "");
+	printf("  %-40s %10.0f bytes %8.0f bytes/s %12s\n", "log spectrum, float", floatBytes, floatBytes * hopRate, "");
+
+	const SpectrumEncoder::Encoding encodings[] = {SpectrumEncoder::kEncodingInt8, SpectrumEncoder::kEncodingInt16};
+	const char *labels[] = {"frame, int8 dB", "frame, int16 dB"};
+	for (int e = 0; e < 2; e++) {
+		SpectrumEncoder encoder;
+		encoder.setup(SpectrumAnalyzer::kNumLogBins, SpectrumAnalyzer::kLogMinFrequency,
+			SpectrumAnalyzer::kLogBinsPerOctave, 20, 5000, 24, encodings[e], 10);
+		double time = 0;
+		double ns = time_per_call_ns([&]() {
+			encoder.encode(spectrum.data(), time);
+			time += 1.0;
+		}, 10000);
+		double bytes = encoder.frame().size();
+		printf("  %-40s %10.0f bytes %8.0f bytes/s %8.2f us\n", labels[e], bytes, bytes * std::min(hopRate, 10.0),
+			ns / 1000.0);
+	}
+}
+
+// Dominant peak search as done before the peak tracker: a scalar scan of
+// the bins around a fraction of the peak index
+unsigned int legacy_find_maximum_around_index(const std::vector<float> *vec, unsigned int idx, float divisor, float deviation) {
+	int minIdx = floor((1.0 - deviation) / divisor * idx);
+	int maxIdx = ceil((1.0 + deviation) / divisor * idx);
+	if (minIdx < 0) minIdx = 0;
+	if (maxIdx > (int)(*vec).size()) maxIdx = (*vec).size();
+	float maximum = 0.0;
+	unsigned int maximumIdx = minIdx;
+	for (int i = minIdx; i < maxIdx; i++) {
+		if ((*vec)[i] > maximum) {
+			maximum = (*vec)[i];
+			maximumIdx = i;
+		}
+	}
+	return maximumIdx;
+}
+
+// Cost per hop of the previous /2 and /3 scans against the peak
+// extraction over the bands of all six levels with track linking, and the
+// frequency error of parabolic interpolation on the magnitudes against
+// the Gaussian interpolation of the tracker, for single Hann windowed sines
+void bench_peaks() {
+	const unsigned int kFftSize = SpectrumAnalyzer::Config().levelFftSize;
+	const float kSampleRate = 44100.0 / 16;
+	printf("peaks: %u point Hann spectra at %.1f Hz\n", kFftSize, kSampleRate);
+
+	Fft fft(kFftSize);
+	SpectrumStage stage;
+	stage.setup(kFftSize, SpectrumStage::kWindowHann, SpectrumStage::kScaleMagnitude);
+	std::vector<float> window(kFftSize);
+	auto make_tone = [&](float frequency, unsigned int numHarmonics) {
+		srand(1);
+		for (unsigned int n = 0; n < kFftSize; n++) {
+			float sample = 0.001f * (rand() / (float)RAND_MAX - 0.5f);
+			for (unsigned int h = 1; h <= numHarmonics; h++) sample += 0.5f / h * sinf(2.0 * M_PI * h * frequency * n / kSampleRate + h);
+			window[n] = sample;
+		}
+		stage.process(fft, window.data());
+	};
+
+	// Cost, on a tone with eight harmonics
+	make_tone(110.0, 8);
+	const std::vector<float> *spectrum = &stage.spectrum();
+	double scanNs = time_per_call_ns([&]() {
+		unsigned int half = legacy_find_maximum_around_index(spectrum, stage.peak_index(), 2.0, 0.03);
+		unsigned int third = legacy_find_maximum_around_index(spectrum, stage.peak_index(), 3.0, 0.03);
+		gSink = (*spectrum)[half] + (*spectrum)[third];
+	}, 100000);
+	PeakTracker tracker;
+	tracker.setup();
+	double trackerNs = time_per_call_ns([&]() {
+		tracker.clear_peaks();
+		for (unsigned int level = 0; level < SpectrumAnalyzer::Config().numLevels; level++) {
+			tracker.add_spectrum(spectrum->data(), kFftSize / 2, kSampleRate / kFftSize, 2.0 / kFftSize,
+								 level == 0 ? 0 : kSampleRate / 8, kSampleRate / 4);
+		}
+		tracker.refine_peaks();
+		tracker.update_tracks();
+		gSink = tracker.peaks()[0].frequency;
+	}, 100000);
+	report("/2 and /3 scans", scanNs, scanNs);
+	report("peaks of 6 levels, tracks", trackerNs, scanNs);
+
+	// Accuracy over random frequencies between bins 8 and 100
+	double parabolicSum = 0, parabolicMax = 0, gaussianSum = 0, gaussianMax = 0;
+	const unsigned int kTones = 500;
+	std::vector<float> bins(kTones);
+	srand(2);
+	for (unsigned int t = 0; t < kTones; t++) bins[t] = 8 + 92 * (rand() / (float)RAND_MAX);
+	for (unsigned int t = 0; t < kTones; t++) {
+		float bin = bins[t];
+		make_tone(bin * kSampleRate / kFftSize, 1);
+		const std::vector<float>& magnitudes = stage.spectrum();
+		unsigned int peak = stage.peak_index();
+		float denominator = 2 * (2 * magnitudes[peak] - magnitudes[peak - 1] - magnitudes[peak + 1]);
+		double parabolicError = fabs(peak + (magnitudes[peak + 1] - magnitudes[peak - 1]) / denominator - bin);
+		tracker.clear_peaks();
+		tracker.add_spectrum(magnitudes.data(), kFftSize / 2, 1.0, 2.0 / kFftSize, 0, kFftSize / 2);
+		tracker.refine_peaks();
+		double gaussianError = fabs(tracker.peaks()[0].frequency - bin);
+		parabolicSum += parabolicError;
+		parabolicMax = std::max(parabolicMax, parabolicError);
+		gaussianSum += gaussianError;
+		gaussianMax = std::max(gaussianMax, gaussianError);
+	}
+	printf("  parabolic on magnitudes: %.4f bins mean, %.4f bins max error\n", parabolicSum / kTones, parabolicMax);
+	printf("  gaussian (log magnitudes): %.4f bins mean, %.4f bins max error\n", gaussianSum / kTones, gaussianMax);
+}
+
+// Swapping in reconfigured analyzers under a running block loop. Every
+// kSwapInterval seconds of audio the loop asks the control thread for a
+// new analyzer, as the reconfigure task of render.cpp would, and waits
+// while it sets one up: on the board that task runs below the audio
+// priority and never preempts a block, and on a host with one core a
+// concurrent setup would be timed as part of whatever block it interrupts.
+// The blocks that swap, the few after them (first touch of the new
+// instance) and all others are timed apart.
+void bench_reconfigure() {
+	const float kSampleRate = 44100, kFrequency = 196.0, kSwapInterval = 0.5;
+	const unsigned int kBlockSize = 16, kSeconds = 20, kAfterSwap = 4;
+	const unsigned int kSwapBlocks = kSwapInterval * kSampleRate / kBlockSize;
+	printf("reconfigure: %.0f Hz tone, %u s of audio at %.0f Hz in blocks of %u, new analyzer every %.1f s of audio\n",
+		kFrequency, kSeconds, kSampleRate, kBlockSize, kSwapInterval);
+
+	std::vector<float> input(kSeconds * kSampleRate);
+	for (unsigned int n = 0; n < input.size(); n++) input[n] = 0.3f * sinf(2 * M_PI * kFrequency * n / kSampleRate);
+
+	// Mean, 99th percentile and maximum of a set of block times
+	auto summary = [](std::vector<double>& ns) {
+		if (ns.empty()) return std::string("-");
+		double mean = 0;
+		for (double t : ns) mean += t / ns.size();
+		std::sort(ns.begin(), ns.end());
+		char text[100];
+		snprintf(text, sizeof(text), "%5zu blocks %8.1f ns mean %8.1f ns p99 %9.1f ns max", ns.size(), mean,
+			ns[ns.size() * 99 / 100], ns.back());
+		return std::string(text);
+	};
+
+	const unsigned int kFftSizes[] = {256, 512, 1024};
+	for (int reconfigure = 0; reconfigure < 2; reconfigure++) {
+		AnalyzerSlot slot;
+		SpectrumAnalyzer::Config config;
+		config.gate.enabled = false;
+		slot.setup(kSampleRate, config);
+		std::atomic<bool> requested(false), done(false);
+		std::thread control([&]() {
+			for (unsigned int i = 1; !done.load(); ) {
+				if (!requested.load()) {
+					std::this_thread::yield();
+					continue;
+				}
+				slot.collect();
+				if (reconfigure) {
+					config.levelFftSize = kFftSizes[i++ % 3];
+					slot.reconfigure(config);
+				}
+				requested.store(false);
+			}
+		});
+
+		std::vector<double> swapNs, afterNs, otherNs;
+		unsigned int results = 0, correct = 0, swaps = 0, sinceSwap = kAfterSwap, requests = 0;
+		for (unsigned int start = 0, block = 0; start + kBlockSize <= input.size(); start += kBlockSize, block++) {
+			if (block % kSwapBlocks == kSwapBlocks - 1) {
+				requested.store(true);
+				requests++;
+				while (requested.load()) std::this_thread::yield();
+			}
+			auto before = std::chrono::steady_clock::now();
+			bool newWindow = slot.audio_analyzer()->process_block(&input[start], kBlockSize);
+			double ns = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - before).count();
+			if (slot.swaps() != swaps) {
+				swaps = slot.swaps();
+				sinceSwap = 0;
+				swapNs.push_back(ns);
+			} else if (sinceSwap < kAfterSwap) {
+				sinceSwap++;
+				afterNs.push_back(ns);
+			} else {
+				otherNs.push_back(ns);
+			}
+			if (!newWindow) continue;
+			SpectrumAnalyzer *analyzer = slot.acquire(0);
+			while (analyzer->analyse_next_window()) {
+				results++;
+				if (fabsf(1200 * log2f(analyzer->fundamental_frequency() / kFrequency)) < 5) correct++;
+			}
+			slot.release(0);
+		}
+		done.store(true);
+		control.join();
+
+		printf("  %s: %u requests, %u swaps, %u of %u results on the tone\n",
+			reconfigure ? "new analyzer on every request" : "fixed analyzer", requests, swaps, correct, results);
+		if (reconfigure) {
+			printf("    %-22s %s\n", "block with the swap", summary(swapNs).c_str());
+			printf("    %-22s %s\n", "next blocks", summary(afterNs).c_str());
+		}
+		printf("    %-22s %s\n", "other blocks", summary(otherNs).c_str());
+	}
+}
+
+// Six strings of a hexaphonic pickup, interleaved as the inputs of the
+// board: the 99th percentile of the audio block time (the maximum is
+// mostly preemption on a host), the most hops queued in one block and the
+// longest worker run after a block, with the hops of all channels in
+// the same block (one analyzer per channel, no offsets) against the
+// staggered hops of the MultiChannelAnalyzer
+void bench_multichannel() {
+	const float kSampleRate = 44100;
+	const unsigned int kBlockSize = 16, kSeconds = 10, kChannels = 6;
+	const float kStrings[kChannels] = {82.41, 110.0, 146.83, 196.0, 246.94, 329.63};
+	printf("multichannel: %u strings, %u s of audio at %.0f Hz in blocks of %u\n", kChannels, kSeconds, kSampleRate,
+		kBlockSize);
+
+	std::vector<float> input(kSeconds * kSampleRate * kChannels);
+	for (unsigned int n = 0; n < input.size() / kChannels; n++) {
+		for (unsigned int channel = 0; channel < kChannels; channel++) {
+			float phase = 2 * M_PI * kStrings[channel] * n / kSampleRate;
+			input[n * kChannels + channel] = 0.2f * sinf(phase) + 0.1f * sinf(2 * phase);
+		}
+	}
+
+	SpectrumAnalyzer::Config config;
+	config.gate.enabled = false;
+	for (int staggered = 0; staggered < 2; staggered++) {
+		MultiChannelAnalyzer multi;
+		std::vector<SpectrumAnalyzer> aligned(kChannels);
+		std::vector<float> block(kBlockSize);
+		if (staggered) {
+			multi.setup(kSampleRate, kBlockSize, kChannels, config);
+		} else {
+			for (unsigned int channel = 0; channel < kChannels; channel++) {
+				aligned[channel].setup(kSampleRate, config);
+			}
+		}
+		auto analyzer = [&](unsigned int channel) {
+			return staggered ? multi.slot(channel).audio_analyzer() : &aligned[channel];
+		};
+
+		std::vector<double> blockNs;
+		double workerMaxNs = 0;
+		unsigned int mostHops = 0, hops = 0;
+		for (unsigned int start = 0; start + kBlockSize * kChannels <= input.size(); start += kBlockSize * kChannels) {
+			auto before = std::chrono::steady_clock::now();
+			if (staggered) {
+				multi.process_block(&input[start], kBlockSize, kChannels, true);
+			} else {
+				for (unsigned int channel = 0; channel < kChannels; channel++) {
+					for (unsigned int n = 0; n < kBlockSize; n++) block[n] = input[start + n * kChannels + channel];
+					aligned[channel].process_block(block.data(), kBlockSize);
+				}
+			}
+			auto between = std::chrono::steady_clock::now();
+			unsigned int blockHops = 0;
+			for (unsigned int channel = 0; channel < kChannels; channel++) {
+				while (analyzer(channel)->analyse_next_window()) blockHops++;
+			}
+			auto after = std::chrono::steady_clock::now();
+			blockNs.push_back(std::chrono::duration<double, std::nano>(between - before).count());
+			if (blockHops > 0) workerMaxNs = std::max(workerMaxNs, std::chrono::duration<double, std::nano>(after - between).count());
+			mostHops = std::max(mostHops, blockHops);
+			hops += blockHops;
+		}
+
+		unsigned int correct = 0;
+		for (unsigned int channel = 0; channel < kChannels; channel++) {
+			if (fabsf(1200 * log2f(analyzer(channel)->fundamental_frequency() / kStrings[channel])) < 5) correct++;
+		}
+		double meanNs = 0;
+		for (double ns : blockNs) meanNs += ns / blockNs.size();
+		std::sort(blockNs.begin(), blockNs.end());
+		printf("  %-40s %8.1f ns mean, %8.1f ns p99 per block, worker %.1f us max per block\n",
+			staggered ? "staggered hops" : "aligned hops", meanNs, blockNs[blockNs.size() * 99 / 100],
+			workerMaxNs / 1000);
+		printf("  %u hops, at most %u in one block, %u of %u strings found\n", hops, mostHops, correct, kChannels);
+	}
+}
+
+// Write a mono 16 bit WAV file. Returns false on error.
+bool write_wav(const char *path, const std::vector<float>& samples, unsigned int sampleRate) {
+	FILE *file = fopen(path, "wb");
+	if (!file) return false;
+	uint32_t dataSize = samples.size() * 2, riffSize = 36 + dataSize, fmtSize = 16, byteRate = sampleRate * 2;
+	uint16_t format = 1, channels = 1, blockAlign = 2, bits = 16;
+	fwrite("RIFF", 1, 4, file);
+	fwrite(&riffSize, 4, 1, file);
+	fwrite("WAVEfmt ", 1, 8, file);
+	fwrite(&fmtSize, 4, 1, file);
+	fwrite(&format, 2, 1, file);
+	fwrite(&channels, 2, 1, file);
+	fwrite(&sampleRate, 4, 1, file);
+	fwrite(&byteRate, 4, 1, file);
+	fwrite(&blockAlign, 2, 1, file);
+	fwrite(&bits, 2, 1, file);
+	fwrite("data", 1, 4, file);
+	fwrite(&dataSize, 4, 1, file);
+	for (float sample : samples) {
+		int16_t value = lroundf(std::max(-1.0f, std::min(1.0f, sample)) * 32767);
+		fwrite(&value, 2, 1, file);
+	}
+	return fclose(file) == 0;
+}
+
+// A long recording played from memory and streamed from disk: the time
+// until setup returns, the samples held in memory and, played at a multiple
+// of real time with a trigger() and a loop on the way, the underruns and
+// the samples that differ from the file
+void bench_file_player() {
+	const unsigned int kSampleRate = 44100, kSeconds = 60, kBlockSize = 128, kSpeed = 16;
+	const unsigned int kPlayFrames = 90 * kSampleRate, kTriggerFrame = 20 * kSampleRate;
+	const char *kPath = "/tmp/bench-file-player.wav";
+	printf("file-player: %u s mono file, %u s played in blocks of %u at %ux real time, trigger at %u s\n", kSeconds,
+		kPlayFrames / kSampleRate, kBlockSize, kSpeed, kTriggerFrame / kSampleRate);
+
+	// A sweep, so that a sample from the wrong position is noticed
+	std::vector<float> samples(kSeconds * kSampleRate);
+	double phase = 0;
+	for (unsigned int n = 0; n < samples.size(); n++) {
+		phase += 2 * M_PI * (100 + 1000.0 * n / samples.size()) / kSampleRate;
+		samples[n] = 0.5f * sinf(phase);
+	}
+	if (!write_wav(kPath, samples, kSampleRate)) {
+		printf("  could not write %s\n", kPath);
+		return;
+	}
+	std::vector<float> file = AudioFileUtilities::loadMono(kPath);
+
+	for (int streaming = 0; streaming < 2; streaming++) {
+		for (int paced = 1; paced >= 0; paced--) {
+			if (!streaming && !paced) continue;
+			MonoFilePlayer player;
+			auto before = std::chrono::steady_clock::now();
+			bool ok = streaming ? player.setupStreaming(kPath) : player.setup(kPath);
+			double setupMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - before).count();
+			if (!ok) {
+				printf("  could not load %s\n", kPath);
+				break;
+			}
+
+			// Expected position in the file, which stands still while the
+			// player waits for a chunk
+			unsigned int expected = 0, wrong = 0;
+			auto blockTime = std::chrono::steady_clock::now();
+			const std::chrono::nanoseconds blockPeriod((long long)(1e9 * kBlockSize / kSampleRate / kSpeed));
+			for (unsigned int start = 0; start < kPlayFrames; start += kBlockSize) {
+				if (start / kBlockSize == kTriggerFrame / kBlockSize) {
+					player.trigger();
+					expected = 0;
+				}
+				for (unsigned int n = 0; n < kBlockSize; n++) {
+					unsigned int underrunFrames = player.underrunFrames();
+					float out = player.process();
+					if (player.underrunFrames() != underrunFrames) continue;
+					if (out != file[expected]) wrong++;
+					if (++expected == file.size()) expected = 0;
+				}
+				if (paced) {
+					blockTime += blockPeriod;
+					std::this_thread::sleep_until(blockTime);
+				}
+			}
+			Bela_deleteAllAuxiliaryTasks();
+
+			char label[64];
+			snprintf(label, sizeof(label), "%s%s", streaming ? "streamed" : "in memory",
+				streaming ? (paced ? ", paced" : ", as fast as possible") : "");
+			printf("  %-40s %8.2f ms setup, %8.1f kB in memory\n", label, setupMs, player.memorySize() * 4 / 1024.0);
+			printf("  %u underruns (%u samples of silence), %u samples differ from the file\n", player.underruns(),
+				player.underrunFrames(), wrong);
+		}
+	}
+	remove(kPath);
+}
+
+// Playback cost per sample with process() and processBlock(), and the
+// error of the resampler on tones in a file at 48 kHz played at 44.1 kHz,
+// as they are and 20 cents higher
+void bench_playback() {
+	const unsigned int kFileRate = 48000, kSeconds = 10;
+	const float kOutputRate = 44100, kTones[] = {1000, 8000};
+	const char *kPath = "/tmp/bench-playback.wav";
+	printf("playback: %u s mono file at %u Hz, played at %.0f Hz\n", kSeconds, kFileRate, kOutputRate);
+
+	for (float tone : kTones) {
+		std::vector<float> samples(kSeconds * kFileRate);
+		for (unsigned int n = 0; n < samples.size(); n++) samples[n] = 0.5f * sinf(2 * M_PI * tone * n / kFileRate);
+		if (!write_wav(kPath, samples, kFileRate)) {
+			printf("  could not write %s\n", kPath);
+			return;
+		}
+
+		// Cost per sample at the rate of the file (first tone only)
+		if (tone == kTones[0]) {
+			MonoFilePlayer player, blockPlayer;
+			player.setup(kPath);
+			blockPlayer.setup(kPath);
+			const unsigned int kBlockSize = 16;
+			std::vector<float> block(kBlockSize);
+			double sampleNs = time_per_call_ns([&]() {
+				for (unsigned int n = 0; n < kBlockSize; n++) block[n] = player.process();
+				gSink = gSink + block[0];
+			}, 200000) / kBlockSize;
+			double blockNs = time_per_call_ns([&]() {
+				blockPlayer.processBlock(block.data(), kBlockSize);
+				gSink = gSink + block[0];
+			}, 200000) / kBlockSize;
+			report("process(), per sample", sampleNs, sampleNs);
+			report("processBlock() of 16, per sample", blockNs, sampleNs);
+
+			// Both give the same samples, across the loop
+			MonoFilePlayer a, b;
+			a.setup(kPath);
+			b.setup(kPath);
+			unsigned int wrong = 0;
+			for (unsigned int start = 0; start < 2 * samples.size(); start += kBlockSize) {
+				b.processBlock(block.data(), kBlockSize);
+				for (unsigned int n = 0; n < kBlockSize; n++) wrong += a.process() != block[n];
+			}
+			printf("  %u samples differ between process() and processBlock() over two loops\n", wrong);
+		}
+
+		// Error of the resampled tone against the exact one, after the
+		// filter has settled
+		for (float cents : {0.0f, 20.0f}) {
+			MonoFilePlayer player;
+			player.setup(kPath);
+			const float rate = kFileRate / kOutputRate * powf(2, cents / 1200);
+			player.setPlaybackRate(rate);
+			const unsigned int kBlockSize = 16, kSettle = 64, kFrames = kOutputRate;
+			std::vector<float> out(kFrames);
+			auto before = std::chrono::steady_clock::now();
+			for (unsigned int start = 0; start < kFrames; start += kBlockSize) {
+				player.processBlock(&out[start], std::min(kBlockSize, kFrames - start));
+			}
+			double ns = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - before).count();
+			double error = 0, power = 0;
+			for (unsigned int n = kSettle; n < kFrames; n++) {
+				double exact = 0.5 * sin(2 * M_PI * tone * n * (double)rate / kFileRate);
+				error += (out[n] - exact) * (out[n] - exact);
+				power += exact * exact;
+			}
+			char label[64];
+			snprintf(label, sizeof(label), "resampled %+.0f cents, %.0f Hz", cents, tone);
+			printf("  %-40s %10.1f ns per sample, error %.1f dB\n", label, ns / kFrames, 10 * log10(error / power));
+		}
+	}
+	remove(kPath);
+}
+
+// Cost per hop and accuracy of the polyphonic mode on synthetic chords of
+// 1 to kMaxVoices notes: random distinct notes from E2 to E5, each with
+// kHarmonics partials falling as 1/h, slightly stretched as on a piano. A
+// chord is scored on the last hop before the next one, a note is found if
+// a voice is within 50 cents of it.
+void bench_polyphonic() {
+	const float kSampleRate = 44100;
+	const unsigned int kBlockSize = 16, kChords = 20, kChordFrames = kSampleRate;
+	const int kLowestNote = 40, kHighestNote = 76;
+	const unsigned int kHarmonics = 8;
+	const float kInharmonicity = 1e-4;
+	printf("polyphonic: %u chords of each size, %.0f s each, notes %d to %d\n", kChords, kChordFrames / kSampleRate,
+		kLowestNote, kHighestNote);
+
+	srand(1);
+	for (unsigned int numNotes = 1; numNotes <= PolyphonicDetector::kMaxVoices; numNotes++) {
+		SpectrumAnalyzer::Config config;
+		config.gate.enabled = false;
+		config.maxVoices = PolyphonicDetector::kMaxVoices;
+		SpectrumAnalyzer analyzer;
+		analyzer.setup(kSampleRate, config);
+
+		unsigned int found = 0, voices = 0, correctVoices = 0;
+		std::vector<float> chord(kChordFrames);
+		for (unsigned int c = 0; c < kChords; c++) {
+			std::vector<int> notes;
+			while (notes.size() < numNotes) {
+				int note = kLowestNote + rand() % (kHighestNote - kLowestNote + 1);
+				if (std::find(notes.begin(), notes.end(), note) == notes.end()) notes.push_back(note);
+			}
+			std::fill(chord.begin(), chord.end(), 0.0f);
+			for (int note : notes) {
+				const float f0 = 440 * powf(2, (note - 69) / 12.0f);
+				for (unsigned int h = 1; h <= kHarmonics; h++) {
+					const float frequency = h * f0 * sqrtf(1 + kInharmonicity * h * h);
+					if (frequency > kSampleRate / 2) break;
+					const float phase = 2 * M_PI * rand() / (float)RAND_MAX;
+					for (unsigned int n = 0; n < kChordFrames; n++) {
+						chord[n] += 0.3f / numNotes / h * sinf(2 * M_PI * frequency * n / kSampleRate + phase);
+					}
+				}
+			}
+			for (unsigned int start = 0; start + kBlockSize <= kChordFrames; start += kBlockSize) {
+				analyzer.process_block(&chord[start], kBlockSize);
+				while (analyzer.analyse_next_window()) {}
+			}
+
+			const std::vector<PolyphonicDetector::Voice>& detected = analyzer.voices();
+			auto near = [](float midiNote, int note) { return fabsf(midiNote - note) < 0.5f; };
+			for (int note : notes) {
+				for (const PolyphonicDetector::Voice& voice : detected) {
+					if (near(voice.midiNote, note)) {
+						found++;
+						break;
+					}
+				}
+			}
+			for (const PolyphonicDetector::Voice& voice : detected) {
+				voices++;
+				for (int note : notes) {
+					if (near(voice.midiNote, note)) {
+						correctVoices++;
+						break;
+					}
+				}
+			}
+		}
+
+		const PolyphonicDetector& detector = analyzer.polyphonic_detector();
+		printf("  %u notes: %6.1f us mean, %6.1f us max per hop, recall %5.1f%%, precision %5.1f%%\n", numNotes,
+			detector.mean_cost_us(), detector.max_cost_us(), 100.0 * found / (kChords * numNotes),
+			voices ? 100.0 * correctVoices / voices : 0.0);
+	}
+}
+
+// Constant-Q octave of one level from the FFT bins with the sparse kernel,
+// against the dense kernel and against the window, FFT and magnitude pass
+// the bins come from. Accuracy on tones at the centre of every bin: level
+// error of the sparse kernel against the dense one and against the tone,
+// bins with the tone as their maximum, and the level one semitone away.
+void bench_constant_q() {
+	const float kRate = 44100 / 4;	// Highest level of the pyramid
+	const unsigned int kFftSizes[] = {256, 1024}, kBinsPerOctave[] = {12, 24, 48}, kCalls = 20000;
+	printf("constant-q: one octave from %.0f Hz at %.0f Hz, Hann window\n", kRate / 8, kRate);
+
+	for (unsigned int fftSize : kFftSizes) {
+		SpectrumStage stage;
+		stage.setup(fftSize, SpectrumStage::kWindowHann, SpectrumStage::kScaleMagnitude);
+		Fft fft(fftSize);
+		std::vector<float> input(fftSize);
+		srand(1);
+		for (unsigned int n = 0; n < fftSize; n++) input[n] = rand() / (float)RAND_MAX - 0.5f;
+		stage.process(fft, input.data());
+		double fftNs = time_per_call_ns([&]() {
+			stage.process(fft, input.data());
+			gSink = stage.peak_value();
+		}, kCalls);
+		char label[96];
+		snprintf(label, sizeof(label), "%u point window + FFT + magnitude", fftSize);
+		report(label, fftNs, fftNs);
+
+		for (unsigned int binsPerOctave : kBinsPerOctave) {
+			int firstBin = ceilf(binsPerOctave * log2f(kRate / 8 / 27.5f) - 1e-3f);
+			float firstFrequency = 27.5f * powf(2, (float)firstBin / binsPerOctave) / kRate;
+			ConstantQKernel sparse, dense;
+			auto before = std::chrono::steady_clock::now();
+			sparse.setup(fftSize, binsPerOctave, firstFrequency, stage.window_table());
+			double setupMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - before).count();
+			dense.setup(fftSize, binsPerOctave, firstFrequency, stage.window_table(), 0);
+			std::vector<float> out(binsPerOctave), denseOut(binsPerOctave);
+
+			double denseNs = time_per_call_ns([&]() {
+				dense.process(stage.bins().data(), out.data());
+				gSink = out[0];
+			}, kCalls);
+			double sparseNs = time_per_call_ns([&]() {
+				sparse.process(stage.bins().data(), out.data());
+				gSink = out[0];
+			}, kCalls);
+			snprintf(label, sizeof(label), "%u bins, dense (%u coefficients)", binsPerOctave, dense.num_coefficients());
+			report(label, denseNs, fftNs);
+			snprintf(label, sizeof(label), "%u bins, sparse (%u coefficients)", binsPerOctave, sparse.num_coefficients());
+			report(label, sparseNs, fftNs);
+
+			double error = 0, levelError = 0;
+			unsigned int correct = 0;
+			float neighbour = 0;
+			const unsigned int semitone = binsPerOctave / 12;
+			for (unsigned int bin = 0; bin < binsPerOctave; bin++) {
+				const float frequency = sparse.bin_frequency(bin);
+				for (unsigned int n = 0; n < fftSize; n++) input[n] = 0.5f * sinf(2 * M_PI * frequency * n + 1);
+				stage.process(fft, input.data());
+				sparse.process(stage.bins().data(), out.data());
+				dense.process(stage.bins().data(), denseOut.data());
+				error = std::max(error, fabs(20 * log10(out[bin] / denseOut[bin])));
+				levelError = std::max(levelError, fabs(20 * log10(out[bin] / 0.5)));
+				if (std::max_element(out.begin(), out.end()) - out.begin() == bin) correct++;
+				if (bin + semitone < binsPerOctave) neighbour = std::max(neighbour, out[bin + semitone] / out[bin]);
+			}
+			printf("  Q %.1f, setup %.1f ms, error %.3f dB to dense, %.3f dB to the tone, %u of %u bins peak, "
+				"next semitone %.1f dB\n", sparse.q(), setupMs, error, levelError, correct, binsPerOctave,
+				20 * log10f(neighbour));
+		}
+	}
+}
+
+// Synth filter of assignment 1 on a resonant sawtooth: the previous
+// render() loop through four FirstOrderFilterIIR objects against the fused
+// LadderCascade over blocks of 16, in cycles per sample, with the largest
+// difference of their outputs. Without feedback, the four filters are
+// also run one block after the other with processBlock().
+void bench_ladder() {
+	const float kSampleRate = 44100, kFrequency = 110, kCutoff = 1000, kResonance = 0.9;
+	const unsigned int kBlockSize = 16, kBlocks = 1 << 14;
+	printf("ladder: %.0f Hz sawtooth, cutoff %.0f Hz, resonance %.1f, blocks of %u\n", kFrequency, kCutoff, kResonance,
+		kBlockSize);
+
+	// Coefficients from the polynomial models of the ladder (LadderParameters)
+	float omega = 2 * M_PI * kCutoff / kSampleRate;
+	float g = 0.9892 * omega - 0.4342 * omega * omega + 0.1381 * powf(omega, 3) - 0.0202 * powf(omega, 4);
+	float gRes = kResonance * (1.0029 + 0.0526 * omega - 0.0926 * omega * omega + 0.0218 * powf(omega, 3));
+	float coeffB0 = g * 1.0 / 1.3, coeffB1 = g * 0.3 / 1.3, coeffA1 = g - 1.0;
+
+	std::vector<float> input(kBlocks * kBlockSize);
+	for (unsigned int n = 0; n < input.size(); n++) input[n] = 0.3f * (2 * fmodf(kFrequency * n / kSampleRate, 1) - 1);
+
+	// Previous loop: feedback, nonlinearity and four filter objects per sample
+	FirstOrderFilterIIR filters[4];
+	for (unsigned int i = 0; i < 4; i++) filters[i].set_coefficients(coeffB0, coeffB1, coeffA1);
+	float lastOutput = 0;
+	std::vector<float> loopOut(input.size()), ladderOut(input.size());
+	auto loop_block = [&](const float *in, float *out) {
+		for (unsigned int n = 0; n < kBlockSize; n++) {
+			float sample = in[n] - 4 * gRes * (lastOutput - 0.5 * in[n]);
+			sample = tanhf_neon(sample);
+			for (unsigned int i = 0; i < 4; i++) sample = filters[i].process(sample);
+			lastOutput = sample;
+			out[n] = sample;
+		}
+	};
+	LadderCascade ladder;
+	ladder.set_coefficients(coeffB0, coeffB1, coeffA1, gRes);
+
+	// Outputs over the whole signal from the same initial state
+	for (unsigned int b = 0; b < kBlocks; b++) {
+		loop_block(&input[b * kBlockSize], &loopOut[b * kBlockSize]);
+		ladder.processBlock(&input[b * kBlockSize], &ladderOut[b * kBlockSize], kBlockSize);
+	}
+	float difference = 0;
+	for (unsigned int n = 0; n < input.size(); n++) difference = std::max(difference, fabsf(loopOut[n] - ladderOut[n]));
+
+	unsigned int block = 0;
+	std::vector<float> out(kBlockSize), scratch(kBlockSize);
+	double loopCycles = cycles_per_call([&]() {
+		loop_block(&input[block * kBlockSize], out.data());
+		block = (block + 1) % kBlocks;
+		gSink = out[0];
+	}, kBlocks) / kBlockSize;
+	double ladderCycles = cycles_per_call([&]() {
+		ladder.processBlock(&input[block * kBlockSize], out.data(), kBlockSize);
+		block = (block + 1) % kBlocks;
+		gSink = out[0];
+	}, kBlocks) / kBlockSize;
+	printf("  %-40s %10.2f cycles/sample\n", "4 x FirstOrderFilterIIR::process()", loopCycles);
+	printf("  %-40s %10.2f cycles/sample  %6.2fx\n", "LadderCascade::processBlock()", ladderCycles,
+		loopCycles / ladderCycles);
+	printf("  largest difference over %.1f s: %g\n", input.size() / kSampleRate, difference);
+
+	// Without feedback, the filters can run a block at a time each
+	double processCycles = cycles_per_call([&]() {
+		const float *in = &input[block * kBlockSize];
+		for (unsigned int n = 0; n < kBlockSize; n++) {
+			float sample = in[n];
+			for (unsigned int i = 0; i < 4; i++) sample = filters[i].process(sample);
+			out[n] = sample;
+		}
+		block = (block + 1) % kBlocks;
+		gSink = out[0];
+	}, kBlocks) / kBlockSize;
+	double blockCycles = cycles_per_call([&]() {
+		filters[0].processBlock(&input[block * kBlockSize], out.data(), kBlockSize);
+		for (unsigned int i = 1; i < 4; i++) filters[i].processBlock(out.data(), out.data(), kBlockSize);
+		block = (block + 1) % kBlocks;
+		gSink = out[0];
+	}, kBlocks) / kBlockSize;
+	printf("  %-40s %10.2f cycles/sample\n", "no feedback, 4 x process()", processCycles);
+	printf("  %-40s %10.2f cycles/sample  %6.2fx\n", "no feedback, 4 x processBlock()", blockCycles,
+		processCycles / blockCycles);
+
+	// Both give the same samples
+	FirstOrderFilterIIR a, b;
+	a.set_coefficients(coeffB0, coeffB1, coeffA1);
+	b.set_coefficients(coeffB0, coeffB1, coeffA1);
+	unsigned int wrong = 0;
+	for (unsigned int start = 0; start < input.size(); start += kBlockSize) {
+		b.processBlock(&input[start], scratch.data(), kBlockSize);
+		for (unsigned int n = 0; n < kBlockSize; n++) wrong += a.process(input[start + n]) != scratch[n];
+	}
+	printf("  %u samples differ between process() and processBlock()\n", wrong);
+}
+
+// Ladder coefficients straight from the polynomial models, at the rate the
+// ladder runs at
+void ladder_coefficients(LadderCascade& ladder, float sampleRate, float cutoff, float resonance) {
+	float omega = 2 * M_PI * cutoff / sampleRate;
+	float g = LadderParameters::cutoff_gain(omega);
+	float gRes = resonance * LadderParameters::resonance_gain(omega);
+	ladder.set_coefficients(g * 1.0 / 1.3, g * 0.3 / 1.3, g - 1.0, gRes);
+}
+
+// Oversampled ladder of assignment 1 at every factor: cost per sample of
+// the base rate, of the resampling alone and with the ladder, the taps of
+// the stages, and the aliasing of a loud sine with high resonance. The
+// sine lies on a bin of the analysis, so its harmonics do as well, and
+// everything else in the spectrum is aliasing (or noise).
+void bench_oversampling() {
+	const float kSampleRate = 44100, kCutoff = 5000, kResonance = 0.9, kAmplitude = 3.0;
+	const unsigned int kBlockSize = 16, kBlocks = 1 << 12, kAnalysisSize = 4096, kSineBin = 279;
+	const float kFrequency = kSineBin * kSampleRate / kAnalysisSize;
+	printf("oversampling: %.0f Hz sine at %.1f, cutoff %.0f Hz, resonance %.1f, blocks of %u\n", kFrequency,
+		kAmplitude, kCutoff, kResonance, kBlockSize);
+
+	std::vector<float> input(kBlocks * kBlockSize);
+	for (unsigned int n = 0; n < input.size(); n++) input[n] = kAmplitude * sinf(2 * M_PI * kFrequency * n / kSampleRate);
+
+	double baseCycles = 0;
+	for (unsigned int factor = 1; factor <= Oversampler::kMaxFactor; factor *= 2) {
+		Oversampler oversampler;
+		oversampler.setup(factor, kBlockSize);
+		LadderCascade ladder;
+		ladder_coefficients(ladder, kSampleRate * factor, kCutoff, kResonance);
+		std::vector<float> oversampled(kBlockSize * factor), output(input.size());
+
+		// Whole signal, for the spectrum
+		for (unsigned int b = 0; b < kBlocks; b++) {
+			oversampler.upsample(&input[b * kBlockSize], kBlockSize, oversampled.data());
+			ladder.processBlock(oversampled.data(), oversampled.data(), kBlockSize * factor);
+			oversampler.downsample(oversampled.data(), kBlockSize, &output[b * kBlockSize]);
+		}
+
+		// Hann windowed DFT of the end of the output, split into the
+		// harmonics of the sine and the rest
+		const float *tail = &output[output.size() - kAnalysisSize];
+		double harmonicPower = 0, aliasPower = 0;
+		for (unsigned int k = 1; k < kAnalysisSize / 2; k++) {
+			std::complex<double> sum = 0;
+			for (unsigned int n = 0; n < kAnalysisSize; n++) {
+				double window = 0.5 - 0.5 * cos(2 * M_PI * n / kAnalysisSize);
+				sum += window * tail[n] * std::polar(1.0, -2 * M_PI * (double)k * n / kAnalysisSize);
+			}
+			// The window spreads every line over three bins
+			unsigned int distance = k % kSineBin;
+			bool harmonic = distance <= 1 || distance >= kSineBin - 1;
+			(harmonic ? harmonicPower : aliasPower) += std::norm(sum);
+		}
+
+		unsigned int block = 0;
+		double resampleCycles = cycles_per_call([&]() {
+			oversampler.upsample(&input[block * kBlockSize], kBlockSize, oversampled.data());
+			oversampler.downsample(oversampled.data(), kBlockSize, output.data());
+			block = (block + 1) % kBlocks;
+			gSink = output[0];
+		}, kBlocks) / kBlockSize;
+		double totalCycles = cycles_per_call([&]() {
+			oversampler.upsample(&input[block * kBlockSize], kBlockSize, oversampled.data());
+			ladder.processBlock(oversampled.data(), oversampled.data(), kBlockSize * factor);
+			oversampler.downsample(oversampled.data(), kBlockSize, output.data());
+			block = (block + 1) % kBlocks;
+			gSink = output[0];
+		}, kBlocks) / kBlockSize;
+		if (factor == 1) baseCycles = totalCycles;
+
+		std::string taps;
+		for (unsigned int s = 0; s < oversampler.num_stages(); s++) {
+			taps += (s ? "/" : "") + std::to_string(oversampler.up_stage(s).num_taps());
+		}
+		printf("  %ux: %7.1f cycles/sample (%5.1f resampling, %.2fx the base rate), taps %s, aliasing %.1f dB\n",
+			factor, totalCycles, resampleCycles, totalCycles / baseCycles, taps.empty() ? "-" : taps.c_str(),
+			10 * log10(aliasPower / harmonicPower));
+	}
+}
+
+// Polyphonic synth of assignment 1 with every voice held, at blocks of 16
+// and 64: time per sample against one Wavetable and LadderCascade per voice,
+// and the most voices one core could play at 44.1 kHz
+void bench_polysynth() {
+	const float kSampleRate = 44100, kCutoff = 2000, kResonance = 0.7;
+	const unsigned int kBlockSizes[] = {16, 64}, kVoices[] = {4, 8, 16, 32, 64};
+	const unsigned int kSamples = 1 << 16;
+	printf("polysynth: sawtooth voices, cutoff %.0f Hz, resonance %.1f, %u voices per vector\n", kCutoff, kResonance,
+		PolySynth::kLanes);
+
+	std::vector<float> table(1024);
+	for (unsigned int n = 0; n < table.size(); n++) table[n] = -1.0 + 2.0 * n / (table.size() - 1);
+	const double samplePeriodNs = 1e9 / kSampleRate;
+
+	for (unsigned int blockSize : kBlockSizes) {
+		std::vector<float> out(blockSize), scratch(blockSize);
+		const unsigned int blocks = kSamples / blockSize;
+		for (unsigned int voices : kVoices) {
+			PolySynth synth;
+			synth.setup(kSampleRate, voices, table, blockSize);
+			synth.set_filter(kCutoff, kResonance);
+			for (unsigned int v = 0; v < voices; v++) synth.note_on(36 + v, 100);
+			double synthNs = time_per_call_ns([&]() {
+				std::fill(out.begin(), out.end(), 0.0f);
+				synth.processBlock(out.data(), blockSize);
+				gSink = out[0];
+			}, blocks) / blockSize;
+
+			// One oscillator and ladder object per voice
+			std::vector<Wavetable> oscillators(voices);
+			std::vector<LadderCascade> ladders(voices);
+			for (unsigned int v = 0; v < voices; v++) {
+				oscillators[v].setup(kSampleRate, table);
+				oscillators[v].setFrequency(440.0 * powf(2.0, (36.0 + v - 69) / 12.0));
+				ladder_coefficients(ladders[v], kSampleRate, kCutoff, kResonance);
+			}
+			double scalarNs = time_per_call_ns([&]() {
+				std::fill(out.begin(), out.end(), 0.0f);
+				for (unsigned int v = 0; v < voices; v++) {
+					for (unsigned int n = 0; n < blockSize; n++) scratch[n] = 0.8f * oscillators[v].process();
+					ladders[v].processBlock(scratch.data(), scratch.data(), blockSize);
+					for (unsigned int n = 0; n < blockSize; n++) out[n] += scratch[n];
+				}
+				gSink = out[0];
+			}, blocks) / blockSize;
+
+			printf("  block %2u, %2u voices: %7.1f ns/sample (%5.2f per voice), scalar %7.1f (%5.2fx), "
+				"%4.0f voices per core\n", blockSize, voices, synthNs, synthNs / voices, scalarNs, scalarNs / synthNs,
+				voices * samplePeriodNs / synthNs);
+		}
+	}
+}
+
+// Parameter layer of the assignment 1 ladder: error of the coefficient
+// table against the polynomials, cost per block of 16 with the sliders
+// still and with the cutoff moving every block (the previous polynomials
+// against the table with smoothing per sub-block), and the largest step of
+// the cutoff between two coefficient updates after a jump of the slider
+void bench_ladder_parameters() {
+	const float kSampleRates[] = {44100, 352800};
+	const float kResonance = 0.9;
+	const unsigned int kBlockSize = 16, kBlocks = 1 << 14;
+	printf("ladder-parameters: %u points per octave, sub-blocks of %u, smoothing %.0f ms, blocks of %u\n",
+		LadderParameters::kPointsPerOctave, LadderParameters::kSubBlockSize, 1000 * LadderParameters::kSmoothingTime,
+		kBlockSize);
+
+	for (float sampleRate : kSampleRates) {
+		// Table against the polynomials from 20 Hz to the top of the table
+		// (or 20 kHz). The table is
+		// only read through the ladder: the first sample of its response to
+		// a small impulse (where the tanh is linear) is b0^4 times the
+		// impulse.
+		float error = 0;
+		const float highest = std::min(20000.0f, LadderParameters::kMaxCutoff * sampleRate);
+		for (float cutoff = 20; cutoff < highest; cutoff *= 1.0137) {
+			float omega = 2 * M_PI * cutoff / sampleRate;
+			float g = LadderParameters::cutoff_gain(omega);
+			LadderParameters table;
+			table.setup(sampleRate);
+			table.set_cutoff(cutoff);
+			table.set_resonance(0);
+			LadderCascade ladder;
+			float impulse = 1e-4, response;
+			table.processBlock(ladder, &impulse, &response, 1);
+			error = std::max(error, fabsf(powf(response / impulse, 0.25f) * 1.3f / g - 1));
+		}
+		printf("  %.1f kHz: largest relative error of g from the table %.2g\n", sampleRate / 1000, error);
+	}
+
+	std::vector<float> input(kBlocks * kBlockSize), out(kBlockSize);
+	for (unsigned int n = 0; n < input.size(); n++) input[n] = 0.3f * (2 * fmodf(110.0f * n / 44100, 1) - 1);
+	auto sweep = [](unsigned int block) { return 1000 + 800 * sinf(2 * M_PI * block / 256); };
+	unsigned int block = 0;
+
+	// Previous render(): the polynomials every block
+	LadderCascade ladder;
+	double polynomialStill = cycles_per_call([&]() {
+		ladder_coefficients(ladder, 44100, 1000, kResonance);
+		ladder.processBlock(&input[block * kBlockSize], out.data(), kBlockSize);
+		block = (block + 1) % kBlocks;
+		gSink = out[0];
+	}, kBlocks) / kBlockSize;
+	double polynomialMoving = cycles_per_call([&]() {
+		ladder_coefficients(ladder, 44100, sweep(block), kResonance);
+		ladder.processBlock(&input[block * kBlockSize], out.data(), kBlockSize);
+		block = (block + 1) % kBlocks;
+		gSink = out[0];
+	}, kBlocks) / kBlockSize;
+
+	// Parameter layer
+	LadderParameters parameters;
+	parameters.setup(44100);
+	parameters.set_resonance(kResonance);
+	double tableStill = cycles_per_call([&]() {
+		parameters.set_cutoff(1000);
+		parameters.processBlock(ladder, &input[block * kBlockSize], out.data(), kBlockSize);
+		block = (block + 1) % kBlocks;
+		gSink = out[0];
+	}, kBlocks) / kBlockSize;
+	double tableMoving = cycles_per_call([&]() {
+		parameters.set_cutoff(sweep(block));
+		parameters.processBlock(ladder, &input[block * kBlockSize], out.data(), kBlockSize);
+		block = (block + 1) % kBlocks;
+		gSink = out[0];
+	}, kBlocks) / kBlockSize;
+	printf("  %-40s %8.2f cycles/sample still, %8.2f moving\n", "polynomials every block", polynomialStill,
+		polynomialMoving);
+	printf("  %-40s %8.2f cycles/sample still, %8.2f moving\n", "table, smoothed per sub-block", tableStill,
+		tableMoving);
+
+	// Cutoff jumping from 500 Hz to 5 kHz: once per block before, in steps
+	// of a sub-block now
+	LadderParameters jump;
+	jump.setup(44100);
+	jump.set_cutoff(500);
+	jump.set_resonance(kResonance);
+	jump.processBlock(ladder, input.data(), out.data(), kBlockSize);
+	jump.set_cutoff(5000);
+	float largestStep = 0;
+	unsigned int updates = 0;
+	while (!jump.settled()) {
+		float before = jump.cutoff();
+		jump.processBlock(ladder, input.data(), out.data(), LadderParameters::kSubBlockSize);
+		largestStep = std::max(largestStep, log2f(jump.cutoff() / before));
+		updates++;
+	}
+	printf("  500 Hz to 5 kHz: one step of %.2f octaves before, now %u updates of at most %.3f octaves\n",
+		log2f(5000.0f / 500), updates, largestStep);
+}
+
+struct Benchmark {
+	const char *name;
+	void (*run)();
+};
+
+const Benchmark kBenchmarks[] = {
+	{"circular-buffer", bench_circular_buffer},
+	{"fixed-circular-buffer", bench_fixed_circular_buffer},
+	{"spsc", bench_spsc},
+	{"decimator", bench_decimator},
+	{"spectrum", bench_spectrum},
+	{"detectors", bench_detectors},
+	{"pyramid", bench_pyramid},
+	{"tuning-bank", bench_tuning_bank},
+	{"spectrum-transport", bench_spectrum_transport},
+	{"peaks", bench_peaks},
+	{"gate", bench_gate},
+	{"phase-vocoder", bench_phase_vocoder},
+	{"reconfigure", bench_reconfigure},
+	{"multichannel", bench_multichannel},
+	{"file-player", bench_file_player},
+	{"playback", bench_playback},
+	{"polyphonic", bench_polyphonic},
+	{"constant-q", bench_constant_q},
+	{"ladder", bench_ladder},
+	{"oversampling", bench_oversampling},
+	{"polysynth", bench_polysynth},
+	{"ladder-parameters", bench_ladder_parameters},
+};
+
+int main(int argc, char *argv[]) {
+	bool found = argc < 2;
+	for (const Benchmark& benchmark : kBenchmarks) {
+		bool selected = argc < 2;
+		for (int i = 1; i < argc; i++) {
+			if (benchmark.name == std::string(argv[i])) selected = found = true;
+		}
+		if (selected) benchmark.run();
+	}
+
+	if (!found) {
+		fprintf(stderr, "Usage: %s [name ...], available benchmarks:\n", argv[0]);
+		for (const Benchmark& benchmark : kBenchmarks) fprintf(stderr, "   %s\n", benchmark.name);
+		return 1;
+	}
+	return 0;
+}
@@ -0,0 +1,82 @@
+/***** Bela.h *****/
+/* Minimal stand-in for the Bela core header, so that the
+ * platform-independent project sources build on a Linux host
+ *
+ * ECS7012P - Queen Mary University of London
+ * Final project, Max Tamussino
+ */
+
+#pragma once
+#include <condition_variable>
+#include <cstdio>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// Real-time safe printing is just printing on the host
+#define rt_printf printf
+
+// Priority of the audio thread (only used to derive task priorities)
+#define BELA_AUDIO_PRIORITY 95
+
+// Auxiliary tasks are plain threads waiting to be scheduled. As on the board,
+// scheduling a task which is already running makes it run once more.
+typedef void* AuxiliaryTask;
+
+struct HostAuxiliaryTask {
+	void (*callback)(void*);
+	void *arg;
+	std::mutex mutex;
+	std::condition_variable condition;
+	unsigned int pending = 0;
+	bool stop = false;
+	std::thread thread;
+};
+
+inline std::vector<HostAuxiliaryTask*>& hostAuxiliaryTasks() {
+	static std::vector<HostAuxiliaryTask*> tasks;
+	return tasks;
+}
+
+inline AuxiliaryTask Bela_createAuxiliaryTask(void (*callback)(void*), int /*priority*/, const char * /*name*/, void *arg = nullptr) {
+	HostAuxiliaryTask *task = new HostAuxiliaryTask;
+	task->callback = callback;
+	task->arg = arg;
+	task->thread = std::thread([task]() {
+		std::unique_lock<std::mutex> lock(task->mutex);
+		while (true) {
+			task->condition.wait(lock, [task]() { return task->pending || task->stop; });
+			if (task->stop) break;
+			task->pending = 0;
+			lock.unlock();
+			task->callback(task->arg);
+			lock.lock();
+		}
+	});
+	hostAuxiliaryTasks().push_back(task);
+	return task;
+}
+
+inline int Bela_scheduleAuxiliaryTask(AuxiliaryTask task) {
+	HostAuxiliaryTask *t = (HostAuxiliaryTask*)task;
+	{
+		std::lock_guard<std::mutex> lock(t->mutex);
+		t->pending++;
+	}
+	t->condition.notify_one();
+	return 0;
+}
+
+// Stop and join all tasks (pending runs are discarded)
+inline void Bela_deleteAllAuxiliaryTasks() {
+	for (HostAuxiliaryTask *task : hostAuxiliaryTasks()) {
+		{
+			std::lock_guard<std::mutex> lock(task->mutex);
+			task->stop = true;
+		}
+		task->condition.notify_one();
+		task->thread.join();
+		delete task;
+	}
+	hostAuxiliaryTasks().clear();
+}
@@ -0,0 +1,164 @@
+/***** AudioFile.h *****/
+/* Host stand-in for the Bela AudioFile library (which wraps libsndfile on
+ * the board). Only uncompressed WAV files are supported: 16, 24 and 32 bit
+ * integer PCM as well as 32 bit float.
+ *
+ * ECS7012P - Queen Mary University of London
+ * Final project, Max Tamussino
+ */
+
+#pragma once
+#include <cstdio>
+#include <cstdint>
+#include <cstring>
+#include <string>
+#include <vector>
+
+namespace AudioFileUtilities {
+
+// Information from the header of a WAV file
+struct WavInfo {
+	unsigned int format = 0;			// 1 is PCM, 3 is float
+	unsigned int channels = 0;
+	unsigned int sampleRate = 0;
+	unsigned int bitsPerSample = 0;
+	long dataOffset = 0;				// Byte position of the first frame
+	unsigned int frames = 0;
+};
+
+// Parse the chunks of a WAV file up to the data chunk. Returns false on error.
+inline bool readWavInfo(FILE* file, WavInfo& info) {
+	char id[4];
+	uint32_t size;
+	if (fread(id, 1, 4, file) != 4 || memcmp(id, "RIFF", 4)) return false;
+	if (fread(&size, 4, 1, file) != 1) return false;
+	if (fread(id, 1, 4, file) != 4 || memcmp(id, "WAVE", 4)) return false;
+
+	// Walk through the chunks (word aligned)
+	while (fread(id, 1, 4, file) == 4 && fread(&size, 4, 1, file) == 1) {
+		if (!memcmp(id, "fmt ", 4)) {
+			uint16_t fmt[8];
+			if (size < 16 || fread(fmt, 1, 16, file) != 16) return false;
+			info.format = fmt[0];
+			info.channels = fmt[1];
+			info.sampleRate = fmt[2] | (fmt[3] << 16);
+			info.bitsPerSample = fmt[7];
+			// WAVE_FORMAT_EXTENSIBLE: the sub format is in the extension
+			if (info.format == 0xFFFE && size >= 40) {
+				uint16_t ext[12];
+				if (fread(ext, 1, 24, file) != 24) return false;
+				info.format = ext[4];
+				size -= 24;
+			}
+			fseek(file, (size - 16 + 1) & ~1u, SEEK_CUR);
+		} else if (!memcmp(id, "data", 4)) {
+			if (!info.channels || !info.bitsPerSample) return false;
+			info.dataOffset = ftell(file);
+			info.frames = size / (info.channels * (info.bitsPerSample / 8));
+			return (info.format == 1 && (info.bitsPerSample == 16 || info.bitsPerSample == 24 || info.bitsPerSample == 32))
+				|| (info.format == 3 && info.bitsPerSample == 32);
+		} else {
+			fseek(file, (size + 1) & ~1u, SEEK_CUR);
+		}
+	}
+	return false;
+}
+
+// Convert one sample of the given format to float
+inline float decodeSample(const unsigned char* p, const WavInfo& info) {
+	if (info.format == 3) {
+		float f;
+		memcpy(&f, p, 4);
+		return f;
+	}
+	switch (info.bitsPerSample) {
+		case 16: return (int16_t)(p[0] | (p[1] << 8)) / 32768.0f;
+		case 24: return (int32_t)((p[0] << 8) | (p[1] << 16) | ((uint32_t)p[2] << 24)) / 2147483648.0f;
+		default: return (int32_t)(p[0] | (p[1] << 8) | (p[2] << 16) | ((uint32_t)p[3] << 24)) / 2147483648.0f;
+	}
+}
+
+// Read frames [startFrame, endFrame) of one channel into buf. Returns 0 on success.
+inline int getSamples(const std::string& file, float* buf, unsigned int channel, unsigned int startFrame, unsigned int endFrame) {
+	FILE* f = fopen(file.c_str(), "rb");
+	if (!f) return -1;
+	WavInfo info;
+	if (!readWavInfo(f, info) || channel >= info.channels || startFrame > endFrame) {
+		fclose(f);
+		return -1;
+	}
+
+	// Frames past the end of the file are filled with zeros
+	const unsigned int bytesPerSample = info.bitsPerSample / 8;
+	const unsigned int bytesPerFrame = bytesPerSample * info.channels;
+	unsigned int available = startFrame < info.frames ? info.frames - startFrame : 0;
+	unsigned int count = endFrame - startFrame;
+	if (available > count) available = count;
+	std::vector<unsigned char> raw((size_t)available * bytesPerFrame);
+	fseek(f, info.dataOffset + (long)startFrame * bytesPerFrame, SEEK_SET);
+	available = fread(raw.data(), bytesPerFrame, available, f);
+	fclose(f);
+
+	for (unsigned int n = 0; n < available; n++) {
+		buf[n] = decodeSample(&raw[(size_t)n * bytesPerFrame + channel * bytesPerSample], info);
+	}
+	for (unsigned int n = available; n < count; n++) buf[n] = 0;
+	return 0;
+}
+
+// Header queries, negative on error
+inline int getNumChannels(const std::string& file) {
+	FILE* f = fopen(file.c_str(), "rb");
+	if (!f) return -1;
+	WavInfo info;
+	bool ok = readWavInfo(f, info);
+	fclose(f);
+	return ok ? (int)info.channels : -1;
+}
+inline int getNumFrames(const std::string& file) {
+	FILE* f = fopen(file.c_str(), "rb");
+	if (!f) return -1;
+	WavInfo info;
+	bool ok = readWavInfo(f, info);
+	fclose(f);
+	return ok ? (int)info.frames : -1;
+}
+
+// Host only: the sample rate is not exposed by the Bela library
+inline int getSampleRate(const std::string& file) {
+	FILE* f = fopen(file.c_str(), "rb");
+	if (!f) return -1;
+	WavInfo info;
+	bool ok = readWavInfo(f, info);
+	fclose(f);
+	return ok ? (int)info.sampleRate : -1;
+}
+
+// Load the first channel of a file, empty on error
+inline std::vector<float> loadMono(const std::string& file) {
+	std::vector<float> samples;
+	int frames = getNumFrames(file);
+	if (frames <= 0) return samples;
+	samples.resize(frames);
+	if (getSamples(file, samples.data(), 0, 0, frames)) samples.clear();
+	return samples;
+}
+
+// Load all channels of a file, one vector per channel, empty on error
+inline std::vector<std::vector<float> > load(const std::string& file) {
+	std::vector<std::vector<float> > channels;
+	int numChannels = getNumChannels(file);
+	int frames = getNumFrames(file);
+	if (numChannels <= 0 || frames <= 0) return channels;
+	channels.resize(numChannels);
+	for (int channel = 0; channel < numChannels; channel++) {
+		channels[channel].resize(frames);
+		if (getSamples(file, channels[channel].data(), channel, 0, frames)) {
+			channels.clear();
+			break;
+		}
+	}
+	return channels;
+}
+
+} // namespace AudioFileUtilities
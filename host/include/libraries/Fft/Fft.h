@@ -0,0 +1,134 @@
+/***** Fft.h *****/
+/* Host stand-in for the Bela Fft library (which wraps NE10 on the board).
+ * It offers the same interface and the same memory layout (interleaved
+ * real/imaginary bins, first N/2+1 bins valid for a real input), using
+ * a plain iterative radix-2 transform with precomputed tables.
+ *
+ * ECS7012P - Queen Mary University of London
+ * Final project, Max Tamussino
+ */
+
+#pragma once
+#include <cmath>
+#include <vector>
+
+class Fft {
+public:
+	// Complex bin, same layout as ne10_fft_cpx_float32_t
+	struct Complex { float r, i; };
+
+	// Constructors
+	Fft() {}
+	Fft(unsigned int length) { setup(length); }
+
+	// Allocate buffers and tables (NOT REAL-TIME SAFE), length must be a power of two
+	int setup(unsigned int length) {
+		if (!isPowerOfTwo(length)) return -1;
+		length_ = length;
+		timeDomain_.assign(length, 0);
+		frequencyDomain_.assign(length, Complex{0, 0});
+		work_.resize(length);
+
+		// Bit reversal permutation
+		bitReverse_.resize(length);
+		unsigned int bits = 0;
+		while ((1u << bits) < length) bits++;
+		for (unsigned int n = 0; n < length; n++) {
+			unsigned int reversed = 0;
+			for (unsigned int b = 0; b < bits; b++) {
+				if (n & (1u << b)) reversed |= 1u << (bits - 1 - b);
+			}
+			bitReverse_[n] = reversed;
+		}
+
+		// Twiddle factors for the forward transform
+		twiddles_.resize(length / 2);
+		for (unsigned int n = 0; n < length / 2; n++) {
+			twiddles_[n].r = cos(2.0 * M_PI * n / length);
+			twiddles_[n].i = -sin(2.0 * M_PI * n / length);
+		}
+		return 0;
+	}
+	void cleanup() {}
+
+	// Forward transform of the signal stored in td()
+	void fft() {
+		for (unsigned int n = 0; n < length_; n++) {
+			work_[bitReverse_[n]] = Complex{timeDomain_[n], 0};
+		}
+		transform(false);
+		for (unsigned int n = 0; n < length_; n++) frequencyDomain_[n] = work_[n];
+	}
+
+	// Forward transform of the given real signal
+	void fft(const std::vector<float>& input) {
+		for (unsigned int n = 0; n < length_ && n < input.size(); n++) timeDomain_[n] = input[n];
+		fft();
+	}
+
+	// Inverse transform of the bins 0..N/2 stored in fdr()/fdi(), result in td()
+	void ifft() {
+		// Complete the conjugate symmetric spectrum of a real signal
+		for (unsigned int n = 0; n <= length_ / 2; n++) {
+			work_[bitReverse_[n]] = frequencyDomain_[n];
+		}
+		for (unsigned int n = length_ / 2 + 1; n < length_; n++) {
+			const Complex& mirror = frequencyDomain_[length_ - n];
+			work_[bitReverse_[n]] = Complex{mirror.r, -mirror.i};
+		}
+		transform(true);
+		const float scale = 1.0 / length_;
+		for (unsigned int n = 0; n < length_; n++) timeDomain_[n] = work_[n].r * scale;
+	}
+
+	// Inverse transform of the given bins
+	void ifft(const std::vector<float>& reInput, const std::vector<float>& imInput) {
+		for (unsigned int n = 0; n <= length_ / 2 && n < reInput.size() && n < imInput.size(); n++) {
+			frequencyDomain_[n] = Complex{reInput[n], imInput[n]};
+		}
+		ifft();
+	}
+
+	// Access to the time and frequency domain data
+	float& td(unsigned int n) { return timeDomain_[n]; }
+	float& fdr(unsigned int n) { return frequencyDomain_[n].r; }
+	float& fdi(unsigned int n) { return frequencyDomain_[n].i; }
+	float fda(unsigned int n) { return sqrtf(fdr(n) * fdr(n) + fdi(n) * fdi(n)); }
+
+	static bool isPowerOfTwo(unsigned int n) { return n > 0 && (n & (n - 1)) == 0; }
+	static unsigned int roundUpToPowerOfTwo(unsigned int n) {
+		unsigned int p = 1;
+		while (p < n) p <<= 1;
+		return p;
+	}
+
+private:
+	// In-place butterflies on the bit-reversed work buffer
+	void transform(bool inverse) {
+		for (unsigned int size = 2; size <= length_; size <<= 1) {
+			const unsigned int half = size / 2;
+			const unsigned int step = length_ / size;
+			for (unsigned int start = 0; start < length_; start += size) {
+				for (unsigned int k = 0; k < half; k++) {
+					Complex w = twiddles_[k * step];
+					if (inverse) w.i = -w.i;
+					Complex& a = work_[start + k];
+					Complex& b = work_[start + k + half];
+					const float tr = b.r * w.r - b.i * w.i;
+					const float ti = b.r * w.i + b.i * w.r;
+					b.r = a.r - tr;
+					b.i = a.i - ti;
+					a.r += tr;
+					a.i += ti;
+				}
+			}
+		}
+	}
+
+	unsigned int length_ = 0;
+	std::vector<float> timeDomain_;
+	std::vector<Complex> frequencyDomain_;
+	std::vector<Complex> work_;
+	std::vector<Complex> twiddles_;
+	std::vector<unsigned int> bitReverse_;
+};
@@ -0,0 +1,19 @@
+/***** math_neon.h *****/
+/* Host stand-in for the Bela math_neon library, mapping the
+ * NEON approximations onto the standard library functions
+ *
+ * ECS7012P - Queen Mary University of London
+ * Final project, Max Tamussino
+ */
+
+#pragma once
+#include <cmath>
+
+inline float logf_neon(float x) { return logf(x); }
+inline float expf_neon(float x) { return expf(x); }
+inline float powf_neon(float x, float n) { return powf(x, n); }
+inline float sinf_neon(float x) { return sinf(x); }
+inline float cosf_neon(float x) { return cosf(x); }
+inline float atan2f_neon(float y, float x) { return atan2f(y, x); }
+inline float tanhf_neon(float x) { return tanhf(x); }
+inline float sqrtf_neon(float x) { return sqrtf(x); }
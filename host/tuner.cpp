@@ -0,0 +1,384 @@
+/***** tuner.cpp *****/
+/* Offline command line tuner: streams WAV files through the same
+ * SpectrumAnalyzer that runs in project/render.cpp, prints the
+ * per-hop frequency/MIDI track and reports the real-time factor. With a
+ * tuning mode, the deviation found by the tuning bank is printed as well.
+ * Several channels of a file are fed interleaved to a MultiChannelAnalyzer,
+ * as the inputs of the board are, and their tracks are printed with the
+ * channel in front.
+ * In the polyphonic mode (--voices), the notes found in every hop follow
+ * as a comment line, as does the strongest bin of the constant-Q spectrum
+ * (--constant-q).
+ * Hops held back by the level and onset gate are not printed, the summary
+ * gives the fraction of hops skipped.
+ * Built with -DSTAGE_TIMING=1, the time spent in every stage of the
+ * pipeline is printed after each file.
+ *
+ * ECS7012P - Queen Mary University of London
+ * Final project, Max Tamussino
+ */
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <thread>
+#include <vector>
+#include <getopt.h>
+
+#include <Bela.h>
+#include <libraries/AudioFile/AudioFile.h>
+#include "MultiChannelAnalyzer.h"
+#include "SpectrumAnalyzer.h"
+#include "StageTiming.h"
+
+// Print usage information
+void usage(const char *processName) {
+	fprintf(stderr, "Usage: %s [options] file.wav [file.wav ...]\n", processName);
+	fprintf(stderr, "   --quiet [-q]:               Only print the summary of each file\n");
+	fprintf(stderr, "   --block-size [-b] frames:   Frames per render call (default 16)\n");
+	fprintf(stderr, "   --channels [-c] number:     Analyse the first channels of the files, 0 for all (default 1)\n");
+	fprintf(stderr, "   --window [-w] name:         FFT window: rectangular, hann (default), hamming,\n");
+	fprintf(stderr, "                               blackman or blackman-harris\n");
+	fprintf(stderr, "   --detector [-D] name:       Pitch detector: harmonic (default), hps, yin or mpm\n");
+	fprintf(stderr, "   --fft-size [-F] samples:    FFT size of every level, a power of two (default 256)\n");
+	fprintf(stderr, "   --hop [-H] samples:         Hop size, a multiple of 128 (default 8192)\n");
+	fprintf(stderr, "   --levels [-l] number:       Octave bands of the pyramid, 1 to 8 (default 6)\n");
+	fprintf(stderr, "   --reference [-r] Hz:        Tune to a reference frequency with the tuning bank\n");
+	fprintf(stderr, "   --follow [-f]:              Tune to the nearest note of the detected frequency\n");
+	fprintf(stderr, "   --partials [-p]:            Print the peaks, their partial tracks and the inharmonicity\n");
+	fprintf(stderr, "   --voices [-v] number:       Polyphonic mode: print up to this many notes per hop, 1 to %d\n",
+		PolyphonicDetector::kMaxVoices);
+	fprintf(stderr, "   --constant-q [-Q] bins:     Print the strongest bin of a constant-Q spectrum with this many\n");
+	fprintf(stderr, "                               bins per octave, e.g. 12\n");
+	fprintf(stderr, "   --threaded [-t]:            Analyse on a worker thread, feeding the audio in real time\n");
+	fprintf(stderr, "   --interpolation [-i]:       Interpolate the peak frequency only, without the phase refinement\n");
+	fprintf(stderr, "   --no-gate [-n]:             Analyse every hop, also in silence and during steady notes\n");
+	fprintf(stderr, "   --silence [-s] dB:          Level below which the gate skips the hops (default -60 dBFS)\n");
+	fprintf(stderr, "   --help [-h]:                Print this menu\n");
+}
+
+// English note name of a MIDI note number (same notation as sketch.js)
+std::string midi_to_text(int midi) {
+	static const char *notes[] = {"A", "A#", "B", "C", "C#", "D", "D#", "E", "F", "F#", "G", "G#"};
+	int reduced = midi - 21;
+	if (reduced < 0) return "-";
+	return std::string(notes[reduced % 12]) + std::to_string(reduced / 12);
+}
+
+// Settings from the command line
+struct TunerOptions {
+	unsigned int blockSize = 16;
+	unsigned int numChannels = 1;
+	SpectrumAnalyzer::Config config;
+	bool quiet = false;
+	bool partials = false;
+	bool threaded = false;
+};
+
+// Print one line of the frequency/MIDI track, with the tuning bank result
+// if it is running, and optionally the peaks of the hop as a comment line.
+// The channel is only printed if there are several.
+void print_result(SpectrumAnalyzer& analyzer, int channel, double time, const TunerOptions& options) {
+	float midi = analyzer.midi_note_number();
+	if (channel >= 0) printf("%d\t", channel);
+	printf("%.3f\t%.2f\t%.2f\t%s", time, analyzer.fundamental_frequency(), midi,
+		midi_to_text(lroundf(midi)).c_str());
+	if (analyzer.tuning_target() > 0) {
+		printf("\t%.2f\t%+.1f\t%s", analyzer.tuning_target(), analyzer.tuning_cents(),
+			analyzer.tuning_locked() ? "locked" : "-");
+	}
+	printf("\n");
+	
+	if (options.partials) {
+		// Frequency, amplitude and track of every peak, strongest first
+		printf("#\tB %.2e\t", analyzer.inharmonicity());
+		const std::vector<SpectralPeak>& peaks = analyzer.peak_tracker().peaks();
+		for (unsigned int p = 0; p < peaks.size(); p++) {
+			printf(" %.2f/%.0fdB/#%d", peaks[p].frequency, 20 * log10f(peaks[p].amplitude), peaks[p].track);
+		}
+		printf("\n");
+	}
+	
+	if (options.config.maxVoices > 0) {
+		// Frequency, MIDI note and salience of every voice, strongest first
+		printf("#\tvoices");
+		const std::vector<PolyphonicDetector::Voice>& voices = analyzer.voices();
+		for (unsigned int v = 0; v < voices.size(); v++) {
+			printf(" %.2f/%.2f/%s/%.3f", voices[v].frequency, voices[v].midiNote,
+				midi_to_text(lroundf(voices[v].midiNote)).c_str(), voices[v].salience);
+		}
+		printf("\n");
+	}
+	
+	const std::vector<float>& constantQ = analyzer.constant_q_spectrum();
+	if (!constantQ.empty()) {
+		// Centre frequency, note and level of the strongest bin
+		unsigned int strongest = std::max_element(constantQ.begin(), constantQ.end()) - constantQ.begin();
+		float frequency = analyzer.constant_q_frequency(strongest);
+		printf("#\tconstant-Q %.2f %s %.0fdB\n", frequency,
+			midi_to_text(lroundf(69 + 12 * log2f(frequency / 440))).c_str(), 20 * log10f(constantQ[strongest] + 1e-10f));
+	}
+}
+
+// Analyse the queued windows of all channels, as analysis_task() in
+// project/render.cpp
+void analyse_channels(MultiChannelAnalyzer& analyzers, const TunerOptions& options) {
+	const unsigned int numChannels = analyzers.num_channels();
+	for (unsigned int channel = 0; channel < numChannels; channel++) {
+		SpectrumAnalyzer *analyzer = analyzers.slot(channel).acquire(0);
+		while (analyzer->analyse_next_window()) {
+			if (!options.quiet) {
+				print_result(*analyzer, numChannels > 1 ? channel : -1, analyzer->window_end_time(), options);
+			}
+		}
+		analyzers.slot(channel).release(0);
+	}
+}
+
+// Worker task of the threaded mode
+struct WorkerContext {
+	MultiChannelAnalyzer *analyzers;
+	const TunerOptions *options;
+};
+
+void analysis_task(void *arg) {
+	WorkerContext *context = (WorkerContext*)arg;
+	analyse_channels(*context->analyzers, *context->options);
+}
+
+// Analyse one file, returns false if it could not be loaded
+bool analyse_file(const std::string& filename, const TunerOptions& options) {
+	const unsigned int blockSize = options.blockSize;
+	const bool quiet = options.quiet, threaded = options.threaded;
+
+	// Load the whole file first, so that only the analysis is timed, and
+	// interleave the channels to be analysed
+	std::vector<std::vector<float> > channels = AudioFileUtilities::load(filename);
+	int sampleRate = AudioFileUtilities::getSampleRate(filename);
+	if (channels.empty() || sampleRate <= 0) {
+		fprintf(stderr, "Error loading audio file '%s'\n", filename.c_str());
+		return false;
+	}
+	unsigned int numChannels = channels.size();
+	if (options.numChannels > 0 && options.numChannels < numChannels) numChannels = options.numChannels;
+	const size_t numFrames = channels[0].size();
+	std::vector<float> samples(numFrames * numChannels);
+	for (size_t n = 0; n < numFrames; n++) {
+		for (unsigned int channel = 0; channel < numChannels; channel++) {
+			samples[n * numChannels + channel] = channels[channel][n];
+		}
+	}
+
+	MultiChannelAnalyzer analyzers;
+	if (!analyzers.setup(sampleRate, blockSize, numChannels, options.config)) {
+		fprintf(stderr, "Error setting up the spectrum analyzer\n");
+		return false;
+	}
+	reset_stage_timing();
+
+	if (!quiet) {
+		printf("# %s\n# %stime [s]\tfrequency [Hz]\tMIDI\tnote", filename.c_str(), numChannels > 1 ? "channel\t" : "");
+		if (options.config.tuningMode != SpectrumAnalyzer::kTuningOff) printf("\ttarget [Hz]\tcents\tlock");
+		printf("\n");
+	}
+
+	// Threaded mode: the worker runs as an auxiliary task
+	WorkerContext workerContext = {&analyzers, &options};
+	AuxiliaryTask analysisTask = nullptr;
+	if (threaded) analysisTask = Bela_createAuxiliaryTask(analysis_task, BELA_AUDIO_PRIORITY - 10, "analysis-task", &workerContext);
+
+	// Stream the file block by block as the audio callback would. The
+	// processing time only covers the audio thread in threaded mode.
+	double processingTime = 0;
+	auto blockDeadline = std::chrono::steady_clock::now();
+	const auto blockDuration = std::chrono::duration<double>(blockSize / (double)sampleRate);
+	for (size_t start = 0; start + blockSize <= numFrames; start += blockSize) {
+		auto before = std::chrono::steady_clock::now();
+		bool newWindow;
+		{
+			// The block as the render() callback would see it
+			STAGE_TIMER(kStageRender);
+			newWindow = analyzers.process_block(&samples[start * numChannels], blockSize, numChannels, true);
+		}
+		if (!threaded) analyse_channels(analyzers, options);
+		auto after = std::chrono::steady_clock::now();
+		processingTime += std::chrono::duration<double>(after - before).count();
+
+		if (threaded) {
+			if (newWindow) Bela_scheduleAuxiliaryTask(analysisTask);
+			blockDeadline += std::chrono::duration_cast<std::chrono::steady_clock::duration>(blockDuration);
+			std::this_thread::sleep_until(blockDeadline);
+		}
+	}
+
+	// Stop the worker and analyse what it left behind
+	if (threaded) {
+		Bela_deleteAllAuxiliaryTasks();
+		analysis_task(&workerContext);
+	}
+
+	// Real-time factor: processing time of all channels divided by audio
+	// duration, printed with the last channel
+	double duration = numFrames / (double)sampleRate;
+	double rtf = processingTime / duration;
+	for (unsigned int channel = 0; channel < numChannels; channel++) {
+		const SpectrumAnalyzer& analyzer = *analyzers.slot(channel).audio_analyzer();
+		std::string label = filename;
+		if (numChannels > 1) label += " channel " + std::to_string(channel);
+		printf("%s: %.2f s audio, %u hops (%u dropped, %u late)", label.c_str(), duration, analyzer.hop_count(),
+			analyzer.dropped_windows(), analyzer.late_windows());
+		if (channel + 1 == numChannels) {
+			printf(", %.3f ms processing, real-time factor %.5f (%.0fx faster than real time)", processingTime * 1000.0,
+				rtf, rtf > 0 ? 1.0 / rtf : 0.0);
+		}
+		printf("\n");
+		printf("%s: %s detector, %.1f us mean, %.1f us max per hop\n", label.c_str(),
+			PitchDetector::type_name(options.config.detector), analyzer.detector().mean_cost_us(),
+			analyzer.detector().max_cost_us());
+		if (options.config.maxVoices > 0) {
+			printf("%s: polyphonic mode, up to %u voices, %.1f us mean, %.1f us max per hop\n", label.c_str(),
+				options.config.maxVoices, analyzer.polyphonic_detector().mean_cost_us(),
+				analyzer.polyphonic_detector().max_cost_us());
+		}
+		printf("%s: %u of %u hops skipped, %u by the gate and %u while tuned (FFT duty cycle %.0f%%)\n", label.c_str(),
+			analyzer.gated_hops() + analyzer.skipped_hops(), analyzer.total_hops(), analyzer.gated_hops(),
+			analyzer.skipped_hops(), 100.0 * (1 - analyzer.skipped_fraction()));
+	}
+#if STAGE_TIMING
+	printf("%s: stage timing, render budget %.1f us per block of %u frames\n", filename.c_str(),
+		1e6 * blockSize / sampleRate, blockSize);
+	print_stage_timing();
+#endif
+	return true;
+}
+
+int main(int argc, char *argv[]) {
+	TunerOptions options;
+
+	const struct option longOptions[] = {
+		{"quiet", no_argument, nullptr, 'q'},
+		{"block-size", required_argument, nullptr, 'b'},
+		{"channels", required_argument, nullptr, 'c'},
+		{"window", required_argument, nullptr, 'w'},
+		{"detector", required_argument, nullptr, 'D'},
+		{"fft-size", required_argument, nullptr, 'F'},
+		{"hop", required_argument, nullptr, 'H'},
+		{"levels", required_argument, nullptr, 'l'},
+		{"reference", required_argument, nullptr, 'r'},
+		{"follow", no_argument, nullptr, 'f'},
+		{"partials", no_argument, nullptr, 'p'},
+		{"voices", required_argument, nullptr, 'v'},
+		{"constant-q", required_argument, nullptr, 'Q'},
+		{"threaded", no_argument, nullptr, 't'},
+		{"interpolation", no_argument, nullptr, 'i'},
+		{"no-gate", no_argument, nullptr, 'n'},
+		{"silence", required_argument, nullptr, 's'},
+		{"help", no_argument, nullptr, 'h'},
+		{nullptr, 0, nullptr, 0}
+	};
+
+	int c;
+	while ((c = getopt_long(argc, argv, "qb:c:w:D:F:H:l:r:fpv:Q:tins:h", longOptions, nullptr)) != -1) {
+		switch (c) {
+			case 'q':
+				options.quiet = true;
+				break;
+			case 'b':
+				options.blockSize = atoi(optarg);
+				if (options.blockSize == 0) {
+					usage(argv[0]);
+					return 1;
+				}
+				break;
+			case 'c':
+				options.numChannels = atoi(optarg);
+				if (options.numChannels > MultiChannelAnalyzer::kMaxChannels) {
+					usage(argv[0]);
+					return 1;
+				}
+				break;
+			case 'w':
+				if (!SpectrumStage::window_from_name(optarg, options.config.window)) {
+					usage(argv[0]);
+					return 1;
+				}
+				break;
+			case 'D':
+				if (!PitchDetector::type_from_name(optarg, options.config.detector)) {
+					usage(argv[0]);
+					return 1;
+				}
+				break;
+			case 'F':
+				options.config.levelFftSize = atoi(optarg);
+				break;
+			case 'H':
+				options.config.hopSize = atoi(optarg);
+				break;
+			case 'l':
+				options.config.numLevels = atoi(optarg);
+				break;
+			case 'r':
+				options.config.tuningReference = atof(optarg);
+				if (options.config.tuningReference <= 0) {
+					usage(argv[0]);
+					return 1;
+				}
+				options.config.tuningMode = SpectrumAnalyzer::kTuningReference;
+				break;
+			case 'f':
+				options.config.tuningMode = SpectrumAnalyzer::kTuningFollow;
+				break;
+			case 'p':
+				options.partials = true;
+				break;
+			case 'v':
+				options.config.maxVoices = atoi(optarg);
+				if (options.config.maxVoices == 0 || options.config.maxVoices > PolyphonicDetector::kMaxVoices) {
+					usage(argv[0]);
+					return 1;
+				}
+				break;
+			case 'Q':
+				options.config.constantQBinsPerOctave = atoi(optarg);
+				if (options.config.constantQBinsPerOctave == 0 ||
+					options.config.constantQBinsPerOctave > ConstantQKernel::kMaxBinsPerOctave) {
+					usage(argv[0]);
+					return 1;
+				}
+				break;
+			case 't':
+				options.threaded = true;
+				break;
+			case 'i':
+				options.config.phaseRefinement = false;
+				break;
+			case 'n':
+				options.config.gate.enabled = false;
+				break;
+			case 's':
+				options.config.gate.silenceDb = atof(optarg);
+				break;
+			case 'h':
+			default:
+				usage(argv[0]);
+				return c == 'h' ? 0 : 1;
+		}
+	}
+
+	if (optind >= argc) {
+		usage(argv[0]);
+		return 1;
+	}
+
+	// Batch over all given files, the exit code counts the failures
+	int failures = 0;
+	for (int i = optind; i < argc; i++) {
+		if (!analyse_file(argv[i], options)) failures++;
+	}
+	return failures;
+}
@@ -0,0 +1,96 @@
+/***** AnalysisGate.cpp *****/
+/* Class implementation of the level and onset gate in front of the FFT
+ * path
+ *
+ * ECS7012P - Queen Mary University of London
+ * Final project, Max Tamussino
+ */
+
+#include <cmath>
+#include <vector>
+#include <libraries/math_neon/math_neon.h>
+#include "AnalysisGate.h"
+
+// Allocate the band sums (NOT REAL-TIME SAFE, use at beginning)
+bool AnalysisGate::setup(unsigned int numBands, const Settings& settings) {
+	if (numBands == 0) return false;
+	settings_ = settings;
+	sumSquares_.assign(numBands, 0);
+	counts_.assign(numBands, 0);
+	bandDb_.assign(numBands, settings_.silenceDb);
+	frameCounter_ = 0;
+	state_ = kStateSilent;
+	levelDb_ = -200;
+	fluxDb_ = 0;
+	onsetHopsLeft_ = 0;
+	hopsSinceAnalysis_ = 0;
+	return true;
+}
+
+// Only a sum of squares per sample, the lower levels have few samples
+void AnalysisGate::process_band(unsigned int band, const float *samples, unsigned int frames) {
+	if (!settings_.enabled) return;
+	float sum = 0;
+	for (unsigned int n = 0; n < frames; n++) sum += samples[n] * samples[n];
+	sumSquares_[band] += sum;
+	counts_[band] += frames;
+}
+
+// Level n holds the energy below its passband edge, so the energy of the
+// octave band between two levels is the difference of their mean squares.
+// The bands are floored at the silence threshold, so that noise does not
+// add to the flux.
+void AnalysisGate::end_chunk(unsigned int inputFrames) {
+	if (!settings_.enabled) return;
+	frameCounter_ += inputFrames;
+	if (frameCounter_ < kFrameSize) return;
+	frameCounter_ = 0;
+
+	const unsigned int numBands = sumSquares_.size();
+	const float dbScale = 10.0f / (float)M_LN10;
+	float meanSquare = 0, below = 0;
+	fluxDb_ = 0;
+	for (int band = numBands - 1; band >= 0; band--) {
+		meanSquare = counts_[band] > 0 ? sumSquares_[band] / counts_[band] : 0;
+		float energy = meanSquare - below;
+		below = meanSquare;
+		float db = dbScale * logf_neon(energy > 1e-20f ? energy : 1e-20f);
+		if (db < settings_.silenceDb) db = settings_.silenceDb;
+		if (db > bandDb_[band]) fluxDb_ += db - bandDb_[band];
+		bandDb_[band] = db;
+		sumSquares_[band] = 0;
+		counts_[band] = 0;
+	}
+	levelDb_ = dbScale * logf_neon(meanSquare > 1e-20f ? meanSquare : 1e-20f);
+
+	// A note rising out of silence has a large flux, as its bands start
+	// from the floor, while a decaying note which only beats around the
+	// threshold comes back as a sustain
+	float threshold = settings_.silenceDb + (state_ == kStateSilent ? kHysteresisDb : 0);
+	if (levelDb_ < threshold) {
+		state_ = kStateSilent;
+		onsetHopsLeft_ = 0;
+	} else if (fluxDb_ > settings_.onsetDb) {
+		state_ = kStateOnset;
+		onsetHopsLeft_ = settings_.onsetHops;
+	} else if (state_ == kStateSilent) {
+		state_ = kStateSustain;
+	}
+}
+
+// Dense hops after an onset, then one in sustainHopInterval
+bool AnalysisGate::analyse_hop() {
+	if (!settings_.enabled) return true;
+	if (state_ == kStateSilent) return false;
+	if (state_ == kStateOnset) {
+		if (onsetHopsLeft_ > 0) {
+			if (--onsetHopsLeft_ == 0) state_ = kStateSustain;
+			hopsSinceAnalysis_ = 0;
+			return true;
+		}
+		state_ = kStateSustain;
+	}
+	if (++hopsSinceAnalysis_ < settings_.sustainHopInterval) return false;
+	hopsSinceAnalysis_ = 0;
+	return true;
+}
@@ -0,0 +1,81 @@
+/***** AnalysisGate.h *****/
+/* Class implementation of the level and onset gate in front of the FFT
+ * path. It runs on the audio thread on the outputs of the decimation
+ * pyramid: every frame of kFrameSize input samples it takes the mean
+ * square of each level, which gives the energy of the octave bands
+ * between the levels, the RMS level of the input and the spectral flux
+ * of these bands (the summed rise in dB since the previous frame).
+ *
+ * Below the silence threshold no hop is analysed and the last result is
+ * held. An onset (a rise of the band energies) makes the following hops
+ * dense again, and once the note is steady only every few hops are
+ * analysed.
+ *
+ * ECS7012P - Queen Mary University of London
+ * Final project, Max Tamussino
+ */
+
+#pragma once
+#include <vector>
+
+class AnalysisGate {
+public:
+	// Gate parameters
+	static const int kFrameSize = 2048;	// Input samples per gate frame
+	static constexpr float kHysteresisDb = 3;	// Rise above the silence threshold to leave silence
+
+	// Settings which can be chosen per instance
+	struct Settings {
+		bool enabled = true;
+		float silenceDb = -60;	// RMS level below which nothing is analysed [dBFS]
+		float onsetDb = 9;	// Flux of the band energies that counts as an onset [dB]
+		unsigned int onsetHops = 4;	// Hops analysed densely after an onset
+		unsigned int sustainHopInterval = 4;	// Every how many hops a steady note is analysed
+	};
+
+	// Gate state after the last frame
+	enum State { kStateSilent, kStateOnset, kStateSustain };
+
+	// Constructor
+	AnalysisGate() {}
+
+	// Setup (NOT REAL-TIME SAFE), for numBands levels of the pyramid
+	bool setup(unsigned int numBands, const Settings& settings);
+
+	// Add the output of one level of the pyramid for the current chunk
+	void process_band(unsigned int band, const float *samples, unsigned int frames);
+
+	// End the chunk of the given number of input samples, evaluates the
+	// frame once it is complete
+	void end_chunk(unsigned int inputFrames);
+
+	// Called at every hop: true if the hop is to be analysed
+	bool analyse_hop();
+
+	State state() const { return state_; }
+	bool enabled() const { return settings_.enabled; }
+	const Settings& settings() const { return settings_; }
+
+	// RMS level of the input and band flux of the last frame [dB]
+	float level_db() const { return levelDb_; }
+	float flux_db() const { return fluxDb_; }
+
+	// Destructor
+	~AnalysisGate() {}
+
+private:
+	Settings settings_;
+
+	// Sums of squares and sample counts of the current frame per band, and
+	// the band energies of the previous frame in dB
+	std::vector<float> sumSquares_;
+	std::vector<unsigned int> counts_;
+	std::vector<float> bandDb_;
+	unsigned int frameCounter_ = 0;
+
+	State state_ = kStateSilent;
+	float levelDb_ = -200;
+	float fluxDb_ = 0;
+	unsigned int onsetHopsLeft_ = 0;
+	unsigned int hopsSinceAnalysis_ = 0;
+};
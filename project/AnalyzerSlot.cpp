@@ -0,0 +1,93 @@
+/***** AnalyzerSlot.cpp *****/
+/* Class implementation of the slot holding the running SpectrumAnalyzer
+ *
+ * ECS7012P - Queen Mary University of London
+ * Final project, Max Tamussino
+ */
+
+#include <atomic>
+#include "AnalyzerSlot.h"
+
+// Constructor, no analyzer until setup
+AnalyzerSlot::AnalyzerSlot() : active_(nullptr), pending_(nullptr), retired_(nullptr), swaps_(0) {
+	for (unsigned int r = 0; r < kMaxReaders; r++) hazards_[r].store(nullptr);
+}
+
+// Create the first analyzer (NOT REAL-TIME SAFE, use at beginning)
+bool AnalyzerSlot::setup(float sampleRate, const SpectrumAnalyzer::Config& config) {
+	SpectrumAnalyzer *analyzer = new SpectrumAnalyzer;
+	if (!analyzer->setup(sampleRate, config)) {
+		delete analyzer;
+		return false;
+	}
+	sampleRate_ = sampleRate;
+	config_ = config;
+	delete active_.exchange(analyzer);
+	delete pending_.exchange(nullptr);
+	delete retired_.exchange(nullptr);
+	swaps_.store(0);
+	return true;
+}
+
+// All allocation happens here. Whichever of this thread and the audio
+// thread exchanges the pending analyzer first owns it, so one that the
+// audio thread has not picked up yet can be replaced safely.
+bool AnalyzerSlot::reconfigure(const SpectrumAnalyzer::Config& config) {
+	collect();
+	SpectrumAnalyzer *analyzer = new SpectrumAnalyzer;
+	if (!analyzer->setup(sampleRate_, config)) {
+		delete analyzer;
+		return false;
+	}
+	config_ = config;
+	delete pending_.exchange(analyzer);
+	return true;
+}
+
+// The audio thread only swaps while nothing is retired, so there is at
+// most one analyzer waiting to be deleted
+void AnalyzerSlot::collect() {
+	SpectrumAnalyzer *retired = retired_.load();
+	if (retired == nullptr) return;
+	for (unsigned int r = 0; r < kMaxReaders; r++) {
+		if (hazards_[r].load() == retired) return;
+	}
+	delete retired;
+	retired_.store(nullptr);
+}
+
+// Two exchanges and a store, no locks or allocation
+SpectrumAnalyzer* AnalyzerSlot::audio_analyzer() {
+	if (pending_.load(std::memory_order_relaxed) != nullptr && retired_.load() == nullptr) {
+		SpectrumAnalyzer *analyzer = pending_.exchange(nullptr);
+		if (analyzer != nullptr) {
+			retired_.store(active_.exchange(analyzer));
+			swaps_.fetch_add(1, std::memory_order_relaxed);
+		}
+	}
+	return active_.load(std::memory_order_relaxed);
+}
+
+// The hazard pointer is published before the active analyzer is read
+// again: if it is still the same, collect() will see the hazard before it
+// can delete it
+SpectrumAnalyzer* AnalyzerSlot::acquire(unsigned int reader) {
+	SpectrumAnalyzer *analyzer = active_.load();
+	while (true) {
+		hazards_[reader].store(analyzer);
+		SpectrumAnalyzer *current = active_.load();
+		if (current == analyzer) return analyzer;
+		analyzer = current;
+	}
+}
+
+void AnalyzerSlot::release(unsigned int reader) {
+	hazards_[reader].store(nullptr);
+}
+
+// Delete all analyzers, no thread may use the slot any more
+AnalyzerSlot::~AnalyzerSlot() {
+	delete active_.load();
+	delete pending_.load();
+	delete retired_.load();
+}
@@ -0,0 +1,74 @@
+/***** AnalyzerSlot.h *****/
+/* Class implementation of the slot holding the running SpectrumAnalyzer,
+ * so that it can be reconfigured while the audio thread uses it. A new
+ * analyzer is allocated and set up on a non real-time thread and left
+ * pending; the audio thread swaps it in at the start of its next block
+ * with a single atomic exchange, so that it never waits or allocates.
+ *
+ * The workers reading the results (analysis and tuning tasks) announce
+ * the analyzer they use in a hazard pointer of their own. The analyzer
+ * replaced by a swap is only deleted once no worker holds it any more.
+ *
+ * The new analyzer starts with empty buffers: the previous result stays
+ * on the GUI until its first hop is analysed.
+ *
+ * ECS7012P - Queen Mary University of London
+ * Final project, Max Tamussino
+ */
+
+#pragma once
+#include <atomic>
+#include "SpectrumAnalyzer.h"
+
+class AnalyzerSlot {
+public:
+	static const int kMaxReaders = 4;	// Worker threads which may acquire the analyzer
+
+	// Constructor
+	AnalyzerSlot();
+
+	// Setup (NOT REAL-TIME SAFE), creates the first analyzer. Returns
+	// false if the configuration is invalid.
+	bool setup(float sampleRate, const SpectrumAnalyzer::Config& config);
+
+	// Non real-time thread: set up a new analyzer to be swapped in by the
+	// audio thread. An analyzer still pending from an earlier call is
+	// replaced. Returns false if the configuration is invalid, the running
+	// analyzer is kept in that case. Only one thread may call reconfigure()
+	// and collect().
+	bool reconfigure(const SpectrumAnalyzer::Config& config);
+
+	// Non real-time thread: delete the analyzer replaced by the last swap,
+	// once no worker holds it any more
+	void collect();
+
+	// Audio thread: swap in a pending analyzer and return the active one
+	SpectrumAnalyzer* audio_analyzer();
+
+	// Workers: the active analyzer, held until release() (reader is the
+	// number of the worker, below kMaxReaders)
+	SpectrumAnalyzer* acquire(unsigned int reader);
+	void release(unsigned int reader);
+
+	// Configuration of the last successful setup or reconfigure() (only to
+	// be read by the thread calling reconfigure()), and number of swaps
+	const SpectrumAnalyzer::Config& config() const { return config_; }
+	unsigned int swaps() const { return swaps_.load(std::memory_order_relaxed); }
+
+	// Destructor
+	~AnalyzerSlot();
+
+private:
+	float sampleRate_ = 0;
+	SpectrumAnalyzer::Config config_;
+
+	// Analyzer in use, set up and waiting for the audio thread, and
+	// replaced but maybe still held by a worker
+	std::atomic<SpectrumAnalyzer*> active_;
+	std::atomic<SpectrumAnalyzer*> pending_;
+	std::atomic<SpectrumAnalyzer*> retired_;
+
+	// Analyzer held by every worker (nullptr if none)
+	std::atomic<SpectrumAnalyzer*> hazards_[kMaxReaders];
+	std::atomic<unsigned int> swaps_;
+};
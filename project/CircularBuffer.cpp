@@ -6,6 +6,7 @@
  */
 
 #include <Bela.h>
+#include <algorithm>
 #include <vector>
 #include "CircularBuffer.h"
 
@@ -18,22 +19,12 @@ CircularBuffer<T>::CircularBuffer(unsigned int _length) : bufferLength_(_length)
 // Set up the buffer (NOT REAL-TIME SAFE, use at beginning)
 template <typename T>
 void CircularBuffer<T>::setup() {
-	// Allocate enough memory during setup
-	buffer_.resize(bufferLength_);
+	// Allocate enough memory during setup (mirrored copy included)
+	buffer_.resize(2 * bufferLength_);
 	writePointer_ = 0;
 	setupDone_ = true;
 }
 
-// Write new element into buffer
-template <typename T>
-void CircularBuffer<T>::write_element(T _element) {
-	// Write new element
-	buffer_[writePointer_] = _element;
-	
-	// Increase and wrap the write pointer
-	if (++writePointer_ == bufferLength_) writePointer_ = 0;
-}
-
 // This function returns a vector of N last elements, N being an arbitrary
 // input to the function. It is NOT REAL-TIME SAFE! A new std::vector is 
 // allocated and resized.
@@ -47,17 +38,23 @@ std::vector<T> CircularBuffer<T>::get_last_N_elements(unsigned int _N) {
 	if (_N > bufferLength_) return returnBuffer;
 	
 	// Fill return buffer with the last N samples
-	for (int i = 0; i < _N; i++) {
-		// Calculate new index, which is N-i samples back and needs to be wrapped
-		int index = (writePointer_ - _N + bufferLength_ + i) % bufferLength_;
-		
-		// Write in buffer (starting from end)
-		returnBuffer[i] = buffer_[index];
-	}
+	const T* view = get_last_N_view(_N);
+	std::copy(view, view + _N, returnBuffer.begin());
 	
 	return returnBuffer;
 }
 
+// Returns a pointer to the last N elements, which are contiguous thanks to
+// the mirrored copy. No element is copied and no index has to be wrapped.
+template <typename T>
+const T* CircularBuffer<T>::get_last_N_view(unsigned int _N) const {
+	// Check if N is valid (<= buffer size)
+	if (_N > bufferLength_) return nullptr;
+	
+	// The last N elements end right before the mirrored write position
+	return &buffer_[writePointer_ + bufferLength_ - _N];
+}
+
 // Returns one element which was put into the buffer N elements ago,
 // N being an arbitrary number
 template <typename T>
@@ -65,10 +62,8 @@ T CircularBuffer<T>::get_element_N_ago(unsigned int _N) {
 	// Check if N is valid (<= buffer size)
 	if (_N > bufferLength_) return 0;
 	
-	// Calculate wrapped index
-	int index = (writePointer_ - _N + bufferLength_) % bufferLength_;
-	
-	return buffer_[index];
+	// Index into the mirrored copy, which needs no wrapping
+	return buffer_[writePointer_ + bufferLength_ - _N];
 }
 
 template class CircularBuffer<float>;
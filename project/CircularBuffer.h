@@ -1,5 +1,9 @@
 /***** CircularBuffer.h *****/
 /* Class implementation of a circular buffer
+ *
+ * The buffer is stored twice ("mirrored"): every element is written at its
+ * position and once more one buffer length later. Any run of the last N
+ * elements is therefore contiguous in memory and can be read in place.
  *
  * ECS7012P - Queen Mary University of London
  * Final project, Max Tamussino
@@ -18,13 +22,21 @@ public:
 	// Setup (must be called during Bela setup)
 	void setup();
 	
-	// Add new value
-	void write_element(T _element);
+	// Add new value and its mirror (inline, as it is called for every sample)
+	void write_element(T _element) {
+		buffer_[writePointer_] = _element;
+		buffer_[writePointer_ + bufferLength_] = _element;
+		if (++writePointer_ == bufferLength_) writePointer_ = 0;
+	}
 	T get_element_N_ago(unsigned int _N);
 	
 	// Get last N elements
 	std::vector<T> get_last_N_elements(unsigned int _N);
 	
+	// Non-owning view of the last N elements, oldest first (nullptr if N
+	// is larger than the buffer). Valid until the next write_element().
+	const T* get_last_N_view(unsigned int _N) const;
+	
 	// Destructor
 	~CircularBuffer() {}
 	
@@ -33,6 +45,6 @@ protected:
 	unsigned int bufferLength_, writePointer_;
 	bool setupDone_ = false;
 	
-	// Buffer
+	// Buffer (twice the buffer length, see above)
 	std::vector<T> buffer_;
 };
@@ -7,6 +7,7 @@
  */
  
 #include <Bela.h>
+#include <algorithm>
 #include <vector>
 #include "CircularBufferStaticReturn.h"
 
@@ -28,20 +29,16 @@ void CircularBufferStaticReturn<T>::setup() {
 
 // This function returns a vector of last elements, the number of which being
 // specified at the construction of the class. It is real-time safe, as the
-// memory needed is already allocated when the buffer is set up.
+// memory needed is already allocated when the buffer is set up. The vector
+// is returned by reference: returning the member by value would copy it into
+// a newly allocated vector, since copy elision does not apply to members.
+// Use get_last_N_view() to read the elements without any copy.
 template <typename T>
-std::vector<T> CircularBufferStaticReturn<T>::get_last_elements() {
-	// Fill return buffer with the last N samples
-	for (int i = 0; i < returnBufferLength_; i++) {
-		// Calculate new index, which is N-i samples back and needs to be wrapped
-		int index = (this->writePointer_ - returnBufferLength_ + this->bufferLength_ + i) % this->bufferLength_;
-		
-		// Write in buffer (starting from end)
-		returnBuffer_[i] = this->buffer_[index];
-	}
+const std::vector<T>& CircularBufferStaticReturn<T>::get_last_elements() {
+	// Fill return buffer with the last N samples in one contiguous copy
+	const T* view = this->get_last_N_view(returnBufferLength_);
+	std::copy(view, view + returnBufferLength_, returnBuffer_.begin());
 	
-	// This deliberately uses "return by value", which is specified preferred
-	// since the C++11 standard, because most compilers support "copy elision"
 	return returnBuffer_;
 }
 
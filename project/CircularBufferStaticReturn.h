@@ -21,7 +21,8 @@ public:
 	void setup();
 	
 	// Get last elements, the number of which is specified in the constructor
-	std::vector<T> get_last_elements();
+	// (the reference stays valid, its contents change with the next call)
+	const std::vector<T>& get_last_elements();
 	
 	// Destructor
 	~CircularBufferStaticReturn() {}
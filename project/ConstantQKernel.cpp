@@ -0,0 +1,110 @@
+/***** ConstantQKernel.cpp *****/
+/* Class implementation of the constant-Q transform of one octave with a
+ * sparse spectral kernel
+ *
+ * ECS7012P - Queen Mary University of London
+ * Final project, Max Tamussino
+ */
+
+#include <algorithm>
+#include <cmath>
+#include <complex>
+#include <vector>
+#include "ConstantQKernel.h"
+#include "Simd.h"
+
+// Transform the windowed exponential of every bin and keep the run of
+// coefficients above the threshold (NOT REAL-TIME SAFE, use at beginning)
+bool ConstantQKernel::setup(unsigned int fftSize, unsigned int binsPerOctave, float firstFrequency,
+							const std::vector<float>& windowTable, float threshold) {
+	if (fftSize < 8 || (fftSize & (fftSize - 1)) != 0 || windowTable.size() != fftSize) return false;
+	if (binsPerOctave == 0 || binsPerOctave > kMaxBinsPerOctave) return false;
+	if (firstFrequency <= 0 || 2 * firstFrequency >= 0.5) return false;
+	fftSize_ = fftSize;
+	binsPerOctave_ = binsPerOctave;
+	firstFrequency_ = firstFrequency;
+
+	// Q periods per bin, fewer if the lowest bin would not fit
+	q_ = 1.0 / (pow(2.0, 1.0 / binsPerOctave) - 1.0);
+	if (q_ / firstFrequency > kMaxLengthRatio * fftSize) q_ = kMaxLengthRatio * fftSize * firstFrequency;
+
+	firstFftBin_.resize(binsPerOctave);
+	runStart_.resize(binsPerOctave);
+	runLength_.resize(binsPerOctave);
+	kernelRe_.clear();
+	kernelIm_.clear();
+	const unsigned int numFftBins = fftSize / 2;
+	std::vector<std::complex<double> > exponential(fftSize), transform(numFftBins), twiddles(fftSize);
+	for (unsigned int n = 0; n < fftSize; n++) twiddles[n] = std::polar(1.0, -2 * M_PI * n / fftSize);
+	for (unsigned int bin = 0; bin < binsPerOctave; bin++) {
+		// Hann windowed exponential of the bin, centred in the frame and
+		// scaled to give the amplitude of a sinusoid, over the window of
+		// the FFT input
+		const double frequency = bin_frequency(bin);
+		const unsigned int length = std::max(4L, lround(q_ / frequency));
+		const unsigned int start = (fftSize - length) / 2;
+		const double scale = 2.0 / (length / 2.0);
+		for (unsigned int n = 0; n < fftSize; n++) {
+			exponential[n] = 0;
+			if (n < start || n >= start + length || windowTable[n] < 1e-6) continue;
+			double window = 0.5 - 0.5 * cos(2 * M_PI * (n - start + 0.5) / length);
+			double phase = 2 * M_PI * frequency * ((double)n - fftSize / 2);
+			exponential[n] = std::polar(scale * window / windowTable[n], phase);
+		}
+
+		// Its positive frequency bins, conjugated and divided by the FFT size
+		double largest = 0;
+		for (unsigned int k = 0; k < numFftBins; k++) {
+			std::complex<double> sum = 0;
+			for (unsigned int n = start; n < start + length; n++) {
+				sum += exponential[n] * twiddles[(k * n) & (fftSize - 1)];
+			}
+			transform[k] = std::conj(sum) / (double)fftSize;
+			largest = std::max(largest, std::abs(transform[k]));
+		}
+
+		// The run from the first to the last coefficient above the
+		// threshold, padded to a multiple of four within the bins
+		unsigned int first = numFftBins, last = 0;
+		for (unsigned int k = 0; k < numFftBins; k++) {
+			if (std::abs(transform[k]) < threshold * largest) continue;
+			if (k < first) first = k;
+			last = k;
+		}
+		if (first > last) first = last = 0;
+		unsigned int length4 = (last - first + 4) & ~3u;
+		if (first + length4 > numFftBins) first = numFftBins - length4;
+		firstFftBin_[bin] = first;
+		runStart_[bin] = kernelRe_.size();
+		runLength_[bin] = length4;
+		for (unsigned int k = first; k < first + length4; k++) {
+			kernelRe_.push_back(transform[k].real());
+			kernelIm_.push_back(transform[k].imag());
+		}
+	}
+	return true;
+}
+
+float ConstantQKernel::bin_frequency(unsigned int bin) const {
+	return firstFrequency_ * powf(2.0, (float)bin / binsPerOctave_);
+}
+
+// Complex inner product of every run with the FFT bins, four bins at a time
+void ConstantQKernel::process(const float *fftBins, float *out) const {
+	for (unsigned int bin = 0; bin < binsPerOctave_; bin++) {
+		const float *bins = fftBins + 2 * firstFftBin_[bin];
+		const float *kernelRe = &kernelRe_[runStart_[bin]];
+		const float *kernelIm = &kernelIm_[runStart_[bin]];
+		float4 sumRe = splat4(0.0f), sumIm = splat4(0.0f);
+		for (unsigned int k = 0; k < runLength_[bin]; k += 4) {
+			float4 re, im;
+			deinterleave4(load4(bins + 2 * k), load4(bins + 2 * k + 4), re, im);
+			float4 kRe = load4(kernelRe + k), kIm = load4(kernelIm + k);
+			sumRe += re * kRe - im * kIm;
+			sumIm += re * kIm + im * kRe;
+		}
+		float re = sumRe[0] + sumRe[1] + sumRe[2] + sumRe[3];
+		float im = sumIm[0] + sumIm[1] + sumIm[2] + sumIm[3];
+		out[bin] = sqrtf(re * re + im * im);
+	}
+}
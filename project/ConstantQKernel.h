@@ -0,0 +1,72 @@
+/***** ConstantQKernel.h *****/
+/* Class implementation of a constant-Q transform of one octave applied to
+ * the bins of an existing FFT, with the sparse spectral kernel of Brown
+ * and Puckette: every constant-Q bin is the inner product of the windowed
+ * input with a windowed complex exponential of its own length, which by
+ * Parseval's theorem equals the inner product of the FFT bins with the
+ * transform of that exponential. The transform is concentrated around the
+ * bin frequency, so all coefficients below kThreshold of the largest one
+ * are dropped and every bin only costs a few complex multiplications.
+ *
+ * The FFT input has already been windowed (SpectrumStage), so the kernel
+ * divides that window out of the exponential before the transform. The
+ * bins of one octave cover the same fraction of the sample rate on every
+ * level of the pyramid, so one kernel serves all levels.
+ *
+ * The bin of frequency f needs Q periods of f, Q = 1 / (2^(1 / B) - 1)
+ * for B bins per octave. Exponentials longer than kMaxLengthRatio of the
+ * FFT size are shortened to it, so a small FFT gives a lower Q (wider
+ * bins) than its number of bins per octave would ask for.
+ *
+ * ECS7012P - Queen Mary University of London
+ * Final project, Max Tamussino
+ */
+
+#pragma once
+#include <vector>
+
+class ConstantQKernel {
+public:
+	static const int kMaxBinsPerOctave = 96;
+	static constexpr float kThreshold = 0.005;	// Smallest coefficient kept, relative to the largest of its bin
+	static constexpr float kMaxLengthRatio = 0.75;	// Longest exponential, relative to the FFT size
+
+	// Constructor
+	ConstantQKernel() {}
+
+	// Setup (NOT REAL-TIME SAFE) for an FFT of fftSize samples windowed by
+	// windowTable, with binsPerOctave bins from firstFrequency on (relative
+	// to the sample rate, the octave has to end below 1/2). A threshold of
+	// 0 keeps all coefficients (the dense kernel). Returns false if the
+	// settings are out of range.
+	bool setup(unsigned int fftSize, unsigned int binsPerOctave, float firstFrequency,
+			   const std::vector<float>& windowTable, float threshold = kThreshold);
+
+	// Amplitudes of the binsPerOctave bins from the interleaved bins
+	// 0 to fftSize/2-1 of the FFT
+	void process(const float *fftBins, float *out) const;
+
+	// Settings and size of the kernel
+	unsigned int bins_per_octave() const { return binsPerOctave_; }
+	float q() const { return q_; }
+	float bin_frequency(unsigned int bin) const;	// Relative to the sample rate
+	unsigned int num_coefficients() const { return kernelRe_.size(); }
+
+	// Destructor
+	~ConstantQKernel() {}
+
+private:
+	unsigned int fftSize_ = 0;
+	unsigned int binsPerOctave_ = 0;
+	float firstFrequency_ = 0;
+	float q_ = 0;
+
+	// Every bin has a run of coefficients (a multiple of four long) from
+	// its first FFT bin on, stored one after the other with real and
+	// imaginary parts apart
+	std::vector<unsigned int> firstFftBin_;
+	std::vector<unsigned int> runStart_;
+	std::vector<unsigned int> runLength_;
+	std::vector<float> kernelRe_;
+	std::vector<float> kernelIm_;
+};
@@ -0,0 +1,193 @@
+/***** Decimator.cpp *****/
+/* Class implementation of a multi-stage decimator built from half-band
+ * FIR lowpass stages
+ *
+ * ECS7012P - Queen Mary University of London
+ * Final project, Max Tamussino
+ */
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <vector>
+#include "Decimator.h"
+
+// Zeroth order modified Bessel function of the first kind (for the Kaiser window)
+static double bessel_i0(double x) {
+	double sum = 1.0, term = 1.0;
+	for (int k = 1; k < 50; k++) {
+		term *= (x / (2.0 * k)) * (x / (2.0 * k));
+		sum += term;
+		if (term < 1e-12 * sum) break;
+	}
+	return sum;
+}
+
+// Design a Kaiser-windowed half-band filter (NOT REAL-TIME SAFE, use at beginning)
+void HalfBandDecimator::setup(float passband, float attenuationDb, unsigned int maxBlockSize) {
+	// Kaiser estimate of the length for the transition band between the
+	// passband edge and its mirror image around a quarter of the sample rate
+	double transition = 2.0 * M_PI * (0.5 - 2.0 * passband);
+	int length = ceil((attenuationDb - 7.95) / (2.285 * transition)) + 1;
+
+	// Half-band filters need a length of 4k+3 to have non-zero outer taps
+	if (length < 3) length = 3;
+	while (length % 4 != 3) length++;
+	numTaps_ = length;
+
+	// Kaiser window shape parameter for the attenuation
+	double beta = 0;
+	if (attenuationDb > 50) beta = 0.1102 * (attenuationDb - 8.7);
+	else if (attenuationDb > 21) beta = 0.5842 * pow(attenuationDb - 21, 0.4) + 0.07886 * (attenuationDb - 21);
+
+	// Windowed sinc with the cutoff at a quarter of the sample rate. Only
+	// the taps at an odd distance from the centre are non-zero, and of
+	// those only one of each symmetric pair is stored.
+	int centre = (length - 1) / 2;
+	pairCoefficients_.clear();
+	double sum = 0;
+	for (int j = 0; j < centre; j += 2) {
+		double t = j - centre;
+		double window = bessel_i0(beta * sqrt(1.0 - (t / centre) * (t / centre))) / bessel_i0(beta);
+		double h = sin(M_PI * t / 2.0) / (M_PI * t) * window;
+		pairCoefficients_.push_back(h);
+		sum += 2 * h;
+	}
+
+	// Normalise to unity gain at DC (the centre tap is 0.5)
+	for (unsigned int k = 0; k < pairCoefficients_.size(); k++) {
+		pairCoefficients_[k] *= 0.5 / sum;
+	}
+
+	// Allocate the history for the largest block
+	historyLength_ = numTaps_ - 1;
+	history_.resize(historyLength_ + maxBlockSize);
+	reset();
+}
+
+// Clear the filter state, the next input sample produces an output
+void HalfBandDecimator::reset() {
+	std::fill(history_.begin(), history_.end(), 0);
+	outputOnNext_ = true;
+}
+
+// Filter a block of samples and keep every second output
+unsigned int HalfBandDecimator::process(const float *input, unsigned int frames, float *output) {
+	// Append the block to the history
+	float *x = history_.data();
+	memcpy(x + historyLength_, input, frames * sizeof(float));
+	unsigned int total = historyLength_ + frames;
+
+	// Position of the newest sample of the first output
+	unsigned int first = historyLength_ + (outputOnNext_ ? 0 : 1);
+	unsigned int count = first < total ? (total - 1 - first) / 2 + 1 : 0;
+
+	// Centre tap, then the symmetric pairs, each one as a whole pass over
+	// the outputs, so that the inner loops vectorise
+	const float *xFirst = x + first;
+	const float *xCentre = xFirst - historyLength_ / 2;
+	for (unsigned int m = 0; m < count; m++) {
+		output[m] = 0.5f * xCentre[2 * m];
+	}
+	for (unsigned int k = 0; k < pairCoefficients_.size(); k++) {
+		const float coefficient = pairCoefficients_[k];
+		const float *newer = xFirst - 2 * k;
+		const float *older = xFirst - historyLength_ + 2 * k;
+		for (unsigned int m = 0; m < count; m++) {
+			output[m] += coefficient * (newer[2 * m] + older[2 * m]);
+		}
+	}
+
+	// Phase of the next block and history for it
+	outputOnNext_ = ((total - first) % 2) == 0;
+	memmove(x, x + frames, historyLength_ * sizeof(float));
+
+	return count;
+}
+
+
+// Set up the cascade of half-band stages (NOT REAL-TIME SAFE, use at beginning)
+bool Decimator::setup(unsigned int factor, unsigned int maxBlockSize, float passband, float attenuationDb) {
+	// The factor must be a power of two
+	if (factor == 0 || (factor & (factor - 1)) != 0) return false;
+	factor_ = factor;
+
+	unsigned int numStages = 0;
+	while ((1u << numStages) < factor) numStages++;
+	stages_.resize(numStages);
+
+	// Passband edge relative to the input sample rate. Each stage only has to
+	// keep its aliases out of this band, so the early stages (relative to
+	// their own rate) get a wide transition band and very few taps.
+	float passbandEdge = passband * 0.5 / factor;
+	unsigned int blockSize = maxBlockSize;
+	for (unsigned int s = 0; s < numStages; s++) {
+		stages_[s].setup(passbandEdge * (1u << s), attenuationDb, blockSize);
+		blockSize = blockSize / 2 + 1;
+	}
+
+	// Intermediate buffers for the largest block
+	scratch_[0].resize(maxBlockSize / 2 + 1);
+	scratch_[1].resize(maxBlockSize / 2 + 1);
+	return true;
+}
+
+// Clear the state of all stages
+void Decimator::reset() {
+	for (unsigned int s = 0; s < stages_.size(); s++) stages_[s].reset();
+}
+
+// Run the block through all stages, alternating between the scratch buffers
+unsigned int Decimator::process(const float *input, unsigned int frames, float *output) {
+	if (stages_.empty()) {
+		memmove(output, input, frames * sizeof(float));
+		return frames;
+	}
+
+	const float *in = input;
+	for (unsigned int s = 0; s < stages_.size(); s++) {
+		float *out = (s + 1 == stages_.size()) ? output : scratch_[s % 2].data();
+		frames = stages_[s].process(in, frames, out);
+		in = out;
+	}
+	return frames;
+}
+
+
+// Set up the decimator to level 0 and one half-band stage per further
+// level (NOT REAL-TIME SAFE, use at beginning)
+bool DecimationPyramid::setup(unsigned int numLevels, unsigned int maxBlockSize, unsigned int firstFactor,
+							  float passband, float attenuationDb) {
+	if (numLevels == 0) return false;
+	if (!first_.setup(firstFactor, maxBlockSize, passband, attenuationDb)) return false;
+	stages_.resize(numLevels - 1);
+	outputs_.resize(numLevels);
+	outputFrames_.assign(numLevels, 0);
+	
+	// Unlike the Decimator, every level is analysed itself, so each stage
+	// keeps the same part of its own output band
+	unsigned int blockSize = maxBlockSize / firstFactor + 1;
+	outputs_[0].resize(blockSize);
+	for (unsigned int level = 1; level < numLevels; level++) {
+		stages_[level - 1].setup(passband * 0.25, attenuationDb, blockSize);
+		blockSize = blockSize / 2 + 1;
+		outputs_[level].resize(blockSize);
+	}
+	return true;
+}
+
+// Clear the state of all stages
+void DecimationPyramid::reset() {
+	first_.reset();
+	for (unsigned int s = 0; s < stages_.size(); s++) stages_[s].reset();
+	outputFrames_.assign(outputFrames_.size(), 0);
+}
+
+// Each stage reads the output of the level before
+void DecimationPyramid::process(const float *input, unsigned int frames) {
+	outputFrames_[0] = first_.process(input, frames, outputs_[0].data());
+	for (unsigned int level = 1; level < outputs_.size(); level++) {
+		outputFrames_[level] = stages_[level - 1].process(outputs_[level - 1].data(), outputFrames_[level - 1],
+														  outputs_[level].data());
+	}
+}
@@ -0,0 +1,120 @@
+/***** Decimator.h *****/
+/* Class implementation of a multi-stage decimator: a cascade of half-band
+ * FIR lowpass stages, each one dropping every second sample. Whole blocks
+ * are processed and the filter state is carried across blocks, so any
+ * block length gives evenly spaced output samples. The same cascade with
+ * every intermediate rate kept is the multi-rate analysis pyramid.
+ *
+ * ECS7012P - Queen Mary University of London
+ * Final project, Max Tamussino
+ */
+
+#pragma once
+#include <vector>
+
+// One half-band lowpass stage with downsampling by 2
+class HalfBandDecimator {
+public:
+	// Constructor
+	HalfBandDecimator() {}
+
+	// Design the filter (NOT REAL-TIME SAFE). The passband edge and the
+	// stopband edge are given relative to the input sample rate, the
+	// stopband edge must be at least 0.5 minus the passband edge
+	void setup(float passband, float attenuationDb, unsigned int maxBlockSize);
+
+	// Filter and downsample a block, returns the number of output samples
+	unsigned int process(const float *input, unsigned int frames, float *output);
+
+	// Clear the filter state
+	void reset();
+
+	unsigned int num_taps() const { return numTaps_; }
+
+	// Destructor
+	~HalfBandDecimator() {}
+
+private:
+	// Impulse response: only the centre tap and every second tap are
+	// non-zero, the symmetric pairs of the latter are stored once
+	unsigned int numTaps_ = 0;
+	std::vector<float> pairCoefficients_;
+
+	// Input history (numTaps - 1 samples) followed by the current block
+	std::vector<float> history_;
+	unsigned int historyLength_ = 0;
+
+	// Whether the first sample of the next block produces an output
+	bool outputOnNext_ = false;
+};
+
+class Decimator {
+public:
+	// Constructor
+	Decimator() {}
+
+	// Setup (NOT REAL-TIME SAFE). The factor must be a power of two, one
+	// half-band stage is used per factor 2. The passband is given as a
+	// fraction of the output Nyquist frequency.
+	bool setup(unsigned int factor, unsigned int maxBlockSize,
+			   float passband = 0.8, float attenuationDb = 80);
+
+	// Decimate a block, returns the number of output samples
+	// (frames / factor on average, the remainder is carried over)
+	unsigned int process(const float *input, unsigned int frames, float *output);
+
+	// Clear the state of all stages
+	void reset();
+
+	unsigned int factor() const { return factor_; }
+	unsigned int num_stages() const { return stages_.size(); }
+	const HalfBandDecimator& stage(unsigned int n) const { return stages_[n]; }
+
+	// Destructor
+	~Decimator() {}
+
+private:
+	unsigned int factor_ = 1;
+	std::vector<HalfBandDecimator> stages_;
+
+	// Outputs of the intermediate stages
+	std::vector<float> scratch_[2];
+};
+
+// Cascade of half-band stages which keeps the output of every stage, so
+// that the signal is available at several rates an octave apart
+class DecimationPyramid {
+public:
+	// Constructor
+	DecimationPyramid() {}
+	
+	// Setup (NOT REAL-TIME SAFE). Level 0 is at 1/firstFactor of the input
+	// rate (a power of two, reached by a Decimator) and every further level
+	// at half the rate of the one before. The passband is given as a
+	// fraction of the Nyquist frequency of each level.
+	bool setup(unsigned int numLevels, unsigned int maxBlockSize, unsigned int firstFactor = 2,
+			   float passband = 0.8, float attenuationDb = 80);
+	
+	// Run a block through all stages
+	void process(const float *input, unsigned int frames);
+	
+	// Output of one level for the last block
+	const float* output(unsigned int level) const { return outputs_[level].data(); }
+	unsigned int output_frames(unsigned int level) const { return outputFrames_[level]; }
+	
+	// Clear the state of all stages
+	void reset();
+	
+	unsigned int num_levels() const { return outputs_.size(); }
+	unsigned int factor(unsigned int level) const { return first_.factor() << level; }
+	
+	// Destructor
+	~DecimationPyramid() {}
+	
+private:
+	// Decimator down to level 0, then one half-band stage per level
+	Decimator first_;
+	std::vector<HalfBandDecimator> stages_;
+	std::vector<std::vector<float>> outputs_;
+	std::vector<unsigned int> outputFrames_;
+};
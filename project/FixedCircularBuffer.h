@@ -0,0 +1,122 @@
+/***** FixedCircularBuffer.h *****/
+/* Header-only circular buffer with its capacity fixed at compile time.
+ *
+ * The capacity is rounded up to a power of two, so that an index is
+ * wrapped with a mask, and the write index simply counts up (it wraps at
+ * 2^32 together with the mask). The elements are stored in the object
+ * itself, no allocation or setup is needed. Any trivially copyable type
+ * can be stored (float, int16_t, std::complex<float>, plain structs), and
+ * runs of elements are written and read with at most two memcpy calls.
+ *
+ * Unlike CircularBuffer, the last N elements are not contiguous in memory
+ * (there is no mirrored copy). Use it where elements are copied in and out
+ * in runs, CircularBuffer where a window is read in place.
+ *
+ * The storage and the copies in and out of it are a base of their own
+ * (FixedCircularStorage), for buffers that keep their indices differently
+ * (SpscCircularBuffer).
+ *
+ * ECS7012P - Queen Mary University of London
+ * Final project, Max Tamussino
+ */
+
+#pragma once
+#include <cstring>
+#include <type_traits>
+
+// Elements of a power-of-two ring, without any index
+template <typename T, unsigned int Capacity>
+class FixedCircularStorage {
+	static_assert(std::is_trivially_copyable<T>::value, "elements are copied with memcpy");
+	static_assert(Capacity > 0 && Capacity <= (1u << 31), "capacity out of range");
+
+	// Smallest power of two >= n
+	static constexpr unsigned int round_up(unsigned int n, unsigned int power = 1) {
+		return power >= n ? power : round_up(n, 2 * power);
+	}
+
+public:
+	static constexpr unsigned int kCapacity = round_up(Capacity);	// Capacity, rounded up
+	static constexpr unsigned int kMask = kCapacity - 1;
+
+	static constexpr unsigned int capacity() { return kCapacity; }
+
+protected:
+	// Constructor, all elements value-initialised (zero)
+	FixedCircularStorage() {}
+
+	// Copy N elements to and from the buffer from the (unwrapped) index on,
+	// split where the run wraps around the end (N <= kCapacity)
+	void copy_in(unsigned int index, const T* elements, unsigned int N) {
+		const unsigned int start = index & kMask;
+		const unsigned int first = N < kCapacity - start ? N : kCapacity - start;
+		memcpy(&buffer_[start], elements, first * sizeof(T));
+		if (first < N) memcpy(&buffer_[0], elements + first, (N - first) * sizeof(T));
+	}
+	void copy_out(unsigned int index, T* out, unsigned int N) const {
+		const unsigned int start = index & kMask;
+		const unsigned int first = N < kCapacity - start ? N : kCapacity - start;
+		memcpy(out, &buffer_[start], first * sizeof(T));
+		if (first < N) memcpy(out + first, &buffer_[0], (N - first) * sizeof(T));
+	}
+
+	alignas(alignof(T) > 16 ? alignof(T) : 16) T buffer_[kCapacity] = {};
+};
+
+template <typename T, unsigned int Capacity>
+constexpr unsigned int FixedCircularStorage<T, Capacity>::kCapacity;
+template <typename T, unsigned int Capacity>
+constexpr unsigned int FixedCircularStorage<T, Capacity>::kMask;
+
+// The storage with a write index counting up
+template <typename T, unsigned int Capacity>
+class FixedCircularBuffer : public FixedCircularStorage<T, Capacity> {
+	typedef FixedCircularStorage<T, Capacity> Storage;
+	using Storage::buffer_;
+	using Storage::copy_in;
+	using Storage::copy_out;
+
+public:
+	using Storage::kCapacity;
+	using Storage::kMask;
+
+	// Constructor, all elements value-initialised (zero)
+	FixedCircularBuffer() {}
+
+	// Add one element, overwriting the oldest one once the buffer is full
+	void write(const T& element) {
+		buffer_[writeIndex_ & kMask] = element;
+		writeIndex_++;
+	}
+
+	// Add N elements, oldest first. Of more than kCapacity elements only
+	// the last kCapacity are kept.
+	void write(const T* elements, unsigned int N) {
+		if (N > kCapacity) {
+			elements += N - kCapacity;
+			writeIndex_ += N - kCapacity;
+			N = kCapacity;
+		}
+		copy_in(writeIndex_, elements, N);
+		writeIndex_ += N;
+	}
+
+	// Copy the last N elements to out, oldest first (N <= kCapacity)
+	void read(T* out, unsigned int N) const {
+		copy_out(writeIndex_ - N, out, N);
+	}
+
+	// The element written N elements ago (1 is the last one, N <= kCapacity)
+	const T& get_element_N_ago(unsigned int N) const {
+		return buffer_[(writeIndex_ - N) & kMask];
+	}
+
+	// Elements written in total (modulo 2^32)
+	unsigned int write_index() const { return writeIndex_; }
+
+	// Reset the write position, the contents stay
+	void clear() { writeIndex_ = 0; }
+
+private:
+	unsigned int writeIndex_ = 0;
+};
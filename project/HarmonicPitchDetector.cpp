@@ -0,0 +1,62 @@
+/***** HarmonicPitchDetector.cpp *****/
+/* Fundamental detection by the original heuristic of the project
+ *
+ * ECS7012P - Queen Mary University of London
+ * Final project, Max Tamussino
+ */
+
+#include <cmath>
+#include <vector>
+#include "HarmonicPitchDetector.h"
+
+// Allocate the peak list for standalone use (NOT REAL-TIME SAFE)
+bool HarmonicPitchDetector::setup(unsigned int /*fftSize*/) {
+	ownPeaks_.setup();
+	return true;
+}
+
+// Strongest peak, corrected if it turns out to be a harmonic
+float HarmonicPitchDetector::detect(const PitchInput& input) {
+	// Peaks of the given spectrum if the analyzer did not find them
+	const std::vector<SpectralPeak> *peaks = input.peaks;
+	if (peaks == nullptr) {
+		ownPeaks_.clear_peaks();
+		ownPeaks_.add_spectrum(input.spectrum->data(), input.spectrum->size(), input.sampleRate / input.fftSize,
+							   2.0 / input.fftSize, 0, input.sampleRate / 2);
+		ownPeaks_.refine_peaks();
+		peaks = &ownPeaks_.peaks();
+	}
+	
+	// Nothing above the threshold of the peaks, use the global maximum
+	if (peaks->empty()) return interpolated_bin_frequency(input, input.peakIndex);
+	
+	float dominantFreq = (*peaks)[0].frequency;
+	float dominantAmp = (*peaks)[0].amplitude;
+	float fundamentalFreq = dominantFreq;
+	if (!checkHarmonics_) return fundamentalFreq;
+	
+	// Check if maximum is actually second harmonic
+	bool dominantFreqIsSecondHarmonic = false;
+	const SpectralPeak *halfFreqPeak = strongest_peak_near(*peaks, dominantFreq / 2.0, 0.03);
+	if (halfFreqPeak != nullptr && halfFreqPeak->amplitude > 0.7 * dominantAmp) {
+		dominantFreqIsSecondHarmonic = true;
+		fundamentalFreq = halfFreqPeak->frequency;
+	}
+	
+	// Check if maximum is actually third harmonic
+	bool dominantFreqIsThirdHarmonic = false;
+	const SpectralPeak *thirdFreqPeak = strongest_peak_near(*peaks, dominantFreq / 3.0, 0.03);
+	if (thirdFreqPeak != nullptr && thirdFreqPeak->amplitude > 0.7 * dominantAmp) {
+		dominantFreqIsThirdHarmonic = true;
+		fundamentalFreq = thirdFreqPeak->frequency;
+	}
+	
+	// If the dominant frequency is discovered to be either both or neither 
+	// a second and third harmonic, it is used as the fundamental
+	if (dominantFreqIsSecondHarmonic == dominantFreqIsThirdHarmonic) {
+		fundamentalFreq = dominantFreq;
+	}
+	
+	// The peaks are already refined by interpolation
+	return fundamentalFreq;
+}
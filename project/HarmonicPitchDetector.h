@@ -0,0 +1,39 @@
+/***** HarmonicPitchDetector.h *****/
+/* Fundamental detection by the original heuristic: the strongest peak of
+ * the spectrum, unless a strong peak at a half or a third of its frequency
+ * shows that it is actually the second or third harmonic. The peaks come
+ * from the peak tracker of the analyzer (see PeakTracker.h), or are found
+ * in the given spectrum if there is none.
+ *
+ * ECS7012P - Queen Mary University of London
+ * Final project, Max Tamussino
+ */
+
+#pragma once
+#include <vector>
+#include "PitchDetector.h"
+
+class HarmonicPitchDetector : public PitchDetector {
+public:
+	// Constructor
+	HarmonicPitchDetector() {}
+	
+	bool setup(unsigned int fftSize) override;
+	Type type() const override { return kHarmonic; }
+	
+	// Check if the dominant frequency is actually a harmonic (on by default)
+	void set_check_harmonics(bool check) { checkHarmonics_ = check; }
+	bool check_harmonics() const { return checkHarmonics_; }
+	
+	// Destructor
+	~HarmonicPitchDetector() {}
+	
+protected:
+	float detect(const PitchInput& input) override;
+	
+private:
+	bool checkHarmonics_ = true;
+	
+	// Peaks of the spectrum if the input brings none
+	PeakTracker ownPeaks_;
+};
@@ -0,0 +1,75 @@
+/***** HpsPitchDetector.cpp *****/
+/* Fundamental detection with the harmonic product spectrum
+ *
+ * ECS7012P - Queen Mary University of London
+ * Final project, Max Tamussino
+ */
+
+#include <cmath>
+#include <vector>
+#include "HpsPitchDetector.h"
+#include "Simd.h"
+
+// Allocate the log spectrum (NOT REAL-TIME SAFE, use at beginning)
+bool HpsPitchDetector::setup(unsigned int fftSize) {
+	logSpectrum_.resize(fftSize / 2 + 4);
+	return true;
+}
+
+// The product of the compressed spectra is evaluated as a sum of log
+// magnitudes (the maximum near each multiple of the bin). All fundamentals
+// get the same number of harmonics, those above the Nyquist frequency
+// contribute a fixed penalty, so that high notes are still found but do
+// not win over their own subharmonics.
+float HpsPitchDetector::detect(const PitchInput& input) {
+	const std::vector<float>& spectrum = *input.spectrum;
+	const unsigned int numBins = spectrum.size();
+	
+	// Log magnitudes relative to the peak, limited to the floor (which
+	// also keeps silent bins out of the denormals)
+	const float *magnitude = spectrum.data();
+	float *logMagnitude = logSpectrum_.data();
+	const float logPeak = logf(spectrum[input.peakIndex] + 1e-20f);
+	unsigned int k = 0;
+	for (; k + 4 <= numBins; k += 4) {
+		float4 relative = log4(load4(magnitude + k) + 1e-20f) - logPeak;
+		store4(logMagnitude + k, max4(relative, splat4(kLogFloor)));
+	}
+	for (; k < numBins; k++) {
+		logMagnitude[k] = fmaxf(logf(magnitude[k] + 1e-20f) - logPeak, kLogFloor);
+	}
+	
+	// At least two harmonics must fit below the Nyquist frequency
+	unsigned int minBin = ceilf(kMinFrequency * input.fftSize / input.sampleRate);
+	if (minBin < 1) minBin = 1;
+	unsigned int maxBin = (numBins - 1) / 2;
+	
+	float bestSum = -INFINITY;
+	unsigned int bestBin = input.peakIndex;
+	for (k = minBin; k <= maxBin; k++) {
+		float sum = logMagnitude[k];
+		for (unsigned int h = 2; h <= kNumHarmonics; h++) {
+			// The h-th harmonic of a fundamental between two bins may be
+			// up to h/2 bins away from h * k
+			unsigned int first = h * k - h / 2, last = h * k + h / 2;
+			if (last >= numBins) {
+				sum += 0.5f * kLogFloor;
+				continue;
+			}
+			float harmonic = logMagnitude[first];
+			for (unsigned int n = first + 1; n <= last; n++) harmonic = fmaxf(harmonic, logMagnitude[n]);
+			sum += harmonic;
+		}
+		if (sum > bestSum) {
+			bestSum = sum;
+			bestBin = k;
+		}
+	}
+	
+	// The fundamental bin of the product may be off by one from the
+	// peak in the spectrum itself
+	if (bestBin + 1 < numBins && spectrum[bestBin + 1] > spectrum[bestBin]) bestBin++;
+	else if (bestBin > 0 && spectrum[bestBin - 1] > spectrum[bestBin]) bestBin--;
+	
+	return interpolated_bin_frequency(input, bestBin);
+}
@@ -0,0 +1,44 @@
+/***** HpsPitchDetector.h *****/
+/* Fundamental detection with the harmonic product spectrum: the spectrum
+ * is multiplied with copies of itself compressed by 2, 3, ... so that the
+ * harmonics of the fundamental line up at its bin
+ *
+ * ECS7012P - Queen Mary University of London
+ * Final project, Max Tamussino
+ */
+
+#pragma once
+#include <vector>
+#include "PitchDetector.h"
+
+class HpsPitchDetector : public PitchDetector {
+public:
+	// Constructor
+	HpsPitchDetector() {}
+	
+	// Setup (NOT REAL-TIME SAFE)
+	bool setup(unsigned int fftSize) override;
+	Type type() const override { return kHarmonicProductSpectrum; }
+	
+	// Number of harmonics in the product
+	static constexpr unsigned int kNumHarmonics = 5;
+	
+	// Lowest fundamental that is considered
+	static constexpr float kMinFrequency = 25.0;
+	
+	// Log magnitude floor relative to the peak (-60 dB). Harmonics above
+	// the Nyquist frequency count half of it, as they are unknown rather
+	// than missing.
+	static constexpr float kLogFloor = -6.9;
+	
+	// Destructor
+	~HpsPitchDetector() {}
+	
+protected:
+	float detect(const PitchInput& input) override;
+	
+private:
+	// Logarithm of the magnitude spectrum relative to its peak, so that
+	// the product is a sum
+	std::vector<float> logSpectrum_;
+};
@@ -0,0 +1,67 @@
+/***** McLeodPitchDetector.cpp *****/
+/* Fundamental detection with the McLeod pitch method
+ *
+ * ECS7012P - Queen Mary University of London
+ * Final project, Max Tamussino
+ */
+
+#include <vector>
+#include "McLeodPitchDetector.h"
+
+// Allocate the scratch memory (NOT REAL-TIME SAFE, use at beginning)
+bool McLeodPitchDetector::setup(unsigned int fftSize) {
+	analysisLength_ = fftSize / 2;
+	correlator_.setup(fftSize);
+	correlation_.resize(analysisLength_);
+	energy_.resize(analysisLength_ + 1);
+	return true;
+}
+
+float McLeodPitchDetector::detect(const PitchInput& input) {
+	const unsigned int W = analysisLength_;
+	const float *x = input.window + input.fftSize - W;
+	float *nsdf = correlation_.data();
+	
+	// Lags beyond half of W overlap too few samples to be reliable
+	const unsigned int maxLag = W / 2;
+	
+	correlator_.autocorrelate(*input.fft, x, W, nsdf);
+	
+	energy_[0] = 0;
+	for (unsigned int j = 0; j < W; j++) energy_[j + 1] = energy_[j] + x[j] * x[j];
+	if (energy_[W] <= 0) return 0;
+	
+	// n(tau) = 2 r(tau) / m(tau), m being the energy of both overlapping parts
+	for (unsigned int tau = 0; tau < maxLag; tau++) {
+		double m = energy_[W - tau] + (energy_[W] - energy_[tau]);
+		nsdf[tau] = m > 0 ? 2.0 * nsdf[tau] / m : 0;
+	}
+	
+	// Key maxima: the highest value between each positive going zero
+	// crossing and the following negative going one, after the first
+	// negative going zero crossing. First pass for the highest of them.
+	float highest = 0;
+	unsigned int tau = 1;
+	while (tau < maxLag && nsdf[tau] > 0) tau++;
+	for (unsigned int t = tau; t < maxLag; t++) {
+		if (nsdf[t] > highest) highest = nsdf[t];
+	}
+	if (highest <= 0) return 0;
+	
+	// Second pass for the first key maximum above the cutoff
+	const float threshold = kCutoff * highest;
+	while (tau < maxLag) {
+		while (tau < maxLag && nsdf[tau] <= 0) tau++;
+		unsigned int peak = tau;
+		while (tau < maxLag && nsdf[tau] > 0) {
+			if (nsdf[tau] > nsdf[peak]) peak = tau;
+			tau++;
+		}
+		if (peak < maxLag && nsdf[peak] >= threshold) {
+			float period = peak;
+			if (peak + 1 < maxLag) period += parabolic_offset(nsdf[peak - 1], nsdf[peak], nsdf[peak + 1]);
+			return input.sampleRate / period;
+		}
+	}
+	return 0;
+}
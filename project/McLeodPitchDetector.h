@@ -0,0 +1,40 @@
+/***** McLeodPitchDetector.h *****/
+/* Fundamental detection with the McLeod pitch method (McLeod and Wyvill,
+ * 2005): key maxima of the normalised square difference function of the
+ * most recent half of the window, with the autocorrelation calculated by
+ * the shared FFT
+ *
+ * ECS7012P - Queen Mary University of London
+ * Final project, Max Tamussino
+ */
+
+#pragma once
+#include <vector>
+#include "PitchDetector.h"
+
+class McLeodPitchDetector : public PitchDetector {
+public:
+	// Constructor
+	McLeodPitchDetector() {}
+	
+	// Setup (NOT REAL-TIME SAFE)
+	bool setup(unsigned int fftSize) override;
+	Type type() const override { return kMcLeod; }
+	bool time_domain() const override { return true; }
+	
+	// The first key maximum above this fraction of the highest one is chosen
+	static constexpr float kCutoff = 0.9;
+	
+	// Destructor
+	~McLeodPitchDetector() {}
+	
+protected:
+	float detect(const PitchInput& input) override;
+	
+private:
+	FftCorrelator correlator_;
+	unsigned int analysisLength_ = 0;	// W, half of the window
+	
+	std::vector<float> correlation_;	// r(tau), then the NSDF n(tau)
+	std::vector<double> energy_;		// Running sum of the squared samples
+};
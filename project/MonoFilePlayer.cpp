@@ -10,8 +10,11 @@ http://bela.io
 C++ Real-Time Audio Programming with Bela - Lecture 17: Block-based processing
 */
 
+#include <cmath>
+#include <cstring>
 #include <libraries/AudioFile/AudioFile.h>
 #include "MonoFilePlayer.h"
+#include "Simd.h"
 
 // Constructor taking the path of a file to load
 MonoFilePlayer::MonoFilePlayer(const std::string& filename, bool loop, bool autostart)
@@ -25,9 +28,11 @@ bool MonoFilePlayer::setup(const std::string& filename, bool loop, bool autostar
 	readPointer_ = 0;
 	isPlaying_ = autostart;
 	loop_ = loop;
+	streaming_ = false;
 	
 	// Load the file
 	sampleBuffer_ = AudioFileUtilities::loadMono(filename);
+	numFrames_ = sampleBuffer_.size();
 	
 	// Check for error
 	if(sampleBuffer_.empty()) {
@@ -38,13 +43,78 @@ bool MonoFilePlayer::setup(const std::string& filename, bool loop, bool autostar
 	return true;
 }
 
+// Load the head and fill the ring from the file, then leave the rest to
+// the reading task
+bool MonoFilePlayer::setupStreaming(const std::string& filename, bool loop, bool autostart,
+									unsigned int chunkSize)
+{
+	readPointer_ = 0;
+	isPlaying_ = false;
+	loop_ = loop;
+	streaming_ = true;
+	filename_ = filename;
+	numFrames_ = 0;
+	
+	// Check the file and the chunk size
+	int frames = AudioFileUtilities::getNumFrames(filename);
+	if(frames <= 0 || chunkSize == 0)
+		return false;
+	chunkSize_ = chunkSize;
+	
+	// The head, which may be all of a short file
+	unsigned int headFrames = kStreamHeadChunks * chunkSize_;
+	if(headFrames > (unsigned int)frames)
+		headFrames = frames;
+	sampleBuffer_.resize(headFrames);
+	if(AudioFileUtilities::getSamples(filename, sampleBuffer_.data(), 0, 0, headFrames))
+		return false;
+	
+	// The ring, filled before the playback starts (not needed if the head
+	// holds all of the file)
+	numFrames_ = frames;
+	streamBuffer_.assign(headFrames < numFrames_ ? kStreamChunks * chunkSize_ : 0, 0);
+	chunks_.assign(kStreamChunks, StreamChunk());
+	writeIndex_.store(0);
+	readIndex_.store(0);
+	pass_.store(0);
+	taskPass_ = 0;
+	filePointer_ = headFrames;
+	chunkEnd_ = 0;
+	inUnderrun_ = false;
+	underruns_.store(0);
+	underrunFrames_.store(0);
+	fillChunks();
+	
+	// Task reading the following chunks, named uniquely per player
+	if(streamTask_ == nullptr) {
+		static unsigned int players = 0;
+		taskName_ = "file-player-" + std::to_string(players++);
+		streamTask_ = Bela_createAuxiliaryTask(streamTask, kStreamPriority, taskName_.c_str(), this);
+	}
+	
+	isPlaying_ = autostart;
+	return true;
+}
+
 // Tell the buffer to start playing from the beginning
 void MonoFilePlayer::trigger()
 {
-	if(sampleBuffer_.empty())
+	if(numFrames_ == 0)
 		return;
 	readPointer_ = 0;
-	isPlaying_ = true;	
+	isPlaying_ = true;
+	if(resampling_)
+		resetResampler();
+	
+	// Drop the chunks read for the previous pass and have the reading task
+	// start again after the head. A chunk it is reading right now is
+	// dropped by nextChunk() if it does not follow the head.
+	if(streaming_) {
+		releaseChunk();
+		readIndex_.store(writeIndex_.load(std::memory_order_acquire), std::memory_order_release);
+		pass_.store(pass_.load(std::memory_order_relaxed) + 1, std::memory_order_release);
+		Bela_scheduleAuxiliaryTask(streamTask_);
+	}
 }
 
 // Return the next sample of the loaded audio file
@@ -52,20 +122,250 @@ float MonoFilePlayer::process()
 {
 	if(!isPlaying_)	
 		return 0;
+	if(resampling_) {
+		float out;
+		resampleBlock(&out, 1);
+		return out;
+	}
+	
+	// Read the next sample from the buffer, or from the chunk read for it
+	float out;
+	if(readPointer_ < sampleBuffer_.size()) {
+		out = sampleBuffer_[readPointer_];
+	}
+	else if(readPointer_ < chunkEnd_ || nextChunk()) {
+		out = chunkData_[readPointer_ - chunkStart_];
+	}
+	else {
+		// Underrun: play silence and wait for the chunk at this position
+		if(!inUnderrun_)
+			underruns_.fetch_add(1, std::memory_order_relaxed);
+		inUnderrun_ = true;
+		underrunFrames_.fetch_add(1, std::memory_order_relaxed);
+		return 0;
+	}
+	inUnderrun_ = false;
+	
+	// Increment read pointer, the chunk is free after its last frame
+	readPointer_++;
+	if(readPointer_ == chunkEnd_)
+		releaseChunk();
+	
+	// If we reach the end, decide whether to loop or stop
+	if(readPointer_ >= numFrames_) {
+		readPointer_ = 0;
+		if(!loop_)
+			isPlaying_ = false;
+	}
+	
+	return out;
+}
+
+// Write the next frames of the loaded audio file to out
+void MonoFilePlayer::processBlock(float *out, unsigned int frames)
+{
+	if(resampling_)
+		resampleBlock(out, frames);
+	else
+		readBlock(out, frames);
+}
+
+// Copy runs up to the end of the head, the chunk or the file, so the
+// checks happen once per run instead of once per sample
+void MonoFilePlayer::readBlock(float *out, unsigned int frames)
+{
+	while(frames > 0) {
+		if(!isPlaying_) {
+			memset(out, 0, frames * sizeof(float));
+			return;
+		}
+		
+		const float *source;
+		unsigned int run;
+		if(readPointer_ < sampleBuffer_.size()) {
+			source = &sampleBuffer_[readPointer_];
+			run = sampleBuffer_.size() - readPointer_;
+		}
+		else if(readPointer_ < chunkEnd_ || nextChunk()) {
+			source = chunkData_ + (readPointer_ - chunkStart_);
+			run = chunkEnd_ - readPointer_;
+		}
+		else {
+			// Underrun: silence for the rest of the block
+			if(!inUnderrun_)
+				underruns_.fetch_add(1, std::memory_order_relaxed);
+			inUnderrun_ = true;
+			underrunFrames_.fetch_add(frames, std::memory_order_relaxed);
+			memset(out, 0, frames * sizeof(float));
+			return;
+		}
+		inUnderrun_ = false;
+		if(run > frames)
+			run = frames;
+		memcpy(out, source, run * sizeof(float));
+		out += run;
+		frames -= run;
+		
+		readPointer_ += run;
+		if(readPointer_ == chunkEnd_)
+			releaseChunk();
+		if(readPointer_ >= numFrames_) {
+			readPointer_ = 0;
+			if(!loop_)
+				isPlaying_ = false;
+		}
+	}
+}
+
+// Output n interpolates the file at p = p0 + n * rate from the taps around
+// it. The file samples a run of outputs needs are read first, so the inner
+// loop has no checks: the integer part of p selects the samples, its top
+// fractional bits the two phases of the filter around it, and the lower
+// bits interpolate between these.
+void MonoFilePlayer::resampleBlock(float *out, unsigned int frames)
+{
+	const unsigned int kPhaseShift = 32 - 8;
+	static_assert(kResamplerPhases == 1 << 8, "kPhaseShift assumes 256 phases");
+	static_assert(kResamplerTaps % 4 == 0, "the inner loop takes four taps at a time");
+	while(frames > 0) {
+		unsigned int count = frames < kResamplerBlock ? frames : kResamplerBlock;
+		uint64_t end = resamplerFraction_ + count * resamplerStep_;
+		unsigned int endIndex = end >> 32;
+		unsigned int needed = endIndex + kResamplerTaps;
+		if(needed > resamplerFilled_) {
+			readBlock(&resamplerInput_[resamplerFilled_], needed - resamplerFilled_);
+			resamplerFilled_ = needed;
+		}
+		
+		uint64_t position = resamplerFraction_;
+		for(unsigned int n = 0; n < count; n++) {
+			const float *x = &resamplerInput_[position >> 32];
+			const float *h = &resamplerTable_[((uint32_t)position >> kPhaseShift) * kResamplerTaps];
+			const float *next = h + kResamplerTaps;
+			float4 t = splat4(((uint32_t)position & ((1u << kPhaseShift) - 1)) * (1.0f / (1u << kPhaseShift)));
+			float4 sum = load4(x) * (load4(h) + t * (load4(next) - load4(h)));
+			for(unsigned int k = 4; k < kResamplerTaps; k += 4)
+				sum += load4(x + k) * (load4(h + k) + t * (load4(next + k) - load4(h + k)));
+			out[n] = (sum[0] + sum[1]) + (sum[2] + sum[3]);
+			position += resamplerStep_;
+		}
+		
+		// Keep the samples from the first tap of the next output on
+		memmove(&resamplerInput_[0], &resamplerInput_[endIndex], (resamplerFilled_ - endIndex) * sizeof(float));
+		resamplerFilled_ -= endIndex;
+		resamplerFraction_ = (uint32_t)end;
+		out += count;
+		frames -= count;
+	}
+}
+
+// Windowed sinc with a Blackman window over the taps, its cutoff lowered
+// below the file's Nyquist frequency when it plays faster. Every phase is
+// normalised to unit gain at DC. The last of the kResamplerPhases + 1
+// phases is the first one shifted by a sample, for the interpolation.
+bool MonoFilePlayer::setPlaybackRate(float rate)
+{
+	if(!(rate > 0 && rate <= kMaxPlaybackRate))
+		return false;
+	playbackRate_ = rate;
+	resampling_ = rate != 1;
+	if(!resampling_)
+		return true;
+		
+	const float cutoff = rate > 1 ? 1 / rate : 1;
+	const float halfLength = kResamplerTaps / 2;
+	resamplerTable_.resize((kResamplerPhases + 1) * kResamplerTaps);
+	for(unsigned int phase = 0; phase <= kResamplerPhases; phase++) {
+		float *h = &resamplerTable_[phase * kResamplerTaps];
+		float sum = 0;
+		for(unsigned int k = 0; k < kResamplerTaps; k++) {
+			// Distance of the tap from the output position
+			float distance = k - (halfLength - 1) - (float)phase / kResamplerPhases;
+			float x = M_PI * cutoff * distance;
+			float sinc = x == 0 ? 1 : sinf(x) / x;
+			float window = 0.42f + 0.5f * cosf(M_PI * distance / halfLength) + 0.08f * cosf(2 * M_PI * distance / halfLength);
+			h[k] = sinc * window;
+			sum += h[k];
+		}
+		for(unsigned int k = 0; k < kResamplerTaps; k++)
+			h[k] /= sum;
+	}
+		
+	resamplerStep_ = llround((double)rate * 4294967296.0);
+	resamplerInput_.assign(kResamplerBlock * kMaxPlaybackRate + 2 * kResamplerTaps, 0);
+	resetResampler();
+	return true;
+}
+
+// The first output lies on the first file sample, with silence before it
+// under the taps
+void MonoFilePlayer::resetResampler()
+{
+	resamplerFilled_ = kResamplerTaps / 2 - 1;
+	memset(&resamplerInput_[0], 0, resamplerFilled_ * sizeof(float));
+	resamplerFraction_ = 0;
+}
 
-	// Read the next sample from the buffer
-	float out = sampleBuffer_[readPointer_];
-        
-	// Increment read pointer
-    readPointer_++;
-    
-    // If we reach the end, decide whether to loop or stop
-    if(readPointer_ >= sampleBuffer_.size()) {
-     	readPointer_ = 0;
-     	if(!loop_)
-     		isPlaying_ = false;
-    }
-    
-    return out;
+// Chunks are read in file order, so the one holding the read pointer is
+// the first ready one, unless it was read before a trigger()
+bool MonoFilePlayer::nextChunk()
+{
+	unsigned int read = readIndex_.load(std::memory_order_relaxed);
+	while(read != writeIndex_.load(std::memory_order_acquire)) {
+		const StreamChunk& chunk = chunks_[read % kStreamChunks];
+		if(readPointer_ >= chunk.start && readPointer_ < chunk.start + chunk.frames) {
+			chunkData_ = &streamBuffer_[(read % kStreamChunks) * chunkSize_];
+			chunkStart_ = chunk.start;
+			chunkEnd_ = chunk.start + chunk.frames;
+			return true;
+		}
+		readIndex_.store(++read, std::memory_order_release);
+		Bela_scheduleAuxiliaryTask(streamTask_);
+	}
+	return false;
+}
+
+void MonoFilePlayer::releaseChunk()
+{
+	if(chunkEnd_ == 0)
+		return;
+	chunkEnd_ = 0;
+	readIndex_.store(readIndex_.load(std::memory_order_relaxed) + 1, std::memory_order_release);
+	Bela_scheduleAuxiliaryTask(streamTask_);
+}
+
+void MonoFilePlayer::streamTask(void *arg)
+{
+	((MonoFilePlayer*)arg)->fillChunks();
+}
+
+// Read chunks until the ring is full or the end of a file that does not
+// loop is reached. Looping continues right after the head, which the audio
+// thread plays from memory.
+void MonoFilePlayer::fillChunks()
+{
+	while(true) {
+		unsigned int pass = pass_.load(std::memory_order_acquire);
+		if(pass != taskPass_) {
+			taskPass_ = pass;
+			filePointer_ = sampleBuffer_.size();
+		}
+		if(filePointer_ >= numFrames_)
+			return;
+	
+		unsigned int write = writeIndex_.load(std::memory_order_relaxed);
+		if(write - readIndex_.load(std::memory_order_acquire) >= kStreamChunks)
+			return;
+		StreamChunk& chunk = chunks_[write % kStreamChunks];
+		chunk.start = filePointer_;
+		chunk.frames = numFrames_ - filePointer_ < chunkSize_ ? numFrames_ - filePointer_ : chunkSize_;
+		if(AudioFileUtilities::getSamples(filename_, &streamBuffer_[(write % kStreamChunks) * chunkSize_], 0,
+										  chunk.start, chunk.start + chunk.frames))
+			return;
+		writeIndex_.store(write + 1, std::memory_order_release);
+	
+		filePointer_ += chunk.frames;
+		if(filePointer_ >= numFrames_ && loop_)
+			filePointer_ = sampleBuffer_.size();
+	}
 }
-	
\ No newline at end of file
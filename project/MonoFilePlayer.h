@@ -13,14 +13,40 @@ C++ Real-Time Audio Programming with Bela - Lecture 17: Block-based processing
 // This is a simple class encapsulating the playback of a sound
 // loaded from an audio file. It offers basic controls to loop, start
 // and stop the playback. It assumes a mono audio file.
+//
+// With setupStreaming(), only the first frames of the file (the head) are
+// kept in memory. The rest is read in chunks by a background task into a
+// ring of a few chunks, so the memory used does not depend on the length
+// of the file. process() only reads from memory: the head covers the start
+// after trigger() and after every loop while the task reads the chunks
+// that follow it. If the next chunk has not arrived in time, process()
+// returns silence and waits at the same position (an underrun).
+//
+// processBlock() copies whole runs of samples and only handles the end of
+// the head, a chunk or the file once per run. With setPlaybackRate(), it
+// plays the file at another rate through a polyphase windowed-sinc
+// resampler with a precomputed table, e.g. a file recorded at another
+// sample rate or a reference tone shifted in pitch.
 
 #pragma once
 
+#include <atomic>
+#include <cstdint>
 #include <vector>
 #include <string>
+#include <Bela.h>
 
 class MonoFilePlayer {
 public:
+	static const unsigned int kStreamChunkSize = 8192;	// Frames read from the file at once
+	static const unsigned int kStreamChunks = 4;		// Chunks in the ring
+	static const unsigned int kStreamHeadChunks = 2;	// Chunks kept from the start of the file
+	static const int kStreamPriority = BELA_AUDIO_PRIORITY - 5;	// Priority of the reading task
+	static const unsigned int kResamplerTaps = 16;	// Taps of the resampling filter
+	static const unsigned int kResamplerPhases = 256;	// Fractional positions with a set of taps
+	static const unsigned int kResamplerBlock = 64;	// Output samples resampled at once
+	static constexpr float kMaxPlaybackRate = 4;	// Fastest playback (file samples per output sample)
+	
 	// Constructors: the one with arguments automatically calls setup()
 	MonoFilePlayer() {}
 	MonoFilePlayer(const std::string& filename, bool loop = true, bool autostart = true);
@@ -28,23 +54,106 @@ public:
 	// Load an audio file from the given filename. Returns true on success.
 	bool setup(const std::string& filename, bool loop = true, bool autostart = true);
 	
+	// Stream an audio file from the given filename (NOT REAL-TIME SAFE,
+	// call once at the beginning). The head and the ring are filled before
+	// it returns. Returns true on success.
+	bool setupStreaming(const std::string& filename, bool loop = true, bool autostart = true,
+						unsigned int chunkSize = kStreamChunkSize);
+	
 	// Start or stop the playback
 	void trigger();
 	void stop() { isPlaying_ = false; }
-
-	// Return the length of the buffer in samples
-	unsigned int size() { return sampleBuffer_.size(); }
+	
+	// Return the length of the file in samples
+	unsigned int size() { return numFrames_; }
+	
+	// Set the file samples played per output sample (NOT REAL-TIME SAFE,
+	// computes the resampler table), e.g. the rate of the file over the
+	// audio sample rate, times 2^(cents / 1200) for a shift in pitch. 1 plays
+	// the file as it is. Returns false if the rate is out of range.
+	bool setPlaybackRate(float rate);
+	float playbackRate() const { return playbackRate_; }
+	
+	// Return the number of samples held in memory (the whole file unless
+	// streaming)
+	unsigned int memorySize() { return sampleBuffer_.size() + streamBuffer_.size(); }
+	
+	// Return the number of underruns, and the samples of silence played
+	// during them
+	unsigned int underruns() const { return underruns_.load(std::memory_order_relaxed); }
+	unsigned int underrunFrames() const { return underrunFrames_.load(std::memory_order_relaxed); }
 	
 	// Return the next sample of the loaded audio file
 	float process();
 	
-	// Destructor
+	// Write the next frames of the loaded audio file to out
+	void processBlock(float *out, unsigned int frames);
+	
+	// Destructor: a streaming player has to outlive its reading task
 	~MonoFilePlayer() {}
 	
 private:
-	std::vector<float> sampleBuffer_;			// Buffer that holds the sound file
-	int readPointer_ = 0;						// Position of the last frame we played 
+	// Position and length of a chunk of the ring in the file
+	struct StreamChunk {
+		unsigned int start = 0;
+		unsigned int frames = 0;
+	};
+	
+	// Reading task: fill the free chunks of the ring
+	static void streamTask(void *arg);
+	void fillChunks();
+	
+	// Audio thread: move on to the chunk holding the read pointer, or hand
+	// the current one back to the reading task
+	bool nextChunk();
+	void releaseChunk();
+	
+	// Copy the next frames of the file at its own rate, or resample them
+	void readBlock(float *out, unsigned int frames);
+	void resampleBlock(float *out, unsigned int frames);
+	void resetResampler();
+	
+	std::vector<float> sampleBuffer_;			// Buffer that holds the sound file (the head if streaming)
+	unsigned int numFrames_ = 0;				// Length of the sound file
+	unsigned int readPointer_ = 0;				// Position of the next frame to play
 	bool loop_ = false;							// Whether the playback loops at the end
 	bool isPlaying_ = false;					// Whether we are currently playing
+	
+	// Streaming: the ring of chunks, filled by the reading task and read by
+	// the audio thread. Chunks [readIndex_, writeIndex_) are ready.
+	bool streaming_ = false;
+	std::string filename_;
+	std::string taskName_;
+	AuxiliaryTask streamTask_ = nullptr;
+	unsigned int chunkSize_ = 0;
+	std::vector<float> streamBuffer_;
+	std::vector<StreamChunk> chunks_;
+	std::atomic<unsigned int> writeIndex_{0};
+	std::atomic<unsigned int> readIndex_{0};
+	
+	// A trigger() starts a new pass over the file, the reading task then
+	// restarts after the head
+	std::atomic<unsigned int> pass_{0};
+	unsigned int taskPass_ = 0;					// Pass the reading task is on
+	unsigned int filePointer_ = 0;				// Next frame the reading task reads
+	
+	// Chunk held by the audio thread
+	const float *chunkData_ = nullptr;
+	unsigned int chunkStart_ = 0;
+	unsigned int chunkEnd_ = 0;					// 0 if no chunk is held
+	
+	bool inUnderrun_ = false;
+	std::atomic<unsigned int> underruns_{0};
+	std::atomic<unsigned int> underrunFrames_{0};
+	
+	// Resampler: the taps of every phase (and one more), and the file samples from the
+	// first tap of the next output on. Positions are fixed point with 32
+	// fractional bits.
+	float playbackRate_ = 1;
+	bool resampling_ = false;
+	uint64_t resamplerStep_ = 0;
+	uint32_t resamplerFraction_ = 0;
+	std::vector<float> resamplerTable_;
+	std::vector<float> resamplerInput_;
+	unsigned int resamplerFilled_ = 0;
 };
-
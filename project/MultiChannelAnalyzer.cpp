@@ -0,0 +1,73 @@
+/***** MultiChannelAnalyzer.cpp *****/
+/* Class implementation of the analysis of several input channels
+ *
+ * ECS7012P - Queen Mary University of London
+ * Final project, Max Tamussino
+ */
+
+#include <vector>
+#include "MultiChannelAnalyzer.h"
+
+// One analyzer per channel (NOT REAL-TIME SAFE, use at beginning)
+bool MultiChannelAnalyzer::setup(float sampleRate, unsigned int maxBlockSize, unsigned int numChannels,
+								 const SpectrumAnalyzer::Config& config) {
+	if (numChannels < 1 || numChannels > kMaxChannels) return false;
+	numChannels_ = numChannels;
+	maxBlockSize_ = maxBlockSize;
+	config_ = config;
+	for (unsigned int channel = 0; channel < numChannels_; channel++) {
+		SpectrumAnalyzer::Config channelConfig = config;
+		channelConfig.hopOffset = hop_offset(channel, numChannels_, config.hopSize);
+		if (!slots_[channel].setup(sampleRate, channelConfig)) return false;
+	}
+	channelBlocks_.assign(numChannels_ * maxBlockSize_, 0);
+	return true;
+}
+
+// Every channel keeps its offset. The audio thread swaps the new analyzers
+// in one by one as they become ready, which shifts their hops by at most a
+// block against each other.
+bool MultiChannelAnalyzer::reconfigure(const SpectrumAnalyzer::Config& config) {
+	for (unsigned int channel = 0; channel < numChannels_; channel++) {
+		SpectrumAnalyzer::Config channelConfig = config;
+		channelConfig.hopOffset = hop_offset(channel, numChannels_, config.hopSize);
+		if (!slots_[channel].reconfigure(channelConfig)) return false;
+	}
+	config_ = config;
+	return true;
+}
+
+void MultiChannelAnalyzer::collect() {
+	for (unsigned int channel = 0; channel < numChannels_; channel++) slots_[channel].collect();
+}
+
+// Interleaved input is split in one pass over the block, channels stored
+// one after the other are passed on in place
+bool MultiChannelAnalyzer::process_block(const float *input, unsigned int frames, unsigned int numInputChannels,
+										 bool interleaved) {
+	const unsigned int numChannels = numChannels_ < numInputChannels ? numChannels_ : numInputChannels;
+	if (interleaved && numInputChannels > 1) {
+		for (unsigned int n = 0; n < frames; n++) {
+			const float *frame = input + n * numInputChannels;
+			for (unsigned int channel = 0; channel < numChannels; channel++) {
+				channelBlocks_[channel * maxBlockSize_ + n] = frame[channel];
+			}
+		}
+	}
+
+	bool newWindow = false;
+	for (unsigned int channel = 0; channel < numChannels; channel++) {
+		const float *block = interleaved && numInputChannels > 1 ? &channelBlocks_[channel * maxBlockSize_] :
+			input + channel * frames;
+		if (slots_[channel].audio_analyzer()->process_block(block, frames)) newWindow = true;
+	}
+	return newWindow;
+}
+
+// With hop size H, N channels and chunk size C, channel c is offset by
+// c H / N rounded down to whole chunks, plus c C / N
+unsigned int MultiChannelAnalyzer::hop_offset(unsigned int channel, unsigned int numChannels, unsigned int hopSize) {
+	const unsigned int chunkSize = SpectrumAnalyzer::kChunkSize;
+	unsigned int offset = channel * hopSize / numChannels;
+	return offset - offset % chunkSize + channel * chunkSize / numChannels;
+}
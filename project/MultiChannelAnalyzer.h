@@ -0,0 +1,66 @@
+/***** MultiChannelAnalyzer.h *****/
+/* Class implementation of the analysis of several input channels, e.g.
+ * the strings of a hexaphonic pickup or the microphones of several
+ * instruments. Every channel has an analyzer of its own (pyramid, level
+ * buffers, window queue and detector), each in an AnalyzerSlot so that
+ * all of them can be reconfigured at runtime.
+ *
+ * An interleaved block is split into one block per channel in a single
+ * pass. The hops of the channels are staggered over the hop size, and the
+ * chunks of their pyramids over the chunk size, so that the window copies
+ * and FFTs of the channels fall into different blocks.
+ *
+ * ECS7012P - Queen Mary University of London
+ * Final project, Max Tamussino
+ */
+
+#pragma once
+#include <vector>
+#include "AnalyzerSlot.h"
+#include "SpectrumAnalyzer.h"
+
+class MultiChannelAnalyzer {
+public:
+	static const int kMaxChannels = 8;	// Most analysed channels
+
+	// Constructor
+	MultiChannelAnalyzer() {}
+
+	// Setup (NOT REAL-TIME SAFE), one analyzer per channel with the given
+	// configuration, the hop offsets are set here. Returns false if the
+	// configuration is invalid.
+	bool setup(float sampleRate, unsigned int maxBlockSize, unsigned int numChannels,
+			   const SpectrumAnalyzer::Config& config);
+
+	// Non real-time thread: reconfigure all channels (see AnalyzerSlot.h)
+	bool reconfigure(const SpectrumAnalyzer::Config& config);
+	void collect();
+
+	// Audio thread: feed one block of numInputChannels channels, either
+	// interleaved or one channel after the other. The first num_channels()
+	// of them are analysed. Returns true if any channel queued a window.
+	bool process_block(const float *input, unsigned int frames, unsigned int numInputChannels, bool interleaved);
+
+	// The analyzer of every channel
+	AnalyzerSlot& slot(unsigned int channel) { return slots_[channel]; }
+	unsigned int num_channels() const { return numChannels_; }
+
+	// Configuration of the last setup or reconfigure(), without the offsets
+	const SpectrumAnalyzer::Config& config() const { return config_; }
+
+	// Hop offset of a channel: the hops are spread evenly over the hop
+	// size, and within one hop the chunks over the chunk size
+	static unsigned int hop_offset(unsigned int channel, unsigned int numChannels, unsigned int hopSize);
+
+	// Destructor
+	~MultiChannelAnalyzer() {}
+
+private:
+	unsigned int numChannels_ = 0;
+	unsigned int maxBlockSize_ = 0;
+	SpectrumAnalyzer::Config config_;
+	AnalyzerSlot slots_[kMaxChannels];
+
+	// One block per channel, split from interleaved input
+	std::vector<float> channelBlocks_;
+};
@@ -0,0 +1,167 @@
+/***** PeakTracker.cpp *****/
+/* Class implementation of the peak extraction and partial tracking stage
+ *
+ * ECS7012P - Queen Mary University of London
+ * Final project, Max Tamussino
+ */
+
+#include <cmath>
+#include <vector>
+#include <libraries/math_neon/math_neon.h>
+#include "PeakTracker.h"
+#include "Simd.h"
+
+// Allocate the lists (NOT REAL-TIME SAFE, use at beginning)
+void PeakTracker::setup() {
+	candidates_.reserve(kMaxPeaks + 1);
+	candidates_.clear();
+	peaks_.reserve(kMaxPeaks);
+	peaks_.clear();
+	Track freeTrack = {-1, 0, 0, 0, 0};
+	tracks_.assign(kMaxTracks, freeTrack);
+	trackMatched_.assign(kMaxTracks, false);
+	nextTrackId_ = 0;
+}
+
+// The first match is the strongest one
+const SpectralPeak* strongest_peak_near(const std::vector<SpectralPeak>& peaks, float frequency, float deviation) {
+	for (unsigned int p = 0; p < peaks.size(); p++) {
+		if (fabsf(peaks[p].frequency - frequency) <= deviation * frequency) return &peaks[p];
+	}
+	return nullptr;
+}
+
+// Insertion into the short list, the weakest maximum drops out when full
+void PeakTracker::insert_candidate(const Candidate& candidate) {
+	if (candidates_.size() == kMaxPeaks && candidate.amplitude <= candidates_.back().amplitude) return;
+	unsigned int position = candidates_.size();
+	while (position > 0 && candidates_[position - 1].amplitude < candidate.amplitude) position--;
+	candidates_.insert(candidates_.begin() + position, candidate);
+	if (candidates_.size() > kMaxPeaks) candidates_.pop_back();
+}
+
+// Four bins at a time are compared with both neighbours and the threshold.
+// Only the few bins which are local maxima leave the vector loop.
+void PeakTracker::add_spectrum(const float *spectrum, unsigned int numBins, float binFrequency, float scale,
+							   float minFrequency, float maxFrequency) {
+	// Bins whose peak may refine into the range, with both neighbours
+	int begin = floorf(minFrequency / binFrequency) - 1;
+	int end = ceilf(maxFrequency / binFrequency) + 2;
+	if (begin < 1) begin = 1;
+	if (end > (int)numBins - 1) end = numBins - 1;
+	const float threshold = kMinAmplitude / scale;
+
+	Candidate candidate = {spectrum, 0, binFrequency, scale, minFrequency, maxFrequency, 0};
+	auto add = [&](int bin) {
+		candidate.bin = bin;
+		candidate.amplitude = scale * spectrum[bin];
+		insert_candidate(candidate);
+	};
+
+	int bin = begin;
+	const float4 threshold4 = splat4(threshold);
+	for (; bin + 4 <= end; bin += 4) {
+		float4 middle = load4(spectrum + bin);
+		int4 isPeak = (middle > load4(spectrum + bin - 1)) & (middle >= load4(spectrum + bin + 1)) &
+			(middle > threshold4);
+		if (!(isPeak[0] | isPeak[1] | isPeak[2] | isPeak[3])) continue;
+		for (int lane = 0; lane < 4; lane++) {
+			if (isPeak[lane]) add(bin + lane);
+		}
+	}
+	for (; bin < end; bin++) {
+		float middle = spectrum[bin];
+		if (middle > spectrum[bin - 1] && middle >= spectrum[bin + 1] && middle > threshold) add(bin);
+	}
+}
+
+// The log magnitudes fit the main lobe of the window much better than the
+// magnitudes themselves. The order by amplitude is kept, the interpolated
+// amplitudes differ from the bin values by less than the lobe shape.
+void PeakTracker::refine_peaks() {
+	peaks_.clear();
+	for (unsigned int c = 0; c < candidates_.size(); c++) {
+		const Candidate& candidate = candidates_[c];
+		const float *spectrum = candidate.spectrum;
+		unsigned int bin = candidate.bin;
+		float left = logf_neon(spectrum[bin - 1] + 1e-12f);
+		float middle = logf_neon(spectrum[bin]);
+		float right = logf_neon(spectrum[bin + 1] + 1e-12f);
+		float denominator = 2 * (2 * middle - left - right);
+		float offset = denominator > 0 ? (right - left) / denominator : 0;
+		if (offset > 0.5f) offset = 0.5f;
+		if (offset < -0.5f) offset = -0.5f;
+		float frequency = (bin + offset) * candidate.binFrequency;
+		if (frequency < candidate.minFrequency || frequency >= candidate.maxFrequency) continue;
+		SpectralPeak peak = {frequency, candidate.scale * expf_neon(middle - 0.25f * (left - right) * offset), -1};
+		peaks_.push_back(peak);
+	}
+}
+
+// Greedy matching, strongest peak first: each peak continues the nearest
+// unmatched track within kMaxJumpCents, or starts a new one in a free slot
+void PeakTracker::update_tracks() {
+	const float maxRatio = powf(2.0, kMaxJumpCents / 1200.0);
+	trackMatched_.assign(kMaxTracks, false);
+
+	for (unsigned int p = 0; p < peaks_.size(); p++) {
+		SpectralPeak& peak = peaks_[p];
+		int best = -1;
+		float bestRatio = maxRatio;
+		for (unsigned int t = 0; t < kMaxTracks; t++) {
+			if (tracks_[t].id < 0 || trackMatched_[t]) continue;
+			float ratio = peak.frequency > tracks_[t].frequency ? peak.frequency / tracks_[t].frequency :
+				tracks_[t].frequency / peak.frequency;
+			if (ratio < bestRatio) {
+				bestRatio = ratio;
+				best = t;
+			}
+		}
+
+		if (best < 0) {
+			// New track, if there is a free slot
+			for (unsigned int t = 0; t < kMaxTracks; t++) {
+				if (tracks_[t].id < 0) {
+					Track track = {nextTrackId_++, peak.frequency, peak.amplitude, 0, 0};
+					tracks_[t] = track;
+					best = t;
+					break;
+				}
+			}
+			if (best < 0) continue;
+		} else {
+			tracks_[best].frequency = peak.frequency;
+			tracks_[best].amplitude = peak.amplitude;
+			tracks_[best].age++;
+			tracks_[best].missed = 0;
+		}
+		trackMatched_[best] = true;
+		peak.track = tracks_[best].id;
+	}
+
+	// Tracks without a peak in this hop age out
+	for (unsigned int t = 0; t < kMaxTracks; t++) {
+		if (tracks_[t].id < 0 || trackMatched_[t]) continue;
+		if (++tracks_[t].missed > kMaxMissedHops) tracks_[t].id = -1;
+	}
+}
+
+// With the ratio r = f_h / (h f_1) of a partial to the harmonic of the
+// measured fundamental, r^2 (1 + B) = 1 + B h^2, so B = (r^2 - 1) / (h^2 - r^2).
+// The estimates of all partials are weighted by their amplitude.
+float PeakTracker::inharmonicity(float fundamental) const {
+	if (fundamental <= 0) return 0;
+	float weightedSum = 0, totalWeight = 0;
+	for (unsigned int t = 0; t < kMaxTracks; t++) {
+		const Track& track = tracks_[t];
+		if (track.id < 0 || track.missed > 0) continue;
+		float harmonic = roundf(track.frequency / fundamental);
+		if (harmonic < 2) continue;
+		float ratio = track.frequency / (harmonic * fundamental);
+		if (fabsf(ratio - 1) > 0.05f) continue;
+		float ratioSquared = ratio * ratio;
+		weightedSum += track.amplitude * (ratioSquared - 1) / (harmonic * harmonic - ratioSquared);
+		totalWeight += track.amplitude;
+	}
+	return totalWeight > 0 ? weightedSum / totalWeight : 0;
+}
@@ -0,0 +1,101 @@
+/***** PeakTracker.h *****/
+/* Class implementation of the peak extraction and partial tracking stage:
+ * the strongest local maxima of the spectra of all levels are found in
+ * one vectorised pass per level, then only those are refined by Gaussian
+ * interpolation (a parabola through the log magnitudes) and linked from
+ * hop to hop into partial tracks. The tracks give the frequencies of the
+ * partials of the note, and from them its inharmonicity.
+ *
+ * ECS7012P - Queen Mary University of London
+ * Final project, Max Tamussino
+ */
+
+#pragma once
+#include <vector>
+
+// One refined peak of the current hop
+struct SpectralPeak {
+	float frequency;	// Hz
+	float amplitude;	// Interpolated amplitude of the peak
+	int track;			// Id of the partial track it belongs to (-1 if none)
+};
+
+// Strongest peak within a relative deviation around a frequency, nullptr
+// if there is none (the list is sorted strongest first)
+const SpectralPeak* strongest_peak_near(const std::vector<SpectralPeak>& peaks, float frequency, float deviation);
+
+class PeakTracker {
+public:
+	// Tracker parameters
+	static const int kMaxPeaks = 16;	// Strongest peaks kept per hop
+	static const int kMaxTracks = 32;	// Partial tracks followed at once
+	static constexpr float kMinAmplitude = 1e-4;	// Weakest peak (-80 dBFS)
+	static constexpr float kMaxJumpCents = 50;	// Largest change of a track between hops
+	static const int kMaxMissedHops = 2;	// Hops a track survives without a peak
+
+	// One partial track
+	struct Track {
+		int id;				// -1 if the slot is free
+		float frequency;
+		float amplitude;
+		unsigned int age;	// Hops since the track started
+		unsigned int missed;	// Hops since the last peak (0: continued in this hop)
+	};
+
+	// Constructor
+	PeakTracker() {}
+
+	// Setup (NOT REAL-TIME SAFE), allocates the peak and track lists
+	void setup();
+
+	// Start the peaks of a new hop
+	void clear_peaks() { candidates_.clear(); peaks_.clear(); }
+
+	// Add the local maxima of one spectrum (numBins magnitudes with
+	// binFrequency Hz per bin, multiplied by scale to get amplitudes) near
+	// [minFrequency, maxFrequency). Only the kMaxPeaks strongest ones of all
+	// spectra of the hop are kept. The spectrum must stay unchanged until
+	// refine_peaks().
+	void add_spectrum(const float *spectrum, unsigned int numBins, float binFrequency, float scale,
+					  float minFrequency, float maxFrequency);
+
+	// Interpolate the kept maxima into the peaks of the hop, dropping those
+	// whose refined frequency lies outside the range of their spectrum
+	void refine_peaks();
+
+	// Link the peaks of the hop to the tracks of the previous one
+	void update_tracks();
+
+	// Peaks of the current hop, strongest first
+	const std::vector<SpectralPeak>& peaks() const { return peaks_; }
+
+	// Track slots, free ones have an id of -1
+	const std::vector<Track>& tracks() const { return tracks_; }
+
+	// Inharmonicity coefficient B of a string with the given fundamental
+	// (f_h = h f_0 sqrt(1 + B h^2)), from the tracks continued in this hop
+	// which are near its harmonics. 0 if there are none.
+	float inharmonicity(float fundamental) const;
+
+	// Destructor
+	~PeakTracker() {}
+
+private:
+	// A local maximum before interpolation
+	struct Candidate {
+		const float *spectrum;
+		unsigned int bin;
+		float binFrequency, scale;
+		float minFrequency, maxFrequency;
+		float amplitude;
+	};
+
+	// Insert a maximum into the list, strongest first, keeping at most kMaxPeaks
+	void insert_candidate(const Candidate& candidate);
+
+	std::vector<Candidate> candidates_;
+	std::vector<SpectralPeak> peaks_;
+	std::vector<Track> tracks_;
+	std::vector<bool> trackMatched_;
+	int nextTrackId_ = 0;
+};
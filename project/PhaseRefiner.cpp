@@ -0,0 +1,49 @@
+/***** PhaseRefiner.cpp *****/
+/* Class implementation of the phase vocoder refinement of peak
+ * frequencies
+ *
+ * ECS7012P - Queen Mary University of London
+ * Final project, Max Tamussino
+ */
+
+#include <cmath>
+#include <vector>
+#include <libraries/math_neon/math_neon.h>
+#include "PhaseRefiner.h"
+
+// Keep a copy of the window (NOT REAL-TIME SAFE, use at beginning)
+bool PhaseRefiner::setup(unsigned int fftSize, unsigned int lag, const std::vector<float>& windowTable) {
+	if (fftSize < 4 || lag == 0 || windowTable.size() != fftSize) return false;
+	fftSize_ = fftSize;
+	lag_ = lag;
+	windowTable_ = windowTable;
+	return true;
+}
+
+// The Goertzel recursion s(n) = x(n) + 2 cos(w) s(n-1) - s(n-2) gives
+// X(k) = e^(jw) s(N-1) - s(N-2) for an integer bin k. The expected phase
+// advance of the bin frequency over the lag is taken out before the
+// difference is wrapped, so that only the deviation from it is ambiguous.
+float PhaseRefiner::refine(const float *bins, const float *earlier, float estimate, float sampleRate) const {
+	int bin = lroundf(estimate * fftSize_ / sampleRate);
+	if (bin < 1 || bin >= (int)fftSize_ / 2) return estimate;
+	const float omega = 2.0f * (float)M_PI * bin / fftSize_;
+	const float coefficient = 2.0f * cosf_neon(omega);
+	float s1 = 0, s2 = 0;
+	for (unsigned int n = 0; n < fftSize_; n++) {
+		float s = earlier[n] * windowTable_[n] + coefficient * s1 - s2;
+		s2 = s1;
+		s1 = s;
+	}
+	float earlierRe = s1 * cosf_neon(omega) - s2;
+	float earlierIm = s1 * sinf_neon(omega);
+
+	// Phase difference of the later bin to the earlier one
+	float laterRe = bins[2 * bin], laterIm = bins[2 * bin + 1];
+	float re = laterRe * earlierRe + laterIm * earlierIm;
+	float im = laterIm * earlierRe - laterRe * earlierIm;
+	if (re == 0 && im == 0) return estimate;
+	float deviation = atan2f_neon(im, re) - omega * lag_;
+	deviation -= 2.0f * (float)M_PI * roundf(deviation / (2.0f * (float)M_PI));
+	return (omega + deviation / lag_) * sampleRate / (2.0f * (float)M_PI);
+}
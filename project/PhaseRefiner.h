@@ -0,0 +1,46 @@
+/***** PhaseRefiner.h *****/
+/* Class implementation of the phase vocoder refinement of peak
+ * frequencies: between two windows lag samples apart, the phase of a bin
+ * advances by the angular frequency of the sinusoid in it times the lag.
+ * The phase difference therefore gives the frequency far more precisely
+ * than an interpolation of the magnitudes, which is biased by the shape
+ * of the window.
+ *
+ * The bin of the later window is read from its FFT, the same bin of the
+ * earlier window is computed on its own by the Goertzel recursion, so only
+ * the bins which are refined cost anything. The phase difference is only
+ * known modulo 2 pi, so the estimate that is refined has to be within
+ * fftSize / (2 lag) bins of the true frequency.
+ *
+ * ECS7012P - Queen Mary University of London
+ * Final project, Max Tamussino
+ */
+
+#pragma once
+#include <vector>
+
+class PhaseRefiner {
+public:
+	// Constructor
+	PhaseRefiner() {}
+
+	// Setup (NOT REAL-TIME SAFE), with the window table of the FFT (fftSize
+	// values) and the distance of the two windows in samples
+	bool setup(unsigned int fftSize, unsigned int lag, const std::vector<float>& windowTable);
+
+	// Frequency in Hz of the sinusoid near the estimate. bins are the
+	// interleaved bins of the FFT of the later window, earlier the samples
+	// (not windowed) of the window lag samples before it. Returns the
+	// estimate if its bin is out of range or empty.
+	float refine(const float *bins, const float *earlier, float estimate, float sampleRate) const;
+
+	unsigned int lag() const { return lag_; }
+
+	// Destructor
+	~PhaseRefiner() {}
+
+private:
+	unsigned int fftSize_ = 0;
+	unsigned int lag_ = 0;
+	std::vector<float> windowTable_;
+};
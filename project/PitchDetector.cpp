@@ -0,0 +1,151 @@
+/***** PitchDetector.cpp *****/
+/* Interface of the fundamental frequency detectors behind the spectrum
+ * analyzer, and the FFT-based correlation shared by the time domain ones
+ *
+ * ECS7012P - Queen Mary University of London
+ * Final project, Max Tamussino
+ */
+
+#include <chrono>
+#include <cstring>
+#include <vector>
+#include "PitchDetector.h"
+#include "HarmonicPitchDetector.h"
+#include "HpsPitchDetector.h"
+#include "YinPitchDetector.h"
+#include "McLeodPitchDetector.h"
+
+// Create a detector of the given type (NOT REAL-TIME SAFE)
+PitchDetector* PitchDetector::create(Type type) {
+	switch (type) {
+		case kHarmonic: return new HarmonicPitchDetector();
+		case kHarmonicProductSpectrum: return new HpsPitchDetector();
+		case kYin: return new YinPitchDetector();
+		case kMcLeod: return new McLeodPitchDetector();
+		default: return nullptr;
+	}
+}
+
+// Detector names for command lines
+static const char *kTypeNames[] = {"harmonic", "hps", "yin", "mpm"};
+
+const char* PitchDetector::type_name(Type type) {
+	return kTypeNames[type];
+}
+
+bool PitchDetector::type_from_name(const char *name, Type& type) {
+	for (unsigned int n = 0; n < kNumTypes; n++) {
+		if (!strcmp(name, kTypeNames[n])) {
+			type = (Type)n;
+			return true;
+		}
+	}
+	return false;
+}
+
+// Detect the fundamental and keep track of the time it took
+float PitchDetector::process(const PitchInput& input) {
+	auto before = std::chrono::steady_clock::now();
+	float frequency = detect(input);
+	auto after = std::chrono::steady_clock::now();
+	
+	lastCost_ = std::chrono::duration<float, std::micro>(after - before).count();
+	if (lastCost_ > maxCost_) maxCost_ = lastCost_;
+	totalCost_ += lastCost_;
+	numCalls_++;
+	
+	return frequency;
+}
+
+void PitchDetector::reset_cost() {
+	lastCost_ = maxCost_ = 0;
+	totalCost_ = 0;
+	numCalls_ = 0;
+}
+
+// Vertex of the parabola through three equidistant points
+float PitchDetector::parabolic_offset(float left, float middle, float right) {
+	float denominator = 2 * (2 * middle - left - right);
+	if (denominator == 0) return 0;
+	float offset = (right - left) / denominator;
+	if (offset > 0.5f) return 0.5f;
+	if (offset < -0.5f) return -0.5f;
+	return offset;
+}
+
+// Frequency of a spectrum peak using parabolic interpolation of the bin
+// and its neighbours (not possible at the edges of the spectrum)
+float PitchDetector::interpolated_bin_frequency(const PitchInput& input, unsigned int bin) {
+	const std::vector<float>& spectrum = *input.spectrum;
+	float deltaFreq = 0;
+	if (bin > 0 && bin + 1 < spectrum.size()) {
+		deltaFreq = parabolic_offset(spectrum[bin - 1], spectrum[bin], spectrum[bin + 1]);
+	}
+	return (bin + deltaFreq) * input.sampleRate / input.fftSize;
+}
+
+
+// Allocate the spectrum scratch (NOT REAL-TIME SAFE, use at beginning)
+void FftCorrelator::setup(unsigned int fftSize) {
+	fftSize_ = fftSize;
+	re_.resize(fftSize / 2 + 1);
+	im_.resize(fftSize / 2 + 1);
+}
+
+// Cross-correlation of the first W samples with the whole window: the
+// product of the transform of x with the conjugate transform of the
+// zero-padded first W samples. As long as tau < N - W no product wraps
+// around the circular correlation.
+void FftCorrelator::correlate(Fft& fft, const float *x, unsigned int W, float *out) {
+	const unsigned int numBins = fftSize_ / 2 + 1;
+	
+	// Transform of the whole window, kept aside
+	memcpy(&fft.td(0), x, fftSize_ * sizeof(float));
+	fft.fft();
+	for (unsigned int k = 0; k < numBins; k++) {
+		re_[k] = fft.fdr(k);
+		im_[k] = fft.fdi(k);
+	}
+	
+	// Transform of the zero-padded start of the window
+	float *timeDomain = &fft.td(0);
+	memset(timeDomain + W, 0, (fftSize_ - W) * sizeof(float));
+	fft.fft();
+	
+	// X * conj(Y)
+	for (unsigned int k = 0; k < numBins; k++) {
+		float c = fft.fdr(k), d = fft.fdi(k);
+		fft.fdr(k) = re_[k] * c + im_[k] * d;
+		fft.fdi(k) = im_[k] * c - re_[k] * d;
+	}
+	fft.ifft();
+	
+	// The scaling of the inverse transform differs between FFT libraries,
+	// so it is taken from the lag 0 value calculated directly
+	double energy = 0;
+	for (unsigned int j = 0; j < W; j++) energy += x[j] * x[j];
+	float scale = timeDomain[0] != 0 ? energy / timeDomain[0] : 0;
+	for (unsigned int tau = 0; tau < fftSize_ - W; tau++) out[tau] = timeDomain[tau] * scale;
+}
+
+// Autocorrelation of W <= N/2 samples: the zero-padded signal needs only
+// one forward transform, its power spectrum is transformed back
+void FftCorrelator::autocorrelate(Fft& fft, const float *x, unsigned int W, float *out) {
+	const unsigned int numBins = fftSize_ / 2 + 1;
+	float *timeDomain = &fft.td(0);
+	memcpy(timeDomain, x, W * sizeof(float));
+	memset(timeDomain + W, 0, (fftSize_ - W) * sizeof(float));
+	fft.fft();
+	
+	for (unsigned int k = 0; k < numBins; k++) {
+		float a = fft.fdr(k), b = fft.fdi(k);
+		fft.fdr(k) = a * a + b * b;
+		fft.fdi(k) = 0;
+	}
+	fft.ifft();
+	
+	double energy = 0;
+	for (unsigned int j = 0; j < W; j++) energy += x[j] * x[j];
+	float scale = timeDomain[0] != 0 ? energy / timeDomain[0] : 0;
+	for (unsigned int tau = 0; tau < W; tau++) out[tau] = timeDomain[tau] * scale;
+}
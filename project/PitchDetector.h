@@ -0,0 +1,99 @@
+/***** PitchDetector.h *****/
+/* Interface of the fundamental frequency detectors behind the spectrum
+ * analyzer. All detectors share the FFT object of the analyzer and only
+ * use memory allocated during setup. Every call is timed, so that the
+ * cost per hop of each engine can be compared.
+ *
+ * ECS7012P - Queen Mary University of London
+ * Final project, Max Tamussino
+ */
+
+#pragma once
+#include <vector>
+#include <libraries/Fft/Fft.h>
+#include "PeakTracker.h"
+
+// Everything a detector may use for one hop
+struct PitchInput {
+	const float *window;				// Time domain window (fftSize samples, not windowed)
+	const std::vector<float> *spectrum;	// Magnitude spectrum (fftSize/2 bins)
+	unsigned int peakIndex;				// Bin of the global maximum of the spectrum
+	Fft *fft;							// Shared FFT, free to be used as scratch
+	unsigned int fftSize;
+	float sampleRate;					// Sample rate of the window
+	const std::vector<SpectralPeak> *peaks;	// Refined peaks of all levels, strongest first
+										// (nullptr if the detector has to find them itself)
+};
+
+class PitchDetector {
+public:
+	// Available detectors
+	enum Type { kHarmonic, kHarmonicProductSpectrum, kYin, kMcLeod, kNumTypes };
+	
+	// Create a detector of the given type (NOT REAL-TIME SAFE)
+	static PitchDetector* create(Type type);
+	
+	// Detector names for command lines, e.g. "yin"
+	static const char* type_name(Type type);
+	static bool type_from_name(const char *name, Type& type);
+	
+	// Setup (NOT REAL-TIME SAFE), allocates all scratch memory. The
+	// sample rate is passed with every window, as it depends on the level
+	// of the analysis pyramid that is used.
+	virtual bool setup(unsigned int fftSize) = 0;
+	
+	// Detect the fundamental frequency in Hz (0 if none was found) and
+	// measure the time it takes
+	float process(const PitchInput& input);
+	
+	// Cost per hop in microseconds
+	float last_cost_us() const { return lastCost_; }
+	float mean_cost_us() const { return numCalls_ ? totalCost_ / numCalls_ : 0; }
+	float max_cost_us() const { return maxCost_; }
+	void reset_cost();
+	
+	virtual Type type() const = 0;
+	
+	// Time domain detectors need more samples per period than the
+	// spectrum, they are given the window of the next higher rate
+	virtual bool time_domain() const { return false; }
+	
+	// Destructor
+	virtual ~PitchDetector() {}
+	
+protected:
+	// The actual detection, implemented by each engine
+	virtual float detect(const PitchInput& input) = 0;
+	
+	// Offset of the true maximum from index 1 of three neighbouring values,
+	// by fitting a parabola through them (between -0.5 and 0.5)
+	static float parabolic_offset(float left, float middle, float right);
+	
+	// Frequency of a spectrum peak, interpolated on the magnitudes
+	static float interpolated_bin_frequency(const PitchInput& input, unsigned int bin);
+	
+private:
+	// Cost statistics
+	float lastCost_ = 0, maxCost_ = 0;
+	double totalCost_ = 0;
+	unsigned int numCalls_ = 0;
+};
+
+// Correlation r(tau) = sum over j < W of x[j] x[j + tau], for tau < N - W,
+// calculated with the shared FFT of size N. Used by the time domain detectors.
+class FftCorrelator {
+public:
+	// Setup (NOT REAL-TIME SAFE)
+	void setup(unsigned int fftSize);
+	
+	// Correlate the first W samples of x (N samples) with x, the result
+	// (N - W values) is written to out
+	void correlate(Fft& fft, const float *x, unsigned int W, float *out);
+	
+	// Autocorrelation of the W samples of x, for tau < W (W <= N/2)
+	void autocorrelate(Fft& fft, const float *x, unsigned int W, float *out);
+	
+private:
+	unsigned int fftSize_ = 0;
+	std::vector<float> re_, im_;	// Transform of x while the FFT is reused
+};
@@ -0,0 +1,173 @@
+/***** PolyphonicDetector.cpp *****/
+/* Class implementation of the detection of several simultaneous notes
+ *
+ * ECS7012P - Queen Mary University of London
+ * Final project, Max Tamussino
+ */
+
+#include <chrono>
+#include <cmath>
+#include <vector>
+#include "PolyphonicDetector.h"
+
+// Harmonic offsets and weights, and all buffers (NOT REAL-TIME SAFE, use
+// at beginning)
+bool PolyphonicDetector::setup(unsigned int numBins, unsigned int binsPerOctave, float minFrequency,
+							   unsigned int maxVoices) {
+	if (maxVoices == 0 || maxVoices > kMaxVoices || binsPerOctave == 0 || numBins <= binsPerOctave) return false;
+	numBins_ = numBins;
+	binsPerOctave_ = binsPerOctave;
+	minFrequency_ = minFrequency;
+	maxVoices_ = maxVoices;
+
+	// A candidate needs at least its second harmonic in the spectrum. The
+	// weights fall with the harmonic number, so that a candidate an octave
+	// below a note (which has the note's partials as its even harmonics)
+	// stays below the note itself.
+	numCandidates_ = numBins_ - binsPerOctave_;
+	for (unsigned int h = 0; h < kHarmonics; h++) {
+		harmonicOffsets_[h] = lroundf(binsPerOctave_ * log2f(h + 1));
+		harmonicWeights_[h] = 1.0f / (h + 1);
+	}
+
+	const unsigned int paddedBins = numBins_ + harmonicOffsets_[kHarmonics - 1] + kSearchBins + 1;
+	residual_.assign(paddedBins, 0);
+	localMax_.assign(paddedBins, 0);
+	salience_.assign(numCandidates_, 0);
+	voices_.reserve(kMaxVoices);
+	voices_.clear();
+	return true;
+}
+
+float PolyphonicDetector::bin_frequency(float bin) const {
+	return minFrequency_ * powf(2.0, bin / binsPerOctave_);
+}
+
+// See PolyphonicDetector.h for the three steps of every voice
+unsigned int PolyphonicDetector::process(const float *spectrum, const std::vector<SpectralPeak> *peaks) {
+	auto before = std::chrono::steady_clock::now();
+	voices_.clear();
+	for (unsigned int bin = 0; bin < numBins_; bin++) residual_[bin] = spectrum[bin];
+
+	float firstSalience = 0;
+	while (voices_.size() < maxVoices_) {
+		// Peak of the residual around every bin
+		for (unsigned int bin = 0; bin < numBins_; bin++) {
+			float value = residual_[bin];
+			if (bin > 0 && residual_[bin - 1] > value) value = residual_[bin - 1];
+			if (residual_[bin + 1] > value) value = residual_[bin + 1];
+			localMax_[bin] = value;
+		}
+
+		// Salience of all candidates, one harmonic at a time
+		for (unsigned int bin = 0; bin < numCandidates_; bin++) salience_[bin] = 0;
+		for (unsigned int h = 0; h < kHarmonics; h++) {
+			const float weight = harmonicWeights_[h];
+			const float *harmonic = &localMax_[harmonicOffsets_[h]];
+			for (unsigned int bin = 0; bin < numCandidates_; bin++) salience_[bin] += weight * harmonic[bin];
+		}
+
+		// Earlier voices are not found again from what is left of them:
+		// another note is at least a semitone away
+		const int excluded = binsPerOctave_ / 12 > 1 ? binsPerOctave_ / 12 - 1 : 0;
+		for (const Voice& voice : voices_) {
+			int centre = lroundf(binsPerOctave_ * log2f(voice.frequency / minFrequency_));
+			for (int bin = centre - excluded; bin <= centre + excluded; bin++) {
+				if (bin >= 0 && bin < (int)numCandidates_) salience_[bin] = 0;
+			}
+		}
+
+		// Most salient candidate with partials strong enough and a
+		// fundamental of its own, trying the next one if it has none
+		int best = -1;
+		float bestSalience = 0;
+		int partialBins[kHarmonics];
+		float partials[kHarmonics];
+		float strongest = 0;
+		for (unsigned int attempt = 0; attempt < kHarmonics && best < 0; attempt++) {
+			int candidate = -1;
+			float candidateSalience = 0;
+			for (unsigned int bin = 0; bin < numCandidates_; bin++) {
+				if (salience_[bin] > candidateSalience) {
+					candidateSalience = salience_[bin];
+					candidate = bin;
+				}
+			}
+			if (candidate < 0 || candidateSalience < kMinSalienceRatio * firstSalience) break;
+
+			strongest = 0;
+			for (unsigned int h = 0; h < kHarmonics; h++) {
+				int centre = candidate + harmonicOffsets_[h];
+				partialBins[h] = centre;
+				partials[h] = 0;
+				for (int bin = centre - kSearchBins; bin <= centre + kSearchBins; bin++) {
+					if (bin >= 0 && bin < (int)numBins_ && residual_[bin] > partials[h]) {
+						partials[h] = residual_[bin];
+						partialBins[h] = bin;
+					}
+				}
+				if (partials[h] > strongest) strongest = partials[h];
+			}
+			if (strongest < kMinAmplitude) break;
+			if (partials[0] < kMinFundamentalRatio * strongest) {
+				salience_[candidate] = 0;
+				continue;
+			}
+			best = candidate;
+			bestSalience = candidateSalience;
+		}
+		if (best < 0) break;
+		if (voices_.empty()) firstSalience = bestSalience;
+
+		// Frequency from the strongest of the first partials: interpolated
+		// on the spectrum, then from the peak list if it has that partial
+		unsigned int h0 = 0;
+		for (unsigned int h = 1; h < 4; h++) {
+			if (partials[h] > partials[h0]) h0 = h;
+		}
+		int bin = partialBins[h0];
+		float offset = 0;
+		if (bin > 0 && bin + 1 < (int)numBins_) {
+			float left = spectrum[bin - 1], middle = spectrum[bin], right = spectrum[bin + 1];
+			float denominator = 2 * (2 * middle - left - right);
+			if (denominator > 0) offset = fmaxf(-0.5f, fminf(0.5f, (right - left) / denominator));
+		}
+		float frequency = bin_frequency(bin + offset) / (h0 + 1);
+		if (peaks != nullptr) {
+			const SpectralPeak *peak = strongest_peak_near(*peaks, (h0 + 1) * frequency, 0.02);
+			if (peak != nullptr) frequency = peak->frequency / (h0 + 1);
+		}
+		Voice voice;
+		voice.frequency = frequency;
+		voice.midiNote = 69.0 + 12.0 * log2f(frequency / 440.0);
+		voice.salience = bestSalience;
+		voices_.push_back(voice);
+
+		// Cancel every partial down to the mean of it and its neighbours
+		for (unsigned int h = 0; h < kHarmonics; h++) {
+			if (partials[h] <= 0) continue;
+			float sum = partials[h];
+			unsigned int count = 1;
+			if (h > 0) {
+				sum += partials[h - 1];
+				count++;
+			}
+			if (h + 1 < kHarmonics) {
+				sum += partials[h + 1];
+				count++;
+			}
+			float cancelled = fminf(partials[h], sum / count);
+			float factor = 1 - cancelled / partials[h];
+			for (int bin = partialBins[h] - kCancelBins; bin <= partialBins[h] + kCancelBins; bin++) {
+				if (bin >= 0 && bin < (int)numBins_) residual_[bin] *= factor;
+			}
+		}
+	}
+
+	auto after = std::chrono::steady_clock::now();
+	lastCost_ = std::chrono::duration<float, std::micro>(after - before).count();
+	if (lastCost_ > maxCost_) maxCost_ = lastCost_;
+	totalCost_ += lastCost_;
+	numCalls_++;
+	return voices_.size();
+}
@@ -0,0 +1,98 @@
+/***** PolyphonicDetector.h *****/
+/* Class implementation of the detection of several simultaneous notes
+ * (chords, or a note still ringing under the next one) in the merged
+ * log-frequency spectrum, by iterative estimation and cancellation:
+ *
+ * 1. The salience of every candidate fundamental is the weighted sum of
+ *    the residual spectrum at its first kHarmonics harmonics. On the log
+ *    grid the harmonics lie at fixed bin offsets from the candidate, so
+ *    the sums of all candidates are one pass per harmonic.
+ * 2. The most salient candidate becomes a voice, its frequency taken from
+ *    its strongest partial.
+ * 3. Its partials are cancelled from the residual, each only down to the
+ *    mean of its neighbouring partials (spectral smoothness), so that a
+ *    partial shared with another note keeps that note's part.
+ *
+ * This repeats until maxVoices are found or the best salience falls below
+ * a fraction of the first one. All buffers are allocated at setup.
+ *
+ * ECS7012P - Queen Mary University of London
+ * Final project, Max Tamussino
+ */
+
+#pragma once
+#include <vector>
+#include "PeakTracker.h"
+
+class PolyphonicDetector {
+public:
+	// Detector parameters
+	static const int kMaxVoices = 6;	// Most notes per hop
+	static const int kHarmonics = 10;	// Harmonics summed per candidate
+	static const int kSearchBins = 1;	// Bins searched around every harmonic for its peak
+	static const int kCancelBins = 3;	// Bins cancelled on either side of a partial
+	static constexpr float kMinSalienceRatio = 0.2;	// Weakest voice relative to the first
+	static constexpr float kMinAmplitude = 1e-3;	// Weakest partial of a voice (-60 dBFS)
+	static constexpr float kMinFundamentalRatio = 0.1;	// Weakest fundamental relative to the strongest partial
+
+	// One detected note
+	struct Voice {
+		float frequency;	// Hz
+		float midiNote;		// Fractional MIDI note number
+		float salience;		// Weighted sum of its partial amplitudes
+	};
+
+	// Constructor
+	PolyphonicDetector() {}
+
+	// Setup (NOT REAL-TIME SAFE) for a spectrum of numBins bins with
+	// binsPerOctave bins per octave from minFrequency on. Returns false if
+	// maxVoices is 0 or above kMaxVoices.
+	bool setup(unsigned int numBins, unsigned int binsPerOctave, float minFrequency, unsigned int maxVoices);
+
+	// Detect the notes of one hop in a spectrum of amplitudes. The peaks of
+	// the hop (strongest first, may be nullptr) refine the frequencies.
+	// Returns the number of voices, strongest first.
+	unsigned int process(const float *spectrum, const std::vector<SpectralPeak> *peaks);
+
+	// Voices of the last hop, strongest first
+	const std::vector<Voice>& voices() const { return voices_; }
+	unsigned int max_voices() const { return maxVoices_; }
+
+	// Cost per hop in microseconds
+	float last_cost_us() const { return lastCost_; }
+	float mean_cost_us() const { return numCalls_ ? totalCost_ / numCalls_ : 0; }
+	float max_cost_us() const { return maxCost_; }
+
+	// Destructor
+	~PolyphonicDetector() {}
+
+private:
+	// Frequency of a (fractional) bin
+	float bin_frequency(float bin) const;
+
+	// Grid and limits
+	unsigned int numBins_ = 0;
+	unsigned int binsPerOctave_ = 0;
+	float minFrequency_ = 0;
+	unsigned int maxVoices_ = 0;
+	unsigned int numCandidates_ = 0;
+
+	// Bin offset and weight of every harmonic
+	int harmonicOffsets_[kHarmonics];
+	float harmonicWeights_[kHarmonics];
+
+	// Residual spectrum, its maximum over the search range of every bin
+	// (both padded with zeros beyond the spectrum for the high harmonics),
+	// and the salience of every candidate
+	std::vector<float> residual_;
+	std::vector<float> localMax_;
+	std::vector<float> salience_;
+
+	std::vector<Voice> voices_;
+
+	// Cost statistics
+	float lastCost_ = 0, maxCost_ = 0;
+	double totalCost_ = 0;
+	unsigned int numCalls_ = 0;
+};
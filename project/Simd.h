@@ -0,0 +1,104 @@
+/***** Simd.h *****/
+/* Four-lane float/int vector types and helpers based on the vector
+ * extensions of GCC and Clang. They compile to NEON instructions on the
+ * Bela board and to SSE instructions on a x86 host, so the same code is
+ * used on both.
+ *
+ * ECS7012P - Queen Mary University of London
+ * Final project, Max Tamussino
+ */
+
+#pragma once
+#include <cstdint>
+#include <cstring>
+#include <cmath>
+#if defined(__ARM_NEON) || defined(__ARM_NEON__)
+#include <arm_neon.h>
+#elif defined(__SSE__)
+#include <xmmintrin.h>
+#endif
+
+typedef float float4 __attribute__((vector_size(16)));
+typedef int32_t int4 __attribute__((vector_size(16)));
+
+// Unaligned load and store
+inline float4 load4(const float *p) { float4 v; memcpy(&v, p, sizeof(v)); return v; }
+inline void store4(float *p, float4 v) { memcpy(p, &v, sizeof(v)); }
+inline int4 load4(const int32_t *p) { int4 v; memcpy(&v, p, sizeof(v)); return v; }
+inline void store4(int32_t *p, int4 v) { memcpy(p, &v, sizeof(v)); }
+
+// All lanes set to the same value
+inline float4 splat4(float x) { float4 v = {x, x, x, x}; return v; }
+inline int4 splat4(int32_t x) { int4 v = {x, x, x, x}; return v; }
+
+// Lane-wise mask ? a : b, the mask being the result of a comparison
+inline float4 select4(int4 mask, float4 a, float4 b) { return (float4)((mask & (int4)a) | (~mask & (int4)b)); }
+inline int4 select4(int4 mask, int4 a, int4 b) { return (mask & a) | (~mask & b); }
+
+// Lane-wise minimum and maximum
+inline float4 min4(float4 a, float4 b) { return select4(a < b, a, b); }
+inline float4 max4(float4 a, float4 b) { return select4(a > b, a, b); }
+
+// Split four interleaved complex values (r0 i0 r1 i1, r2 i2 r3 i3) into
+// their real and imaginary parts
+inline void deinterleave4(float4 a, float4 b, float4& re, float4& im) {
+#if defined(__clang__)
+	re = __builtin_shufflevector(a, b, 0, 2, 4, 6);
+	im = __builtin_shufflevector(a, b, 1, 3, 5, 7);
+#else
+	re = __builtin_shuffle(a, b, int4{0, 2, 4, 6});
+	im = __builtin_shuffle(a, b, int4{1, 3, 5, 7});
+#endif
+}
+
+// Natural logarithm for positive, normal inputs (max. error around 1e-7):
+// the exponent is taken from the float bits, the mantissa is reduced to
+// [sqrt(0.5), sqrt(2)) and log(m) = 2 atanh((m - 1) / (m + 1)) is evaluated
+// as an odd series
+inline float4 log4(float4 x) {
+	int4 bits = (int4)x;
+	int4 exponent = ((bits >> 23) & 0xff) - 127;
+	float4 mantissa = (float4)((bits & 0x007fffff) | 0x3f800000);
+	int4 large = mantissa > splat4(1.41421356f);
+	mantissa = select4(large, mantissa * 0.5f, mantissa);
+	exponent = select4(large, exponent + 1, exponent);
+
+	float4 s = (mantissa - 1.0f) / (mantissa + 1.0f);
+	float4 s2 = s * s;
+	float4 series = s * (2.0f + s2 * (0.666666667f + s2 * (0.4f + s2 * (0.285714286f + s2 * 0.222222222f))));
+	return series + __builtin_convertvector(exponent, float4) * 0.693147181f;
+}
+
+// Square root as x * rsqrt(x) (max. relative error around 1e-6): the
+// reciprocal square root estimate of NEON (8 bits) is refined with two
+// Newton steps, that of SSE (12 bits) with one. Inputs below the smallest
+// normal float give 0, where the estimate would be infinite.
+inline float4 sqrt4(float4 x) {
+#if defined(__ARM_NEON) || defined(__ARM_NEON__)
+	float32x4_t v = (float32x4_t)x;
+	float32x4_t r = vrsqrteq_f32(v);
+	r = vmulq_f32(r, vrsqrtsq_f32(vmulq_f32(v, r), r));
+	r = vmulq_f32(r, vrsqrtsq_f32(vmulq_f32(v, r), r));
+	float4 rsqrt = (float4)r;
+#elif defined(__SSE__)
+	float4 rsqrt = (float4)_mm_rsqrt_ps((__m128)x);
+	rsqrt = rsqrt * (1.5f - 0.5f * x * rsqrt * rsqrt);
+#else
+	float4 rsqrt;
+	for (int lane = 0; lane < 4; lane++) rsqrt[lane] = 1.0f / sqrtf(x[lane]);
+#endif
+	return select4(x >= splat4(1.17549435e-38f), x * rsqrt, splat4(0.0f));
+}
+
+// Horizontal maximum of the lanes, with the lane index of the first maximum
+inline float horizontal_max4(float4 v, int4 index, int32_t& maxIndex) {
+	float best = v[0];
+	maxIndex = index[0];
+	for (int lane = 1; lane < 4; lane++) {
+		if (v[lane] > best || (v[lane] == best && index[lane] < maxIndex)) {
+			best = v[lane];
+			maxIndex = index[lane];
+		}
+	}
+	return best;
+}
@@ -0,0 +1,461 @@
+/***** SpectrumAnalyzer.cpp *****/
+/* Class implementation of the spectrum and pitch analysis chain:
+ * multi-rate pyramid, windowed FFT per level, merged log-frequency
+ * spectrum, pitch detection and MIDI note number.
+ *
+ * ECS7012P - Queen Mary University of London
+ * Final project, Max Tamussino
+ */
+
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+#include <new>
+#include <vector>
+#include <libraries/math_neon/math_neon.h>
+#include "HarmonicPitchDetector.h"
+#include "SpectrumAnalyzer.h"
+#include "StageTiming.h"
+
+// Constructor setting the buffer lengths
+SpectrumAnalyzer::SpectrumAnalyzer() : droppedWindows_(0), lateWindows_(0), totalHops_(0), gatedHops_(0),
+	skippedHops_(0), tuningMode_(kTuningOff),
+	requestedTarget_(0),
+	tuningTarget_(0), tuningCents_(0), tuningLocked_(false) {
+	// Empty
+}
+
+// Aligned to the cache lines (NOT REAL-TIME SAFE)
+void* SpectrumAnalyzer::operator new(std::size_t size) {
+	void *pointer = nullptr;
+	if (posix_memalign(&pointer, 64, size) != 0) throw std::bad_alloc();
+	return pointer;
+}
+
+void SpectrumAnalyzer::operator delete(void *pointer) {
+	free(pointer);
+}
+
+// Set up with the default configuration (NOT REAL-TIME SAFE, use at beginning)
+bool SpectrumAnalyzer::setup(float sampleRate) {
+	return setup(sampleRate, Config());
+}
+
+// Set up the pyramid, the FFT and their buffers (NOT REAL-TIME SAFE, use at beginning)
+bool SpectrumAnalyzer::setup(float sampleRate, const Config& config) {
+	// The FFT size has to be a power of two, the hop a whole number of chunks
+	if (config.numLevels < 1 || config.numLevels > kMaxLevels) return false;
+	if (config.levelFftSize < 16 || (config.levelFftSize & (config.levelFftSize - 1)) != 0) return false;
+	if (config.hopSize == 0 || config.hopSize % kChunkSize != 0 || config.hopOffset >= config.hopSize) return false;
+	config_ = config;
+	numLevels_ = config.numLevels;
+	levelFftSize_ = config.levelFftSize;
+	hopSize_ = config.hopSize;
+	phaseLag_ = levelFftSize_ / 4;
+	windowLength_ = levelFftSize_ + phaseLag_;
+	sampleRate_ = sampleRate;
+	
+	// Set up the decimators and one input buffer per level
+	chunk_.assign(kChunkSize, 0);
+	if (!pyramid_.setup(numLevels_, kChunkSize, kFirstFactor, kPassband, kAttenuationDb)) return false;
+	levelBuffers_.clear();
+	for (unsigned int level = 0; level < numLevels_; level++) {
+		levelBuffers_.push_back(CircularBuffer<float>(4 * levelFftSize_));
+		levelBuffers_[level].setup();
+	}
+	
+	// Set up the FFT and the window and spectrum of each level
+	if (fft_.setup(levelFftSize_) != 0) return false;
+	levelStages_.resize(numLevels_);
+	for (unsigned int level = 0; level < numLevels_; level++) {
+		if (!levelStages_[level].setup(levelFftSize_, config.window, SpectrumStage::kScaleMagnitude)) return false;
+	}
+	
+	// Peaks and partial tracks over all levels
+	peakTracker_.setup();
+	
+	// Polyphonic mode on the merged spectrum
+	if (config.maxVoices > 0 &&
+		!polyphonicDetector_.setup(kNumLogBins, kLogBinsPerOctave, kLogMinFrequency, config.maxVoices)) return false;
+	
+	// Constant-Q kernel of the octave of the highest level, starting at the
+	// first bin of the grid from A0 in it. The grid repeats every octave,
+	// so the kernel fits the octaves of the lower levels as well.
+	constantQSpectrum_.clear();
+	if (config.constantQBinsPerOctave > 0) {
+		const unsigned int binsPerOctave = config.constantQBinsPerOctave;
+		const float octaveStart = level_sample_rate(0) / 8;
+		int firstBin = ceilf(binsPerOctave * log2f(octaveStart / kLogMinFrequency) - 1e-3f);
+		float firstFrequency = kLogMinFrequency * powf(2.0, (float)firstBin / binsPerOctave) / level_sample_rate(0);
+		if (!constantQKernel_.setup(levelFftSize_, binsPerOctave, firstFrequency, levelStages_[0].window_table())) {
+			return false;
+		}
+		constantQFirstBin_ = firstBin - (int)((numLevels_ - 1) * binsPerOctave);
+		constantQSpectrum_.assign(numLevels_ * binsPerOctave, 0);
+	}
+	
+	// Phase refinement with the same window as the spectra
+	if (!phaseRefiner_.setup(levelFftSize_, phaseLag_, levelStages_[0].window_table())) return false;
+	
+	// Set up the pitch detector, it shares the FFT
+	detector_.reset(PitchDetector::create(config.detector));
+	if (!detector_ || !detector_->setup(levelFftSize_)) return false;
+	if (config.detector == PitchDetector::kHarmonic) {
+		static_cast<HarmonicPitchDetector*>(detector_.get())->set_check_harmonics(config.checkHarmonics);
+	}
+	
+	// Every bin of the merged spectrum is read from the lowest rate level
+	// whose octave band reaches above it. The highest level is used up to
+	// the edge of its passband, the lowest one down to 0 Hz.
+	logBinLevel_.resize(kNumLogBins);
+	logBinPosition_.resize(kNumLogBins);
+	logSpectrum_.assign(kNumLogBins, 0);
+	for (unsigned int bin = 0; bin < kNumLogBins; bin++) {
+		float frequency = log_bin_frequency(bin);
+		int level = level_of_frequency(frequency);
+		logBinLevel_[bin] = level;
+		logBinPosition_[bin] = level >= 0 ? frequency * levelFftSize_ / level_sample_rate(level) : 0;
+	}
+	
+	// Level and onset gate on the octave bands of the pyramid
+	if (!gate_.setup(numLevels_, config.gate)) return false;
+	totalHops_.store(0);
+	gatedHops_.store(0);
+	
+	// Tuning bank, off until a target is requested
+	tuningBank_.setup();
+	bankTarget_ = 0;
+	lockedHops_ = 0;
+	skippedHops_.store(0);
+	tuningTarget_.store(0);
+	tuningCents_.store(0);
+	tuningLocked_.store(false);
+	
+	windowQueue_.setup(kQueueLength, numLevels_ * windowLength_);
+	queuedHops_.assign(kQueueLength, 0);
+	pushedWindows_ = 0;
+	poppedWindows_ = 0;
+	droppedWindows_.store(0);
+	lateWindows_.store(0);
+	
+	// An offset starts the first chunk and hop part of the way through, the
+	// first chunk with silence
+	chunkFrames_ = config.hopOffset % kChunkSize;
+	hopCounter_ = config.hopOffset - chunkFrames_;
+	
+	detectionLevel_ = 0;
+	hopCount_ = 0;
+	analysedHop_ = 0;
+	detectedFreq_ = 0;
+	for (unsigned int h = 0; h < kRefinedPartials; h++) refinedPartials_[h] = 0;
+	set_tuning(config.tuningMode, config.tuningReference);
+	setupDone_ = true;
+	return true;
+}
+
+// Centre frequency of a (fractional) bin of the merged spectrum
+float SpectrumAnalyzer::log_bin_frequency(float bin) {
+	return kLogMinFrequency * powf(2.0, bin / kLogBinsPerOctave);
+}
+
+float SpectrumAnalyzer::constant_q_frequency(float bin) const {
+	return kLogMinFrequency * powf(2.0, (constantQFirstBin_ + bin) / config_.constantQBinsPerOctave);
+}
+
+// The lowest rate level whose octave band reaches above the frequency. The
+// highest level is used up to the edge of its passband, the lowest one
+// down to 0 Hz.
+int SpectrumAnalyzer::level_of_frequency(float frequency) const {
+	int level = numLevels_ - 1;
+	while (level >= 0 && frequency >= level_sample_rate(level) / 4) level--;
+	if (level < 0 && frequency < kPassband / 2 * level_sample_rate(0)) level = 0;
+	return level;
+}
+
+// Fraction of all hops which were skipped or gated (any thread)
+float SpectrumAnalyzer::skipped_fraction() const {
+	unsigned int hops = totalHops_.load(std::memory_order_relaxed);
+	if (hops == 0) return 0;
+	return (skippedHops_.load(std::memory_order_relaxed) + gatedHops_.load(std::memory_order_relaxed)) / (float)hops;
+}
+
+// Feed a block of samples into the analysis (audio thread). No FFT is done
+// here, at every hop the windows of all levels are only copied into the
+// queue for the worker.
+bool SpectrumAnalyzer::process_block(const float *input, unsigned int frames) {
+	bool newWindow = false;
+	
+	while (frames > 0) {
+		// Collect the input into a chunk
+		unsigned int count = kChunkSize - chunkFrames_;
+		if (count > frames) count = frames;
+		memcpy(&chunk_[chunkFrames_], input, count * sizeof(float));
+		chunkFrames_ += count;
+		input += count;
+		frames -= count;
+		if (chunkFrames_ < kChunkSize) break;
+		chunkFrames_ = 0;
+		
+		// Lowpass filter and downsample into every level of the pyramid
+		{
+			STAGE_TIMER(kStageDecimation);
+			pyramid_.process(chunk_.data(), kChunkSize);
+			for (unsigned int level = 0; level < numLevels_; level++) {
+				const float *output = pyramid_.output(level);
+				for (unsigned int n = 0; n < pyramid_.output_frames(level); n++) {
+					levelBuffers_[level].write_element(output[n]);
+				}
+			}
+		}
+		{
+			STAGE_TIMER(kStageGate);
+			for (unsigned int level = 0; level < numLevels_; level++) {
+				gate_.process_band(level, pyramid_.output(level), pyramid_.output_frames(level));
+			}
+			gate_.end_chunk(kChunkSize);
+		}
+		process_tuning();
+		
+		// Queue the windows of all levels if we've reached the hop size (a
+		// multiple of the chunk size, so that all levels end at the same
+		// input sample)
+		hopCounter_ += kChunkSize;
+		if (hopCounter_ == hopSize_) {
+			hopCounter_ = 0;
+			unsigned int hop = totalHops_.fetch_add(1, std::memory_order_relaxed);
+			
+			// The gate holds the last result in silence and thins out the
+			// hops of a steady note
+			bool onset = gate_.state() == AnalysisGate::kStateOnset;
+			if (!gate_.analyse_hop()) {
+				gatedHops_.fetch_add(1, std::memory_order_relaxed);
+				continue;
+			}
+			
+			// While the tuning bank is locked, the FFT path only has to
+			// notice when the note changes, unless there was an onset
+			if (tuningLocked_.load(std::memory_order_relaxed) && !onset) {
+				if (++lockedHops_ < kLockedHopInterval) {
+					skippedHops_.fetch_add(1, std::memory_order_relaxed);
+					continue;
+				}
+			}
+			lockedHops_ = 0;
+			
+			float *windows = windowQueue_.get_write_window();
+			if (windows == nullptr) {
+				// Worker is too far behind, drop this hop
+				droppedWindows_.fetch_add(1, std::memory_order_relaxed);
+				continue;
+			}
+			// Single copy of each contiguous window straight into the queue,
+			// with the phaseLag_ samples before it
+			STAGE_TIMER(kStageWindowCopy);
+			for (unsigned int level = 0; level < numLevels_; level++) {
+				memcpy(windows + level * windowLength_, levelBuffers_[level].get_last_N_view(windowLength_),
+					windowLength_ * sizeof(float));
+			}
+			queuedHops_[pushedWindows_++ % kQueueLength] = hop;
+			windowQueue_.push();
+			newWindow = true;
+		}
+	}
+	
+	return newWindow;
+}
+
+// Select the tuning mode (any thread), the audio thread picks it up with
+// the next chunk. In follow mode the target is set by the FFT path.
+void SpectrumAnalyzer::set_tuning(TuningMode mode, float reference) {
+	requestedTarget_.store(mode == kTuningReference ? reference : 0, std::memory_order_relaxed);
+	tuningMode_.store(mode, std::memory_order_relaxed);
+}
+
+// Run the tuning bank on the current chunk (audio thread)
+void SpectrumAnalyzer::process_tuning() {
+	STAGE_TIMER(kStageTuningBank);
+	
+	// Retarget: the lowest rate level which holds all partials in its
+	// passband, or the highest level with as many partials as fit
+	float target = tuningMode_.load(std::memory_order_relaxed) == kTuningOff ? 0 :
+		requestedTarget_.load(std::memory_order_relaxed);
+	if (target != bankTarget_) {
+		bankTarget_ = target;
+		int level = numLevels_ - 1;
+		while (level > 0 && TuningBank::kMaxPartials * target > kPassband / 2 * level_sample_rate(level)) level--;
+		unsigned int numPartials = target > 0 ? kPassband / 2 * level_sample_rate(level) / target : 0;
+		bankLevel_ = level;
+		if (!tuningBank_.set_target(target, level_sample_rate(level), numPartials)) tuningBank_.set_target(0, 0, 0);
+	}
+	
+	if (!tuningBank_.active()) {
+		tuningTarget_.store(0, std::memory_order_relaxed);
+		tuningLocked_.store(false, std::memory_order_relaxed);
+		return;
+	}
+	
+	tuningBank_.process(pyramid_.output(bankLevel_), pyramid_.output_frames(bankLevel_));
+	bool locked = tuningBank_.settled() && tuningBank_.amplitude() > kLockAmplitude &&
+		fabsf(tuningBank_.cents()) < kLockCents;
+	tuningTarget_.store(tuningBank_.target(), std::memory_order_relaxed);
+	tuningCents_.store(tuningBank_.cents(), std::memory_order_relaxed);
+	tuningLocked_.store(locked, std::memory_order_relaxed);
+}
+
+// Analyse the oldest queued hop (worker thread)
+bool SpectrumAnalyzer::analyse_next_window() {
+	const float *windows = windowQueue_.get_read_window();
+	if (windows == nullptr) return false;
+	
+	// If a newer hop is already waiting, this result is outdated on arrival
+	if (windowQueue_.size() > 1) lateWindows_.fetch_add(1, std::memory_order_relaxed);
+	
+	// The windows are read straight from the queue and released afterwards
+	analysedHop_ = queuedHops_[poppedWindows_++ % kQueueLength];
+	process_fft(windows);
+	windowQueue_.pop();
+	return true;
+}
+
+
+// This function handles the FFT processing once the windows have been assembled
+void SpectrumAnalyzer::process_fft(const float *windows) {
+	// Windowed FFT, magnitude spectrum and its global maximum of every level
+	for (unsigned int level = 0; level < numLevels_; level++) {
+		{
+			STAGE_TIMER(kStageFft);
+			levelStages_[level].window_input(fft_, windows + level * windowLength_ + phaseLag_);
+			fft_.fft();
+		}
+		STAGE_TIMER(kStageSpectrum);
+		levelStages_[level].compute_spectrum(fft_);
+	}
+	
+	// Strongest peaks of the octave band of every level (the same bands as
+	// in the merged spectrum), linked to the partial tracks
+	{
+		STAGE_TIMER(kStagePeaks);
+		peakTracker_.clear_peaks();
+		for (unsigned int level = 0; level < numLevels_; level++) {
+			float rate = level_sample_rate(level);
+			float minFrequency = level == numLevels_ - 1 ? 0 : rate / 8;
+			float maxFrequency = level == 0 ? kPassband / 2 * rate : rate / 4;
+			peakTracker_.add_spectrum(levelStages_[level].spectrum().data(), levelFftSize_ / 2, rate / levelFftSize_,
+									  2.0 / levelFftSize_, minFrequency, maxFrequency);
+		}
+		peakTracker_.refine_peaks();
+		peakTracker_.update_tracks();
+	}
+	
+	// Merge the levels into the log-frequency spectrum by linear
+	// interpolation. The window is normalised to the coherent gain of the
+	// rectangular window, so 2/N scales the magnitudes to amplitudes.
+	const float amplitudeScale = 2.0 / levelFftSize_;
+	float peakValue = 0;
+	unsigned int peakBin = 0;
+	{
+		STAGE_TIMER(kStageMerge);
+		for (unsigned int bin = 0; bin < kNumLogBins; bin++) {
+			int level = logBinLevel_[bin];
+			if (level < 0) {
+				logSpectrum_[bin] = 0;
+				continue;
+			}
+			const std::vector<float>& levelSpectrum = levelStages_[level].spectrum();
+			float position = logBinPosition_[bin];
+			unsigned int index = position;
+			float fraction = position - index;
+			float value = levelSpectrum[index];
+			if (index + 1 < levelSpectrum.size()) value += fraction * (levelSpectrum[index + 1] - value);
+			value *= amplitudeScale;
+			logSpectrum_[bin] = value;
+			if (value > peakValue) {
+				peakValue = value;
+				peakBin = bin;
+			}
+		}
+	}
+	
+	// Constant-Q spectrum from the bins of every level, the lowest level
+	// first
+	if (!constantQSpectrum_.empty()) {
+		STAGE_TIMER(kStageConstantQ);
+		const unsigned int binsPerOctave = config_.constantQBinsPerOctave;
+		for (unsigned int level = 0; level < numLevels_; level++) {
+			constantQKernel_.process(levelStages_[level].bins().data(),
+									 &constantQSpectrum_[(numLevels_ - 1 - level) * binsPerOctave]);
+		}
+	}
+	
+	// Several notes at once from the merged spectrum and the peaks
+	if (config_.maxVoices > 0) {
+		STAGE_TIMER(kStagePolyphonic);
+		polyphonicDetector_.process(logSpectrum_.data(), &peakTracker_.peaks());
+	}
+	
+	// The detector gets the level which holds the peak of the merged
+	// spectrum (or the next higher rate for time domain detectors), with
+	// the peak as its dominant bin
+	int level = logBinLevel_[peakBin];
+	if (level < 0) level = 0;
+	if (detector_->time_domain() && level > 0) level--;
+	detectionLevel_ = level;
+	
+	const std::vector<float>& levelSpectrum = levelStages_[level].spectrum();
+	unsigned int peakIndex = lroundf(log_bin_frequency(peakBin) * levelFftSize_ / level_sample_rate(level));
+	if (peakIndex >= levelSpectrum.size()) peakIndex = levelSpectrum.size() - 1;
+	if (peakIndex + 1 < levelSpectrum.size() && levelSpectrum[peakIndex + 1] > levelSpectrum[peakIndex]) peakIndex++;
+	else if (peakIndex > 0 && levelSpectrum[peakIndex - 1] > levelSpectrum[peakIndex]) peakIndex--;
+	
+	// Fundamental frequency from the detector. It may use the FFT as
+	// scratch, so it runs after everything else that reads the bins.
+	STAGE_TIMER(kStageDetection);
+	PitchInput input;
+	input.window = windows + level * windowLength_ + phaseLag_;
+	input.spectrum = &levelSpectrum;
+	input.peakIndex = peakIndex;
+	input.fft = &fft_;
+	input.fftSize = levelFftSize_;
+	input.sampleRate = level_sample_rate(level);
+	input.peaks = &peakTracker_.peaks();
+	detectedFreq_ = detector_->process(input);
+	fundamentalFreq_ = config_.phaseRefinement ? refine_partials(windows, detectedFreq_) : detectedFreq_;
+	inharmonicity_ = peakTracker_.inharmonicity(fundamentalFreq_);
+	
+	// Calculate MIDI note number (log2(x) is ln(x)/ln(2)), 0 if no
+	// fundamental was found
+	if (fundamentalFreq_ > 0) midiNoteNumber_ = 12.0 / M_LN2 * logf_neon(fundamentalFreq_ / 440.0) + 69.0;
+	else midiNoteNumber_ = 0;
+	
+	// In follow mode, the nearest note becomes the target of the tuning
+	// bank, unless the bank is still locked onto the previous one
+	if (tuningMode_.load(std::memory_order_relaxed) == kTuningFollow && midiNoteNumber_ > 0 &&
+		!tuningLocked_.load(std::memory_order_relaxed)) {
+		float note = roundf(midiNoteNumber_);
+		requestedTarget_.store(440.0 * powf_neon(2.0, (note - 69.0) / 12.0), std::memory_order_relaxed);
+	}
+	
+	hopCount_++;
+}
+
+// Every partial is refined on the level which holds it, starting from the
+// strongest peak near its harmonic frequency. Without a peak of its own,
+// the fundamental is taken from the lowest refined partial.
+float SpectrumAnalyzer::refine_partials(const float *windows, float fundamental) {
+	for (unsigned int h = 0; h < kRefinedPartials; h++) refinedPartials_[h] = 0;
+	if (fundamental <= 0) return fundamental;
+	
+	for (unsigned int h = 1; h <= kRefinedPartials; h++) {
+		const SpectralPeak *peak = strongest_peak_near(peakTracker_.peaks(), h * fundamental, 0.03);
+		if (peak == nullptr) continue;
+		int level = level_of_frequency(peak->frequency);
+		if (level < 0) break;
+		refinedPartials_[h - 1] = phaseRefiner_.refine(levelStages_[level].bins().data(), windows + level * windowLength_,
+													   peak->frequency, level_sample_rate(level));
+	}
+	
+	for (unsigned int h = 1; h <= kRefinedPartials; h++) {
+		if (refinedPartials_[h - 1] > 0) return refinedPartials_[h - 1] / h;
+	}
+	return fundamental;
+}
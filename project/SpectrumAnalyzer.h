@@ -0,0 +1,311 @@
+/***** SpectrumAnalyzer.h *****/
+/* Class implementation of the spectrum and pitch analysis chain: a
+ * multi-rate pyramid of half-band decimators, a small windowed FFT per
+ * level, a merged log-frequency spectrum, partial tracks of the spectral
+ * peaks (see PeakTracker.h), pitch detection (see PitchDetector.h) and
+ * MIDI note number. It does not depend on the Bela
+ * core or GUI, so it also builds on a Linux host (see host/).
+ *
+ * Level n of the pyramid runs at 1/2^(n+2) of the input rate and covers
+ * the octave from 1/8 to 1/4 of its own rate, so every octave is analysed
+ * with the same FFT size at the cheapest rate that resolves it. With the
+ * default configuration at 44.1 kHz, the lowest level has the bin spacing
+ * of the previous 2048 point FFT after downsampling by 16, while the
+ * highest level reaches up to 4.4 kHz.
+ *
+ * The number of levels, FFT size, hop size, detector and the other
+ * settings are chosen at setup with a Config. A running analyzer is
+ * reconfigured by replacing it with a new one (see AnalyzerSlot.h).
+ *
+ * In the tuning modes, a bank of sliding DFT bins (see TuningBank.h) also
+ * follows a target note on the audio thread, sample by sample. While it
+ * is locked onto the note, only every few hops go through the FFTs.
+ *
+ * The frequencies of the fundamental and its partials can be refined by
+ * the phase advance of their bins between the FFT window and a window
+ * a quarter window earlier (see PhaseRefiner.h).
+ *
+ * In the polyphonic mode, up to Config::maxVoices simultaneous notes are
+ * also found in the merged spectrum (see PolyphonicDetector.h).
+ *
+ * With Config::constantQBinsPerOctave, the bins of every level are also
+ * turned into a constant-Q spectrum on the semitone grid from A0, with a
+ * sparse kernel (see ConstantQKernel.h).
+ *
+ * A level and onset gate (see AnalysisGate.h) on the pyramid outputs stops
+ * the hops in silence, holding the last result, and thins them out during
+ * a steady note until the next onset.
+ *
+ * The audio thread only runs the decimators and copies the windows of all
+ * levels into a wait-free queue. The FFTs and detection run on an analysis
+ * worker (a Bela AuxiliaryTask), which pops the windows one by one.
+ *
+ * ECS7012P - Queen Mary University of London
+ * Final project, Max Tamussino
+ */
+
+#pragma once
+#include <atomic>
+#include <cstddef>
+#include <memory>
+#include <vector>
+#include <libraries/Fft/Fft.h>
+#include "AnalysisGate.h"
+#include "CircularBuffer.h"
+#include "ConstantQKernel.h"
+#include "Decimator.h"
+#include "PeakTracker.h"
+#include "PhaseRefiner.h"
+#include "PitchDetector.h"
+#include "PolyphonicDetector.h"
+#include "SpectrumStage.h"
+#include "TuningBank.h"
+#include "WindowQueue.h"
+
+class SpectrumAnalyzer {
+public:
+	// Fixed analysis parameters
+	static const int kMaxLevels = 8;	// Most octave bands of the pyramid
+	static const int kFirstFactor = 4;	// Downsampling factor of the highest level
+	static const int kChunkSize = 128;	// Input samples per run of the pyramid
+	static constexpr float kPassband = 0.8;	// Passband of every level (rel. to its Nyquist frequency)
+	static constexpr float kAttenuationDb = 60;	// Alias rejection, below the window sidelobes
+	static const int kQueueLength = 4;	// Hops waiting for the worker
+	static const int kRefinedPartials = 4;	// Fundamental and partials refined by their phase
+	
+	// Merged log-frequency spectrum: kLogBinsPerOctave bins per octave
+	// over 7.5 octaves starting at A0, so that every fourth bin is a semitone
+	static constexpr float kLogMinFrequency = 27.5;
+	static const int kLogBinsPerOctave = 48;
+	static const int kNumLogBins = 15 * kLogBinsPerOctave / 2;
+	
+	// Tuning to a target note: off, to a fixed reference frequency, or to
+	// the nearest note of the frequency found by the FFT path
+	enum TuningMode { kTuningOff, kTuningReference, kTuningFollow };
+	static const int kLockedHopInterval = 4;	// Every how many hops the FFT runs while locked
+	static constexpr float kLockAmplitude = 0.001;	// Lowest amplitude of the fundamental to lock (-60 dBFS)
+	static constexpr float kLockCents = 50;	// Largest deviation from the target to lock
+	
+	// Settings chosen at setup
+	struct Config {
+		unsigned int numLevels = 6;	// Octave bands of the pyramid (at most kMaxLevels)
+		unsigned int levelFftSize = 256;	// FFT window size of every level (power of two)
+		unsigned int hopSize = 8192;	// How often we analyse, in input samples (multiple of kChunkSize)
+		unsigned int hopOffset = 0;	// Input samples by which the hops come early (below hopSize), to stagger analyzers
+		SpectrumStage::Window window = SpectrumStage::kWindowHann;
+		PitchDetector::Type detector = PitchDetector::kHarmonic;
+		bool checkHarmonics = true;	// Harmonic detector: check if the dominant peak is a harmonic
+		bool phaseRefinement = true;	// Refine the fundamental by the phase of its bins
+		unsigned int maxVoices = 0;	// Polyphonic mode: most notes per hop (0 is off, at most PolyphonicDetector::kMaxVoices)
+		unsigned int constantQBinsPerOctave = 0;	// Constant-Q spectrum: bins per octave (0 is off, 12 is one per semitone)
+		AnalysisGate::Settings gate;	// Level and onset gate
+		TuningMode tuningMode = kTuningOff;	// Initial tuning mode, see set_tuning()
+		float tuningReference = 0;
+	};
+	
+	// Constructor
+	SpectrumAnalyzer();
+	
+	// Allocation on the heap (see AnalyzerSlot.h) keeps the cache line
+	// alignment of the window queue counters
+	static void* operator new(std::size_t size);
+	static void operator delete(void *pointer);
+	
+	// Setup (NOT REAL-TIME SAFE, must be called during Bela setup or on
+	// another non real-time thread), with the default or a given Config.
+	// Returns false if the configuration is invalid.
+	bool setup(float sampleRate);
+	bool setup(float sampleRate, const Config& config);
+	
+	// Configuration of the last setup, and the sizes derived from it
+	const Config& config() const { return config_; }
+	unsigned int num_levels() const { return numLevels_; }
+	unsigned int level_fft_size() const { return levelFftSize_; }
+	unsigned int hop_size() const { return hopSize_; }
+	unsigned int phase_lag() const { return phaseLag_; }
+	
+	// Audio thread: feed one block of input samples. Returns true if a new
+	// set of windows has been queued, so that the worker should be scheduled
+	bool process_block(const float *input, unsigned int frames);
+	
+	// Worker thread: analyse the oldest queued hop. Returns false if
+	// there was nothing waiting
+	bool analyse_next_window();
+	
+	// Hops discarded because the queue was full, and hops which were
+	// only analysed after a newer one had already been queued
+	unsigned int dropped_windows() const { return droppedWindows_.load(std::memory_order_relaxed); }
+	unsigned int late_windows() const { return lateWindows_.load(std::memory_order_relaxed); }
+	
+	// Results of the last analysis (only to be read by the worker thread):
+	// the merged spectrum (amplitude on the log-frequency grid, 0 above
+	// the highest level)
+	const std::vector<float>& spectrum() const { return logSpectrum_; }
+	float fundamental_frequency() const { return fundamentalFreq_; }
+	float midi_note_number() const { return midiNoteNumber_; }
+	
+	// Fundamental as found by the detector, before the phase refinement,
+	// and the refined frequency of partial h (1 is the fundamental, 0 if
+	// it was not refined)
+	float detected_frequency() const { return detectedFreq_; }
+	float refined_partial(unsigned int h) const { return refinedPartials_[h - 1]; }
+	
+	// Select the tuning mode, and the reference frequency for kTuningReference
+	// (may be called from any thread)
+	void set_tuning(TuningMode mode, float reference = 0);
+	
+	// Results of the tuning bank, updated with every chunk of input (may be
+	// read from any thread): target frequency (0 if off), deviation from it
+	// and whether the bank is locked onto the note
+	float tuning_target() const { return tuningTarget_.load(std::memory_order_relaxed); }
+	float tuning_cents() const { return tuningCents_.load(std::memory_order_relaxed); }
+	bool tuning_locked() const { return tuningLocked_.load(std::memory_order_relaxed); }
+	
+	// Hops which were not analysed because the tuning bank was locked, or
+	// because the gate held them back in silence or during a steady note
+	unsigned int skipped_hops() const { return skippedHops_.load(std::memory_order_relaxed); }
+	unsigned int gated_hops() const { return gatedHops_.load(std::memory_order_relaxed); }
+	
+	// All hops since setup, analysed or not, and the fraction of them that
+	// did not go through the FFTs (may be read from any thread)
+	unsigned int total_hops() const { return totalHops_.load(std::memory_order_relaxed); }
+	float skipped_fraction() const;
+	
+	// Gate on the audio thread (only to be read by the audio thread)
+	const AnalysisGate& gate() const { return gate_; }
+	
+	// Peaks and partial tracks of the last hop, and the inharmonicity of the
+	// partials of the detected fundamental
+	const PeakTracker& peak_tracker() const { return peakTracker_; }
+	float inharmonicity() const { return inharmonicity_; }
+	
+	// Pitch detector in use, e.g. for its cost per hop
+	const PitchDetector& detector() const { return *detector_; }
+	
+	// Polyphonic mode: notes of the last hop, strongest first (none if
+	// the mode is off), and the detector for its cost per hop
+	const std::vector<PolyphonicDetector::Voice>& voices() const { return polyphonicDetector_.voices(); }
+	const PolyphonicDetector& polyphonic_detector() const { return polyphonicDetector_; }
+	
+	// Constant-Q spectrum of the last hop: amplitudes of the octaves of all
+	// levels from the lowest one up (empty if it is off), the kernel, and
+	// the centre frequency of a bin
+	const std::vector<float>& constant_q_spectrum() const { return constantQSpectrum_; }
+	const ConstantQKernel& constant_q_kernel() const { return constantQKernel_; }
+	float constant_q_frequency(float bin) const;
+	
+	// Level the detector was given in the last analysis
+	unsigned int detection_level() const { return detectionLevel_; }
+	
+	// Number of completed analyses since setup
+	unsigned int hop_count() const { return hopCount_; }
+	
+	// Input time at the end of the windows of the last analysis [s]
+	double window_end_time() const {
+		return ((analysedHop_ + 1) * (double)hopSize_ - config_.hopOffset) / sampleRate_;
+	}
+	
+	// Sample rate of a level of the pyramid, and the centre frequency of
+	// a bin of the merged spectrum
+	float level_sample_rate(unsigned int level) const { return sampleRate_ / pyramid_.factor(level); }
+	static float log_bin_frequency(float bin);
+	
+	// Destructor
+	~SpectrumAnalyzer() {}
+	
+private:
+	// Spectra of all levels, merge and detection for one hop
+	void process_fft(const float *windows);
+	
+	// Phase refinement of the partials of the detected fundamental, returns
+	// the refined fundamental
+	float refine_partials(const float *windows, float fundamental);
+	
+	// Level whose octave band holds a frequency, -1 above the highest one
+	int level_of_frequency(float frequency) const;
+	
+	// Audio thread: retarget the tuning bank if requested and run it on
+	// the current chunk
+	void process_tuning();
+	
+	// Info
+	float sampleRate_ = 0;
+	bool setupDone_ = false;
+	
+	// Configuration and the sizes derived from it: phaseLag_ samples
+	// before the FFT window are queued as well for the phase refinement
+	Config config_;
+	unsigned int numLevels_ = 0;
+	unsigned int levelFftSize_ = 0;
+	unsigned int hopSize_ = 0;
+	unsigned int phaseLag_ = 0;
+	unsigned int windowLength_ = 0;
+	
+	// Audio thread: pyramid, one input buffer per level and hand-off to the
+	// worker. The input is collected into chunks first, as the lower levels
+	// only produce a sample every few blocks.
+	std::vector<float> chunk_;
+	unsigned int chunkFrames_ = 0;
+	DecimationPyramid pyramid_;
+	std::vector<CircularBuffer<float>> levelBuffers_;
+	unsigned int hopCounter_ = 0;
+	WindowQueue<float> windowQueue_;
+	std::atomic<unsigned int> droppedWindows_;
+	std::atomic<unsigned int> lateWindows_;
+	
+	// Hop index of every queued window, in the order of the queue (written
+	// before push() and read after get_read_window())
+	std::vector<unsigned int> queuedHops_;
+	unsigned int pushedWindows_ = 0;
+	unsigned int poppedWindows_ = 0;
+	
+	// Audio thread: level and onset gate
+	AnalysisGate gate_;
+	std::atomic<unsigned int> totalHops_;
+	std::atomic<unsigned int> gatedHops_;
+	
+	// Audio thread: tuning bank, running on the lowest rate level that
+	// holds all of its partials
+	TuningBank tuningBank_;
+	float bankTarget_ = 0;
+	unsigned int bankLevel_ = 0;
+	unsigned int lockedHops_ = 0;
+	std::atomic<unsigned int> skippedHops_;
+	
+	// Tuning requests and results, shared between the threads
+	std::atomic<int> tuningMode_;
+	std::atomic<float> requestedTarget_;
+	std::atomic<float> tuningTarget_;
+	std::atomic<float> tuningCents_;
+	std::atomic<bool> tuningLocked_;
+	
+	// Worker thread: FFT and windowed magnitude spectrum of every level
+	Fft fft_;
+	std::vector<SpectrumStage> levelStages_;
+	PeakTracker peakTracker_;
+	PolyphonicDetector polyphonicDetector_;
+	std::unique_ptr<PitchDetector> detector_;
+	PhaseRefiner phaseRefiner_;
+	
+	// Source of every bin of the merged spectrum: the level and the
+	// fractional bin of its spectrum (level -1 if it is out of range)
+	std::vector<int> logBinLevel_;
+	std::vector<float> logBinPosition_;
+	std::vector<float> logSpectrum_;
+	
+	// Constant-Q spectrum, and the index of its first bin on the grid of
+	// config_.constantQBinsPerOctave bins per octave from A0
+	ConstantQKernel constantQKernel_;
+	std::vector<float> constantQSpectrum_;
+	int constantQFirstBin_ = 0;
+	
+	// Results
+	float detectedFreq_ = 0;
+	float refinedPartials_[kRefinedPartials] = {};
+	float fundamentalFreq_ = 0;
+	float midiNoteNumber_ = 0;
+	unsigned int detectionLevel_ = 0;
+	float inharmonicity_ = 0;
+	unsigned int hopCount_ = 0;
+	unsigned int analysedHop_ = 0;
+};
@@ -0,0 +1,99 @@
+/***** SpectrumEncoder.cpp *****/
+/* Class implementation of the compact spectrum transport to the browser
+ * GUI
+ *
+ * ECS7012P - Queen Mary University of London
+ * Final project, Max Tamussino
+ */
+
+#include <cmath>
+#include <cstdint>
+#include <vector>
+#include <libraries/math_neon/math_neon.h>
+#include "SpectrumEncoder.h"
+
+// Select the range and resolution and allocate the frame (NOT REAL-TIME
+// SAFE, use at beginning)
+bool SpectrumEncoder::setup(unsigned int numInputBins, float inputMinFrequency, unsigned int inputBinsPerOctave,
+							float minFrequency, float maxFrequency, unsigned int binsPerOctave,
+							Encoding encoding, float maxFrameRate) {
+	if (binsPerOctave == 0 || inputBinsPerOctave % binsPerOctave != 0) return false;
+	if (minFrequency >= maxFrequency || maxFrameRate <= 0) return false;
+	groupSize_ = inputBinsPerOctave / binsPerOctave;
+
+	// Input bins of the range, the first one aligned to a whole group
+	int first = floorf(log2f(minFrequency / inputMinFrequency) * inputBinsPerOctave);
+	int last = ceilf(log2f(maxFrequency / inputMinFrequency) * inputBinsPerOctave);
+	if (first < 0) first = 0;
+	if (last >= (int)numInputBins) last = numInputBins - 1;
+	if (last < first) return false;
+	firstInputBin_ = first - first % groupSize_;
+	numValues_ = (last - firstInputBin_) / groupSize_ + 1;
+	if ((firstInputBin_ + numValues_ * groupSize_) > numInputBins) numValues_--;
+	if (numValues_ == 0) return false;
+
+	encoding_ = encoding;
+	stepDb_ = encoding == kEncodingInt8 ? kStepDbInt8 : kStepDbInt16;
+	minInterval_ = 1.0 / maxFrameRate;
+	sentAny_ = false;
+	sequence_ = 0;
+
+	// The header only changes in its sequence number. Each value stands
+	// for the centre of its group of input bins.
+	frame_.assign(kHeaderSize + numValues_ * encoding_, 0);
+	float firstFrequency = inputMinFrequency * powf(2.0, (firstInputBin_ + 0.5 * (groupSize_ - 1)) / inputBinsPerOctave);
+	frame_[0] = kVersion;
+	frame_[1] = encoding_;
+	write_u16(4, numValues_);
+	write_u16(6, binsPerOctave);
+	write_u32(8, lroundf(firstFrequency * 1000.0));
+	write_u16(12, (uint16_t)(int16_t)lroundf(kZeroDb * 100.0));
+	write_u16(14, lroundf(stepDb_ * 1000.0));
+	return true;
+}
+
+void SpectrumEncoder::write_u16(unsigned int offset, unsigned int value) {
+	frame_[offset] = value & 0xff;
+	frame_[offset + 1] = (value >> 8) & 0xff;
+}
+
+void SpectrumEncoder::write_u32(unsigned int offset, unsigned long value) {
+	write_u16(offset, value & 0xffff);
+	write_u16(offset + 2, (value >> 16) & 0xffff);
+}
+
+// Rebin by the maximum of each group, so that narrow peaks keep their
+// height, then quantise the dB value of the group
+bool SpectrumEncoder::encode(const float *spectrum, double time) {
+	if (sentAny_ && time >= lastTime_ && time - lastTime_ < minInterval_) return false;
+	sentAny_ = true;
+	lastTime_ = time;
+
+	const float maxCode = encoding_ == kEncodingInt8 ? INT8_MAX : INT16_MAX;
+	const float minCode = encoding_ == kEncodingInt8 ? INT8_MIN : INT16_MIN;
+	const float *input = spectrum + firstInputBin_;
+	char *values = frame_.data() + kHeaderSize;
+	for (unsigned int i = 0; i < numValues_; i++) {
+		float amplitude = 1e-9;
+		for (unsigned int k = 0; k < groupSize_; k++) {
+			if (input[k] > amplitude) amplitude = input[k];
+		}
+		input += groupSize_;
+
+		// 20 log10(a) relative to kZeroDb, in steps
+		float code = (20.0f / (float)M_LN10 * logf_neon(amplitude) - kZeroDb) / stepDb_;
+		if (code > maxCode) code = maxCode;
+		if (code < minCode) code = minCode;
+		int value = lroundf(code);
+		if (encoding_ == kEncodingInt8) {
+			values[i] = (int8_t)value;
+		} else {
+			values[2 * i] = value & 0xff;
+			values[2 * i + 1] = (value >> 8) & 0xff;
+		}
+	}
+
+	write_u16(2, sequence_ & 0xffff);
+	sequence_++;
+	return true;
+}
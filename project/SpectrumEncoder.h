@@ -0,0 +1,92 @@
+/***** SpectrumEncoder.h *****/
+/* Class implementation of the compact spectrum transport to the browser
+ * GUI: the log-frequency spectrum of the analyzer is rebinned to the
+ * resolution and range shown by sketch.js, converted to dB and quantised
+ * to 8 or 16 bit, and packed into a binary frame. Frames are limited to a
+ * maximum rate.
+ *
+ * Frame layout (version 1, all fields little endian):
+ *   byte  0     version (1)
+ *   byte  1     bytes per value (1: int8, 2: int16)
+ *   bytes 2-3   frame sequence number (uint16, wraps around)
+ *   bytes 4-5   number of values (uint16)
+ *   bytes 6-7   bins per octave (uint16)
+ *   bytes 8-11  frequency of the first value in mHz (uint32)
+ *   bytes 12-13 dB of the value 0 in 0.01 dB (int16)
+ *   bytes 14-15 dB per step of the values in 0.001 dB (uint16)
+ *   bytes 16-   values (int8 or int16)
+ * The decoder in sketch.js must be updated together with this layout.
+ *
+ * ECS7012P - Queen Mary University of London
+ * Final project, Max Tamussino
+ */
+
+#pragma once
+#include <vector>
+
+class SpectrumEncoder {
+public:
+	// Frame format
+	static const int kVersion = 1;
+	static const int kHeaderSize = 16;
+
+	// Quantisation of the dB values: 0.5 dB steps from -124 to +3.5 dBFS,
+	// or 0.01 dB steps
+	enum Encoding { kEncodingInt8 = 1, kEncodingInt16 = 2 };
+	static constexpr float kZeroDb = -60;
+	static constexpr float kStepDbInt8 = 0.5;
+	static constexpr float kStepDbInt16 = 0.01;
+
+	// Constructor
+	SpectrumEncoder() {}
+
+	// Setup (NOT REAL-TIME SAFE). The input is a log-frequency amplitude
+	// spectrum starting at inputMinFrequency with inputBinsPerOctave bins
+	// per octave; binsPerOctave must divide the latter. Only the range
+	// from minFrequency to maxFrequency is sent, and at most maxFrameRate
+	// frames per second.
+	bool setup(unsigned int numInputBins, float inputMinFrequency, unsigned int inputBinsPerOctave,
+			   float minFrequency, float maxFrequency, unsigned int binsPerOctave,
+			   Encoding encoding = kEncodingInt8, float maxFrameRate = 10);
+
+	// Encode a spectrum taken at the given time [s] into the frame. Returns
+	// false (and leaves the frame as it is) if the last frame is more
+	// recent than the rate limit allows. A time before the last frame
+	// counts as a new time base, as after reset().
+	bool encode(const float *spectrum, double time);
+
+	// Restart the rate limit, so that the next spectrum is sent whatever
+	// its time (for a new analyzer, whose time starts at 0 again)
+	void reset() { sentAny_ = false; }
+
+	// Last frame
+	const std::vector<char>& frame() const { return frame_; }
+	unsigned int num_values() const { return numValues_; }
+	unsigned int frames_sent() const { return sequence_; }
+
+	// Destructor
+	~SpectrumEncoder() {}
+
+private:
+	// Write little endian fields of the header
+	void write_u16(unsigned int offset, unsigned int value);
+	void write_u32(unsigned int offset, unsigned long value);
+
+	// Rebinning: every output value is the maximum of groupSize_ input bins
+	unsigned int firstInputBin_ = 0;
+	unsigned int groupSize_ = 1;
+	unsigned int numValues_ = 0;
+
+	// Quantisation
+	Encoding encoding_ = kEncodingInt8;
+	float stepDb_ = kStepDbInt8;
+
+	// Rate limit
+	double minInterval_ = 0;
+	double lastTime_ = 0;
+	bool sentAny_ = false;
+
+	// Frame being built
+	std::vector<char> frame_;
+	unsigned int sequence_ = 0;
+};
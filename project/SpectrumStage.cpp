@@ -0,0 +1,161 @@
+/***** SpectrumStage.cpp *****/
+/* Class implementation of the windowed spectrum stage
+ *
+ * ECS7012P - Queen Mary University of London
+ * Final project, Max Tamussino
+ */
+
+#include <cmath>
+#include <cstring>
+#include <vector>
+#include "SpectrumStage.h"
+#include "Simd.h"
+
+// Calculate the window table (NOT REAL-TIME SAFE, use at beginning)
+bool SpectrumStage::setup(unsigned int fftSize, Window window, Scale scale) {
+	// The bins are processed four at a time
+	if (!Fft::isPowerOfTwo(fftSize) || fftSize < 8) return false;
+	fftSize_ = fftSize;
+	window_ = window;
+	scale_ = scale;
+	
+	// Periodic windows as sums of cosines
+	float a0 = 1, a1 = 0, a2 = 0, a3 = 0;
+	switch (window) {
+		case kWindowRectangular: break;
+		case kWindowHann: a0 = 0.5; a1 = 0.5; break;
+		case kWindowHamming: a0 = 0.54; a1 = 0.46; break;
+		case kWindowBlackman: a0 = 0.42; a1 = 0.5; a2 = 0.08; break;
+		case kWindowBlackmanHarris: a0 = 0.35875; a1 = 0.48829; a2 = 0.14128; a3 = 0.01168; break;
+	}
+	windowTable_.resize(fftSize);
+	double sum = 0;
+	for (unsigned int n = 0; n < fftSize; n++) {
+		double x = 2.0 * M_PI * n / fftSize;
+		windowTable_[n] = a0 - a1 * cos(x) + a2 * cos(2 * x) - a3 * cos(3 * x);
+		sum += windowTable_[n];
+	}
+	
+	// Normalise the coherent gain to the one of the rectangular window
+	for (unsigned int n = 0; n < fftSize; n++) windowTable_[n] *= fftSize / sum;
+	
+	spectrum_.resize(fftSize / 2);
+	bins_.assign(fftSize, 0);
+	peakIndex_ = 0;
+	peakValue_ = 0;
+	return true;
+}
+
+// One pass over the interleaved bins: power, maximum and conversion to the
+// output scale, four bins at a time. The scale is a template parameter so
+// that the loop contains no branches. ARMv7 NEON has no vector square root,
+// so the magnitude is taken with the reciprocal square root estimate
+// (sqrt4()). A nonzero N fixes the number of bins at compile time for the
+// FFT sizes used most.
+template <SpectrumStage::Scale S, unsigned int N>
+static unsigned int spectrum_pass(const float *bins, float *out, unsigned int numBins, float& peak) {
+	if (N != 0) numBins = N;
+	float4 best = splat4(-1.0f);
+	int4 bestIndex = splat4(0);
+	int4 index = {0, 1, 2, 3};
+	
+	for (unsigned int k = 0; k < numBins; k += 4) {
+		float4 re, im;
+		deinterleave4(load4(bins + 2 * k), load4(bins + 2 * k + 4), re, im);
+		float4 power = re * re + im * im;
+		
+		// Running maximum per lane
+		int4 greater = power > best;
+		best = select4(greater, power, best);
+		bestIndex = select4(greater, index, bestIndex);
+		index += 4;
+		
+		if (S == SpectrumStage::kScalePower) {
+			store4(out + k, power);
+		} else if (S == SpectrumStage::kScaleDecibels) {
+			store4(out + k, log4(max4(power, splat4(1e-20f))) * (float)(10.0 / M_LN10));
+		} else {
+			store4(out + k, sqrt4(power));
+		}
+	}
+	
+	int32_t peakIndex;
+	peak = horizontal_max4(best, bestIndex, peakIndex);
+	return peakIndex;
+}
+
+// Pass over the bins in the output scale of the stage
+template <unsigned int N>
+static unsigned int scaled_pass(SpectrumStage::Scale scale, const float *bins, float *out, unsigned int numBins,
+								float& peak) {
+	switch (scale) {
+		case SpectrumStage::kScalePower:
+			return spectrum_pass<SpectrumStage::kScalePower, N>(bins, out, numBins, peak);
+		case SpectrumStage::kScaleDecibels:
+			return spectrum_pass<SpectrumStage::kScaleDecibels, N>(bins, out, numBins, peak);
+		default:
+			return spectrum_pass<SpectrumStage::kScaleMagnitude, N>(bins, out, numBins, peak);
+	}
+}
+
+// Windowed copy of N samples (fftSize if N is 0)
+template <unsigned int N>
+static void windowed_copy(float *out, const float *input, const float *windowTable, unsigned int fftSize) {
+	if (N != 0) fftSize = N;
+	for (unsigned int n = 0; n < fftSize; n++) {
+		out[n] = input[n] * windowTable[n];
+	}
+}
+
+// Window, transform and compute the spectrum with its maximum
+void SpectrumStage::process(Fft& fft, const float *input) {
+	window_input(fft, input);
+	fft.fft();
+	compute_spectrum(fft);
+}
+
+// Apply the window while copying the input into the FFT buffer. The hot
+// FFT sizes have their own loops with a constant trip count.
+void SpectrumStage::window_input(Fft& fft, const float *input) {
+	float *timeDomain = &fft.td(0);
+	const float *windowTable = windowTable_.data();
+	switch (fftSize_) {
+		case 256: windowed_copy<256>(timeDomain, input, windowTable, fftSize_); break;
+		case 512: windowed_copy<512>(timeDomain, input, windowTable, fftSize_); break;
+		case 1024: windowed_copy<1024>(timeDomain, input, windowTable, fftSize_); break;
+		default: windowed_copy<0>(timeDomain, input, windowTable, fftSize_); break;
+	}
+}
+
+// Spectrum and maximum of the transformed signal
+void SpectrumStage::compute_spectrum(Fft& fft) {
+	// The bins are stored as interleaved real and imaginary parts
+	const float *bins = &fft.fdr(0);
+	float *out = spectrum_.data();
+	float peakPower;
+	switch (fftSize_) {
+		case 256: peakIndex_ = scaled_pass<128>(scale_, bins, out, fftSize_ / 2, peakPower); break;
+		case 512: peakIndex_ = scaled_pass<256>(scale_, bins, out, fftSize_ / 2, peakPower); break;
+		case 1024: peakIndex_ = scaled_pass<512>(scale_, bins, out, fftSize_ / 2, peakPower); break;
+		default: peakIndex_ = scaled_pass<0>(scale_, bins, out, fftSize_ / 2, peakPower); break;
+	}
+	peakValue_ = spectrum_[peakIndex_];
+	memcpy(bins_.data(), bins, fftSize_ * sizeof(float));
+}
+
+// Window names for command lines
+static const char *kWindowNames[] = {"rectangular", "hann", "hamming", "blackman", "blackman-harris"};
+
+const char* SpectrumStage::window_name(Window window) {
+	return kWindowNames[window];
+}
+
+bool SpectrumStage::window_from_name(const char *name, Window& window) {
+	for (unsigned int n = 0; n < sizeof(kWindowNames) / sizeof(kWindowNames[0]); n++) {
+		if (!strcmp(name, kWindowNames[n])) {
+			window = (Window)n;
+			return true;
+		}
+	}
+	return false;
+}
@@ -0,0 +1,72 @@
+/***** SpectrumStage.h *****/
+/* Class implementation of the windowed spectrum stage: applies a
+ * precomputed window while filling the FFT input, runs the FFT and then
+ * computes magnitude, power or dB of all bins together with the global
+ * maximum in a single vectorised pass into a preallocated buffer
+ *
+ * ECS7012P - Queen Mary University of London
+ * Final project, Max Tamussino
+ */
+
+#pragma once
+#include <vector>
+#include <libraries/Fft/Fft.h>
+
+class SpectrumStage {
+public:
+	// Window functions
+	enum Window { kWindowRectangular, kWindowHann, kWindowHamming, kWindowBlackman, kWindowBlackmanHarris };
+	
+	// Output scale of the spectrum
+	enum Scale { kScaleMagnitude, kScalePower, kScaleDecibels };
+	
+	// Constructor
+	SpectrumStage() {}
+	
+	// Setup (NOT REAL-TIME SAFE), calculates the window table
+	bool setup(unsigned int fftSize, Window window = kWindowHann, Scale scale = kScaleMagnitude);
+	
+	// Window the input (fftSize samples) into the FFT, transform it and
+	// calculate the spectrum of bins 0 to fftSize/2-1 and its maximum
+	void process(Fft& fft, const float *input);
+	
+	// The steps of process(): windowed copy into the FFT input, and the
+	// pass over the bins of the transformed signal
+	void window_input(Fft& fft, const float *input);
+	void compute_spectrum(Fft& fft);
+	
+	// Results, and a copy of the complex bins of the transform
+	// (interleaved, fftSize/2 bins) for the phase refinement
+	const std::vector<float>& spectrum() const { return spectrum_; }
+	const std::vector<float>& bins() const { return bins_; }
+	unsigned int peak_index() const { return peakIndex_; }
+	float peak_value() const { return peakValue_; }
+	
+	// Settings
+	Window window() const { return window_; }
+	Scale scale() const { return scale_; }
+	const std::vector<float>& window_table() const { return windowTable_; }
+	
+	// Window names for command lines, e.g. "hann" or "blackman-harris"
+	static const char* window_name(Window window);
+	static bool window_from_name(const char *name, Window& window);
+	
+	// Destructor
+	~SpectrumStage() {}
+	
+private:
+	// Settings
+	unsigned int fftSize_ = 0;
+	Window window_ = kWindowHann;
+	Scale scale_ = kScaleMagnitude;
+	
+	// Window, normalised to the coherent gain of the rectangular window so
+	// that the peak magnitude of a sinusoid does not depend on the window
+	std::vector<float> windowTable_;
+	
+	// Results
+	std::vector<float> spectrum_;
+	std::vector<float> bins_;
+	unsigned int peakIndex_ = 0;
+	float peakValue_ = 0;
+};
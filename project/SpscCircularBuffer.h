@@ -0,0 +1,108 @@
+/***** SpscCircularBuffer.h *****/
+/* Header-only single-producer/single-consumer ring on the storage of
+ * FixedCircularBuffer (FixedCircularStorage, which has no index of its
+ * own), to stream samples or results from the audio thread to a worker
+ * (or back) without locks. One thread pushes and one thread pops, each
+ * may be the audio thread.
+ *
+ * The write and read indices count up and are published with release
+ * stores and read with acquire loads, so the elements copied before an
+ * index moves are visible to the other thread once it sees the index.
+ * Each index sits on a cache line of its own, together with the copy of
+ * the other index its thread last read: a thread only loads the other
+ * index again when the copy says the ring is full (or empty), so the two
+ * cores do not pass the lines back and forth on every call.
+ *
+ * A push that does not fit stores what fits and drops the rest; the
+ * dropped elements are counted.
+ *
+ * ECS7012P - Queen Mary University of London
+ * Final project, Max Tamussino
+ */
+
+#pragma once
+#include <atomic>
+#include <cstdlib>
+#include <new>
+#include "FixedCircularBuffer.h"
+
+template <typename T, unsigned int Capacity>
+class SpscCircularBuffer : protected FixedCircularStorage<T, Capacity> {
+	typedef FixedCircularStorage<T, Capacity> Base;
+
+public:
+	static const unsigned int kCacheLine = 64;	// Bytes kept between the indices
+	using Base::kCapacity;
+	using Base::capacity;
+
+	// Constructor
+	SpscCircularBuffer() {}
+
+	// Allocation aligned to the cache lines of the indices (plain new only
+	// guarantees 16 bytes before C++17)
+	static void* operator new(std::size_t size) {
+		void *pointer = nullptr;
+		if (posix_memalign(&pointer, kCacheLine, size) != 0) throw std::bad_alloc();
+		return pointer;
+	}
+	static void operator delete(void *pointer) { free(pointer); }
+
+	// Producer: store up to N elements, oldest first. Returns the number
+	// stored, the others are dropped.
+	unsigned int push(const T* elements, unsigned int N) {
+		const unsigned int write = writeIndex_.load(std::memory_order_relaxed);
+		if (write - producerReadIndex_ + N > kCapacity) {
+			producerReadIndex_ = readIndex_.load(std::memory_order_acquire);
+			const unsigned int space = kCapacity - (write - producerReadIndex_);
+			if (N > space) {
+				dropped_.store(dropped_.load(std::memory_order_relaxed) + N - space, std::memory_order_relaxed);
+				overflows_.store(overflows_.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+				N = space;
+			}
+		}
+		this->copy_in(write, elements, N);
+		writeIndex_.store(write + N, std::memory_order_release);
+		return N;
+	}
+	bool push(const T& element) { return push(&element, 1) == 1; }
+
+	// Consumer: take up to N elements, oldest first. Returns the number
+	// taken.
+	unsigned int pop(T* out, unsigned int N) {
+		const unsigned int read = readIndex_.load(std::memory_order_relaxed);
+		if (consumerWriteIndex_ - read < N) {
+			consumerWriteIndex_ = writeIndex_.load(std::memory_order_acquire);
+			const unsigned int available = consumerWriteIndex_ - read;
+			if (N > available) N = available;
+		}
+		this->copy_out(read, out, N);
+		readIndex_.store(read + N, std::memory_order_release);
+		return N;
+	}
+	bool pop(T& element) { return pop(&element, 1) == 1; }
+
+	// Consumer: elements ready to pop. Producer: room for elements.
+	unsigned int available() const {
+		return writeIndex_.load(std::memory_order_acquire) - readIndex_.load(std::memory_order_relaxed);
+	}
+	unsigned int space() const {
+		return kCapacity - (writeIndex_.load(std::memory_order_relaxed) - readIndex_.load(std::memory_order_acquire));
+	}
+
+	// Elements dropped because the ring was full, and pushes that dropped
+	// any (may be read by either thread)
+	unsigned int dropped() const { return dropped_.load(std::memory_order_relaxed); }
+	unsigned int overflows() const { return overflows_.load(std::memory_order_relaxed); }
+
+private:
+	// Producer line: its index, the read index it last saw and the counters
+	alignas(kCacheLine) std::atomic<unsigned int> writeIndex_{0};
+	unsigned int producerReadIndex_ = 0;
+	std::atomic<unsigned int> dropped_{0};
+	std::atomic<unsigned int> overflows_{0};
+
+	// Consumer line: its index and the write index it last saw
+	alignas(kCacheLine) std::atomic<unsigned int> readIndex_{0};
+	unsigned int consumerWriteIndex_ = 0;
+	char padding_[kCacheLine - sizeof(std::atomic<unsigned int>) - sizeof(unsigned int)];
+};
@@ -0,0 +1,97 @@
+/***** StageTiming.cpp *****/
+/* Per-stage timing of the analysis pipeline
+ *
+ * ECS7012P - Queen Mary University of London
+ * Final project, Max Tamussino
+ */
+
+#include <Bela.h>
+#include <cstdint>
+#include "StageTiming.h"
+
+// One histogram per stage
+static StageHistogram gStageHistograms[kNumTimingStages];
+
+static const char *kStageNames[kNumTimingStages] = {
+	"render", "decimation", "tuning-bank", "gate", "window-copy", "fft", "spectrum", "peaks", "merge", "constant-q", "detection",
+	"polyphonic", "gui-send"
+};
+
+// Bucket of a duration: below 4 ns one per nanosecond, then the position
+// of the highest bit and the two bits below it
+static unsigned int bucket_of(uint64_t ns) {
+	if (ns < 4) return ns;
+	unsigned int msb = 63 - __builtin_clzll(ns);
+	unsigned int bucket = (msb - 1) * StageHistogram::kBucketsPerOctave + ((ns >> (msb - 2)) & 3);
+	return bucket < StageHistogram::kNumBuckets ? bucket : StageHistogram::kNumBuckets - 1;
+}
+
+// Upper end of a bucket in nanoseconds
+static uint64_t bucket_upper_ns(unsigned int bucket) {
+	if (bucket < 4) return bucket + 1;
+	unsigned int msb = bucket / StageHistogram::kBucketsPerOctave + 1;
+	return (uint64_t)(5 + bucket % StageHistogram::kBucketsPerOctave) << (msb - 2);
+}
+
+// Only the timing thread of the stage writes, so plain loads and stores
+// suffice for min and max
+void StageHistogram::record(uint64_t ns) {
+	buckets_[bucket_of(ns)].fetch_add(1, std::memory_order_relaxed);
+	count_.fetch_add(1, std::memory_order_relaxed);
+	sumNs_.fetch_add(ns, std::memory_order_relaxed);
+	if (ns < minNs_.load(std::memory_order_relaxed)) minNs_.store(ns, std::memory_order_relaxed);
+	if (ns > maxNs_.load(std::memory_order_relaxed)) maxNs_.store(ns, std::memory_order_relaxed);
+}
+
+// The p99 is the upper end of the bucket holding it, so it is exact to a
+// quarter octave
+StageHistogram::Summary StageHistogram::summary() const {
+	Summary summary = {0, 0, 0, 0, 0};
+	summary.count = count_.load(std::memory_order_relaxed);
+	if (summary.count == 0) return summary;
+	summary.minUs = minNs_.load(std::memory_order_relaxed) / 1000.0;
+	summary.maxUs = maxNs_.load(std::memory_order_relaxed) / 1000.0;
+	summary.meanUs = sumNs_.load(std::memory_order_relaxed) / 1000.0 / summary.count;
+
+	uint64_t rank = summary.count - summary.count / 100, seen = 0;
+	for (unsigned int bucket = 0; bucket < kNumBuckets; bucket++) {
+		seen += buckets_[bucket].load(std::memory_order_relaxed);
+		if (seen >= rank) {
+			summary.p99Us = bucket_upper_ns(bucket) / 1000.0;
+			break;
+		}
+	}
+	if (summary.p99Us > summary.maxUs) summary.p99Us = summary.maxUs;
+	return summary;
+}
+
+void StageHistogram::reset() {
+	for (unsigned int bucket = 0; bucket < kNumBuckets; bucket++) buckets_[bucket].store(0);
+	count_.store(0);
+	sumNs_.store(0);
+	minNs_.store(UINT64_MAX);
+	maxNs_.store(0);
+}
+
+StageHistogram& stage_histogram(TimingStage stage) {
+	return gStageHistograms[stage];
+}
+
+const char* stage_name(TimingStage stage) {
+	return kStageNames[stage];
+}
+
+// Table of all stages which have been timed at least once
+void print_stage_timing() {
+	rt_printf("%-12s %10s %10s %10s %10s %10s\n", "stage", "count", "min [us]", "mean [us]", "p99 [us]", "max [us]");
+	for (int stage = 0; stage < kNumTimingStages; stage++) {
+		StageHistogram::Summary summary = gStageHistograms[stage].summary();
+		if (summary.count == 0) continue;
+		rt_printf("%-12s %10llu %10.2f %10.2f %10.2f %10.2f\n", kStageNames[stage], (unsigned long long)summary.count,
+			summary.minUs, summary.meanUs, summary.p99Us, summary.maxUs);
+	}
+}
+
+void reset_stage_timing() {
+	for (int stage = 0; stage < kNumTimingStages; stage++) gStageHistograms[stage].reset();
+}
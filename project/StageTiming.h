@@ -0,0 +1,113 @@
+/***** StageTiming.h *****/
+/* Per-stage timing of the analysis pipeline: a scoped timer reads
+ * CLOCK_MONOTONIC_RAW at the start and the end of a stage and adds the
+ * duration to a lock-free histogram of that stage, from which any thread
+ * can read min/mean/p99/max. Every stage is timed from one thread only.
+ *
+ * The timers are only compiled in when STAGE_TIMING is set to 1 (e.g. with
+ * -DSTAGE_TIMING=1), otherwise STAGE_TIMER() expands to nothing.
+ *
+ * ECS7012P - Queen Mary University of London
+ * Final project, Max Tamussino
+ */
+
+#pragma once
+#include <atomic>
+#include <cstdint>
+#include <time.h>
+
+#ifndef STAGE_TIMING
+#define STAGE_TIMING 0
+#endif
+
+// Stages of the pipeline
+enum TimingStage {
+	kStageRender,	// Whole render() callback
+	kStageDecimation,	// Pyramid and level buffers
+	kStageTuningBank,	// Sliding DFT bins
+	kStageGate,	// Band energies and onsets of the gate
+	kStageWindowCopy,	// Windows of all levels into the queue
+	kStageFft,	// Windowing and FFT of one level
+	kStageSpectrum,	// Magnitude and maximum of one level
+	kStagePeaks,	// Peaks of all levels and partial tracks
+	kStageMerge,	// Log-frequency spectrum
+	kStageConstantQ,	// Constant-Q spectrum from the bins of all levels
+	kStageDetection,	// Pitch detector and MIDI note
+	kStagePolyphonic,	// Notes of the polyphonic mode
+	kStageGuiSend,	// Spectrum frame and buffers to the GUI
+	kNumTimingStages
+};
+
+// Histogram of durations with four buckets per octave of nanoseconds
+class StageHistogram {
+public:
+	static const int kBucketsPerOctave = 4;
+	static const int kNumBuckets = 32 * kBucketsPerOctave;
+
+	// Summary in microseconds
+	struct Summary {
+		uint64_t count;
+		double minUs, meanUs, p99Us, maxUs;
+	};
+
+	// Constructor
+	StageHistogram() { reset(); }
+
+	// Add one duration (real-time safe, one thread only)
+	void record(uint64_t ns);
+
+	// Read the histogram (any thread), min/mean/p99/max are 0 if empty
+	Summary summary() const;
+
+	// Clear the histogram (not while the stage is being timed)
+	void reset();
+
+	// Destructor
+	~StageHistogram() {}
+
+private:
+	std::atomic<uint32_t> buckets_[kNumBuckets];
+	std::atomic<uint64_t> count_;
+	std::atomic<uint64_t> sumNs_;
+	std::atomic<uint64_t> minNs_;
+	std::atomic<uint64_t> maxNs_;
+};
+
+// Histogram and name of a stage
+StageHistogram& stage_histogram(TimingStage stage);
+const char* stage_name(TimingStage stage);
+
+// Print all stages which have been timed (NOT REAL-TIME SAFE)
+void print_stage_timing();
+
+// Clear all histograms
+void reset_stage_timing();
+
+// Time from construction to destruction
+class ScopedStageTimer {
+public:
+	// Constructor
+	explicit ScopedStageTimer(TimingStage stage) : stage_(stage), startNs_(now_ns()) {}
+
+	// Destructor
+	~ScopedStageTimer() { stage_histogram(stage_).record(now_ns() - startNs_); }
+
+	static uint64_t now_ns() {
+		timespec time;
+		clock_gettime(CLOCK_MONOTONIC_RAW, &time);
+		return time.tv_sec * 1000000000ull + time.tv_nsec;
+	}
+
+private:
+	TimingStage stage_;
+	uint64_t startNs_;
+};
+
+// Time the rest of the enclosing scope as the given stage
+#define STAGE_TIMER_NAME2(line) stageTimer##line
+#define STAGE_TIMER_NAME(line) STAGE_TIMER_NAME2(line)
+#if STAGE_TIMING
+#define STAGE_TIMER(stage) ScopedStageTimer STAGE_TIMER_NAME(__LINE__)(stage)
+#else
+#define STAGE_TIMER(stage) do {} while (0)
+#endif
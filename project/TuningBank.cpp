@@ -0,0 +1,128 @@
+/***** TuningBank.cpp *****/
+/* Class implementation of a bank of sliding DFT bins tracking a known
+ * target note
+ *
+ * ECS7012P - Queen Mary University of London
+ * Final project, Max Tamussino
+ */
+
+#include <algorithm>
+#include <cmath>
+#include <vector>
+#include <libraries/math_neon/math_neon.h>
+#include "TuningBank.h"
+
+// Allocate the input history (NOT REAL-TIME SAFE, use at beginning)
+void TuningBank::setup() {
+	history_.assign(kMaxWindowLength, 0);
+	target_ = 0;
+}
+
+// The window is a whole number of samples close to kPeriods periods of the
+// target, the bins sit on multiples of kPeriods, so their frequencies are
+// close to (but not exactly) the target and its partials
+bool TuningBank::set_target(float frequency, float sampleRate, unsigned int numPartials) {
+	if (frequency <= 0) {
+		target_ = 0;
+		return true;
+	}
+	
+	unsigned int windowLength = lroundf(kPeriods * sampleRate / frequency);
+	if (windowLength > kMaxWindowLength || windowLength < 2 * kPeriods) return false;
+	if (numPartials > kMaxPartials) numPartials = kMaxPartials;
+	if (numPartials < 1) numPartials = 1;
+	
+	target_ = frequency;
+	sampleRate_ = sampleRate;
+	windowLength_ = windowLength;
+	numPartials_ = numPartials;
+	dampingN_ = powf(kDamping, windowLength);
+	numBins_ = 3 * numPartials_;
+	for (unsigned int h = 0; h < numPartials_; h++) {
+		Partial& partial = partials_[h];
+		partial.omega = 2.0 * M_PI * kPeriods * (h + 1) / windowLength;
+		partial.lastRe = partial.lastIm = 0;
+		for (int k = 0; k < 3; k++) {
+			Bin& bin = bins_[3 * h + k];
+			float omega = 2.0 * M_PI * (kPeriods * (h + 1) + k - 1) / windowLength;
+			bin.rotationRe = kDamping * cosf_neon(omega);
+			bin.rotationIm = kDamping * sinf_neon(omega);
+			bin.re = bin.im = 0;
+		}
+	}
+	
+	// Start from an empty window
+	std::fill(history_.begin(), history_.begin() + windowLength_, 0);
+	historyPointer_ = 0;
+	samplesSinceEstimate_ = 0;
+	samplesSinceTarget_ = 0;
+	frequency_ = cents_ = amplitude_ = 0;
+	return true;
+}
+
+// Sliding DFT update of every bin for every sample
+void TuningBank::process(const float *input, unsigned int frames) {
+	if (target_ <= 0) return;
+	
+	for (unsigned int n = 0; n < frames; n++) {
+		float newest = input[n];
+		float oldest = history_[historyPointer_];
+		history_[historyPointer_] = newest;
+		if (++historyPointer_ == windowLength_) historyPointer_ = 0;
+		
+		float difference = newest - dampingN_ * oldest;
+		for (unsigned int k = 0; k < numBins_; k++) {
+			Bin& bin = bins_[k];
+			float re = bin.re * bin.rotationRe - bin.im * bin.rotationIm + difference;
+			float im = bin.re * bin.rotationIm + bin.im * bin.rotationRe;
+			bin.re = re;
+			bin.im = im;
+		}
+	}
+	
+	samplesSinceEstimate_ += frames;
+	if (samplesSinceTarget_ < windowLength_) samplesSinceTarget_ += frames;
+	update_estimate();
+}
+
+// The phase of a bin advances by the angular frequency of the sinusoid in
+// it. Its difference to the advance of the bin frequency itself is small,
+// so it does not wrap over a block. The partials are combined weighted by
+// their power.
+void TuningBank::update_estimate() {
+	if (samplesSinceEstimate_ == 0) return;
+	const float samples = samplesSinceEstimate_;
+	
+	float weightedFrequency = 0, totalWeight = 0;
+	for (unsigned int h = 0; h < numPartials_; h++) {
+		Partial& partial = partials_[h];
+		
+		// Hann window in the frequency domain
+		const Bin *bin = &bins_[3 * h];
+		float re = 0.5f * bin[1].re - 0.25f * (bin[0].re + bin[2].re);
+		float im = 0.5f * bin[1].im - 0.25f * (bin[0].im + bin[2].im);
+		
+		// X(n) conj(X(n-D)) e^(-jwD)
+		float advance = partial.omega * samples;
+		float c = cosf_neon(advance), s = sinf_neon(advance);
+		float pr = re * partial.lastRe + im * partial.lastIm;
+		float pi = im * partial.lastRe - re * partial.lastIm;
+		float deviation = atan2f_neon(pi * c - pr * s, pr * c + pi * s) / samples;
+		
+		float weight = re * re + im * im;
+		weightedFrequency += weight * (partial.omega + deviation) / (h + 1);
+		totalWeight += weight;
+		
+		partial.lastRe = re;
+		partial.lastIm = im;
+	}
+	samplesSinceEstimate_ = 0;
+	
+	if (totalWeight <= 0) {
+		frequency_ = cents_ = amplitude_ = 0;
+		return;
+	}
+	frequency_ = weightedFrequency / totalWeight * sampleRate_ / (2.0 * M_PI);
+	cents_ = 1200.0 / M_LN2 * logf_neon(frequency_ / target_);
+	amplitude_ = 4.0 * sqrtf_neon(totalWeight) / windowLength_;
+}
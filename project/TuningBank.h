@@ -0,0 +1,94 @@
+/***** TuningBank.h *****/
+/* Class implementation of a bank of sliding DFT bins tracking a known
+ * target note: one bin on the fundamental and one on each of the first
+ * partials. The bins are updated with every sample, and the deviation of
+ * the played note from the target is taken from the phase advance of the
+ * bins. This is far cheaper than an FFT per hop and reacts within one
+ * window of a few periods of the note.
+ *
+ * The bins use the damped recursion of the sliding DFT
+ *   X(n) = r e^(jw) X(n-1) + x(n) - r^N x(n-N),
+ * which stays stable in float arithmetic. Each partial is read through a
+ * Hann window, formed from its bin and the two neighbouring ones, so that
+ * the other partials do not leak into it.
+ *
+ * ECS7012P - Queen Mary University of London
+ * Final project, Max Tamussino
+ */
+
+#pragma once
+#include <vector>
+
+class TuningBank {
+public:
+	// Bank parameters
+	static const int kMaxPartials = 4;	// Fundamental and overtones tracked
+	static const int kPeriods = 16;	// Window length in periods of the target
+	static const int kMaxWindowLength = 512;	// Longest window in samples
+	static constexpr float kDamping = 0.99999;	// r of the recursion
+	
+	// Constructor
+	TuningBank() {}
+	
+	// Setup (NOT REAL-TIME SAFE), allocates the input history
+	void setup();
+	
+	// Select the target frequency at the given sample rate, with the number
+	// of partials to track (real-time safe). Returns false if the window
+	// would be longer than kMaxWindowLength; a frequency of 0 stops the bank.
+	bool set_target(float frequency, float sampleRate, unsigned int numPartials);
+	
+	// Update the bins with a block of samples, then the estimate
+	void process(const float *input, unsigned int frames);
+	
+	// Results of the last block, the amplitude being that of all tracked
+	// partials together. They are only meaningful once a whole window has
+	// been seen since the target was set.
+	bool active() const { return target_ > 0; }
+	bool settled() const { return active() && samplesSinceTarget_ >= windowLength_; }
+	float target() const { return target_; }
+	float frequency() const { return frequency_; }
+	float cents() const { return cents_; }
+	float amplitude() const { return amplitude_; }
+	
+	// Destructor
+	~TuningBank() {}
+	
+private:
+	// Estimate the frequency from the phase advance of the bins
+	void update_estimate();
+	
+	// One bin: rotation and state
+	struct Bin {
+		float rotationRe, rotationIm;
+		float re, im;
+	};
+	
+	// One partial: angular frequency of its centre bin and the windowed
+	// value at the last estimate
+	struct Partial {
+		float omega;
+		float lastRe, lastIm;
+	};
+	
+	// Settings
+	float target_ = 0;
+	float sampleRate_ = 0;
+	unsigned int windowLength_ = 0;
+	unsigned int numPartials_ = 0;
+	float dampingN_ = 0;	// r^N
+	unsigned int numBins_ = 0;
+	Bin bins_[3 * kMaxPartials];	// Bins below, on and above each partial
+	Partial partials_[kMaxPartials];
+	
+	// Input history of one window
+	std::vector<float> history_;
+	unsigned int historyPointer_ = 0;
+	unsigned int samplesSinceEstimate_ = 0;
+	unsigned int samplesSinceTarget_ = 0;
+	
+	// Results
+	float frequency_ = 0;
+	float cents_ = 0;
+	float amplitude_ = 0;
+};
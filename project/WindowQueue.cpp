@@ -0,0 +1,73 @@
+/***** WindowQueue.cpp *****/
+/* Class implementation of a wait-free single-producer/single-consumer
+ * queue of fixed-size sample windows
+ *
+ * ECS7012P - Queen Mary University of London
+ * Final project, Max Tamussino
+ */
+
+#include <vector>
+#include "WindowQueue.h"
+
+// Constructor just setting the sizes
+template <typename T>
+WindowQueue<T>::WindowQueue(unsigned int _numWindows, unsigned int _windowLength) :
+	numWindows_(_numWindows), windowLength_(_windowLength), writeCount_(0), readCount_(0) {
+	// Empty
+}
+
+// Allocate all windows (NOT REAL-TIME SAFE, use at beginning)
+template <typename T>
+void WindowQueue<T>::setup() {
+	buffer_.resize(numWindows_ * windowLength_);
+	writeCount_.store(0);
+	readCount_.store(0);
+}
+
+// Change the sizes and allocate (NOT REAL-TIME SAFE, use at beginning)
+template <typename T>
+void WindowQueue<T>::setup(unsigned int _numWindows, unsigned int _windowLength) {
+	numWindows_ = _numWindows;
+	windowLength_ = _windowLength;
+	setup();
+}
+
+// Returns the window to be filled next, or nullptr if all windows are in use.
+// The counters only grow and their difference is the fill level, which also
+// stays correct when they wrap around.
+template <typename T>
+T* WindowQueue<T>::get_write_window() {
+	unsigned int write = writeCount_.load(std::memory_order_relaxed);
+	unsigned int read = readCount_.load(std::memory_order_acquire);
+	if (write - read >= numWindows_) return nullptr;
+	return &buffer_[(write % numWindows_) * windowLength_];
+}
+
+// Publish the window returned by get_write_window()
+template <typename T>
+void WindowQueue<T>::push() {
+	writeCount_.store(writeCount_.load(std::memory_order_relaxed) + 1, std::memory_order_release);
+}
+
+// Returns the oldest published window, or nullptr if there is none
+template <typename T>
+const T* WindowQueue<T>::get_read_window() {
+	unsigned int read = readCount_.load(std::memory_order_relaxed);
+	unsigned int write = writeCount_.load(std::memory_order_acquire);
+	if (write == read) return nullptr;
+	return &buffer_[(read % numWindows_) * windowLength_];
+}
+
+// Release the window returned by get_read_window()
+template <typename T>
+void WindowQueue<T>::pop() {
+	readCount_.store(readCount_.load(std::memory_order_relaxed) + 1, std::memory_order_release);
+}
+
+// Fill level (approximate if called while the other thread is active)
+template <typename T>
+unsigned int WindowQueue<T>::size() const {
+	return writeCount_.load(std::memory_order_acquire) - readCount_.load(std::memory_order_acquire);
+}
+
+template class WindowQueue<float>;
@@ -0,0 +1,52 @@
+/***** WindowQueue.h *****/
+/* Class implementation of a wait-free single-producer/single-consumer
+ * queue of fixed-size sample windows, used to hand FFT windows from the
+ * audio thread to the analysis worker
+ *
+ * ECS7012P - Queen Mary University of London
+ * Final project, Max Tamussino
+ */
+
+#pragma once
+#include <atomic>
+#include <vector>
+
+template <typename T>
+class WindowQueue {
+public:
+	// Constructor, the sizes may also be given at setup
+	WindowQueue(unsigned int _numWindows = 0, unsigned int _windowLength = 0);
+	
+	// Setup (NOT REAL-TIME SAFE, must be called before any thread uses the queue)
+	void setup();
+	void setup(unsigned int _numWindows, unsigned int _windowLength);
+	
+	// Producer: get the next free window (nullptr if the queue is full),
+	// fill it and publish it with push()
+	T* get_write_window();
+	void push();
+	
+	// Consumer: get the oldest published window (nullptr if the queue is
+	// empty), read it and release it with pop()
+	const T* get_read_window();
+	void pop();
+	
+	// Number of published windows which have not been popped yet
+	unsigned int size() const;
+	unsigned int window_length() const { return windowLength_; }
+	
+	// Destructor
+	~WindowQueue() {}
+	
+private:
+	// Info
+	unsigned int numWindows_, windowLength_;
+	
+	// Windows stored one after the other
+	std::vector<T> buffer_;
+	
+	// Monotonic counters of pushed and popped windows, each written by one
+	// thread only and kept on separate cache lines
+	alignas(64) std::atomic<unsigned int> writeCount_;
+	alignas(64) std::atomic<unsigned int> readCount_;
+};
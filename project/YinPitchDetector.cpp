@@ -0,0 +1,72 @@
+/***** YinPitchDetector.cpp *****/
+/* Fundamental detection with YIN
+ *
+ * ECS7012P - Queen Mary University of London
+ * Final project, Max Tamussino
+ */
+
+#include <vector>
+#include "YinPitchDetector.h"
+
+// Allocate the scratch memory (NOT REAL-TIME SAFE, use at beginning)
+bool YinPitchDetector::setup(unsigned int fftSize) {
+	integrationLength_ = fftSize / 2;
+	correlator_.setup(fftSize);
+	correlation_.resize(fftSize - integrationLength_);
+	energy_.resize(fftSize + 1);
+	difference_.resize(fftSize - integrationLength_);
+	normalised_.resize(fftSize - integrationLength_);
+	return true;
+}
+
+float YinPitchDetector::detect(const PitchInput& input) {
+	const float *x = input.window;
+	const unsigned int W = integrationLength_;
+	const unsigned int maxLag = input.fftSize - W;
+	
+	// r(tau) of the first half of the window with the whole window
+	correlator_.correlate(*input.fft, x, W, correlation_.data());
+	
+	// Running sum of squares, for the energy of any W samples
+	energy_[0] = 0;
+	for (unsigned int j = 0; j < input.fftSize; j++) energy_[j + 1] = energy_[j] + x[j] * x[j];
+	if (energy_[W] <= 0) return 0;
+	
+	// Difference d(tau) = e(0) + e(tau) - 2 r(tau), normalised by its
+	// cumulative mean
+	difference_[0] = 0;
+	normalised_[0] = 1;
+	double runningSum = 0;
+	for (unsigned int tau = 1; tau < maxLag; tau++) {
+		double d = energy_[W] + (energy_[tau + W] - energy_[tau]) - 2.0 * correlation_[tau];
+		if (d < 0) d = 0;
+		runningSum += d;
+		difference_[tau] = d;
+		normalised_[tau] = runningSum > 0 ? d * tau / runningSum : 1;
+	}
+	
+	// First dip below the threshold, followed down to its minimum.
+	// Without one, the global minimum is used.
+	unsigned int bestTau = 0;
+	for (unsigned int tau = 2; tau < maxLag; tau++) {
+		if (normalised_[tau] < kThreshold) {
+			while (tau + 1 < maxLag && normalised_[tau + 1] < normalised_[tau]) tau++;
+			bestTau = tau;
+			break;
+		}
+	}
+	if (bestTau == 0) {
+		bestTau = 2;
+		for (unsigned int tau = 3; tau < maxLag; tau++) {
+			if (normalised_[tau] < normalised_[bestTau]) bestTau = tau;
+		}
+	}
+	
+	// Parabolic interpolation of the minimum of d(tau) (same vertex formula
+	// as for a maximum)
+	float period = bestTau;
+	if (bestTau + 1 < maxLag) {
+		period += parabolic_offset(difference_[bestTau - 1], difference_[bestTau], difference_[bestTau + 1]);
+	}
+	return input.sampleRate / period;
+}
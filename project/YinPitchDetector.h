@@ -0,0 +1,41 @@
+/***** YinPitchDetector.h *****/
+/* Fundamental detection with YIN (de Cheveigné and Kawahara, 2002): the
+ * cumulative mean normalised difference function of the window, with the
+ * correlation term calculated by the shared FFT
+ *
+ * ECS7012P - Queen Mary University of London
+ * Final project, Max Tamussino
+ */
+
+#pragma once
+#include <vector>
+#include "PitchDetector.h"
+
+class YinPitchDetector : public PitchDetector {
+public:
+	// Constructor
+	YinPitchDetector() {}
+	
+	// Setup (NOT REAL-TIME SAFE)
+	bool setup(unsigned int fftSize) override;
+	Type type() const override { return kYin; }
+	bool time_domain() const override { return true; }
+	
+	// Absolute threshold on the normalised difference
+	static constexpr float kThreshold = 0.12;
+	
+	// Destructor
+	~YinPitchDetector() {}
+	
+protected:
+	float detect(const PitchInput& input) override;
+	
+private:
+	FftCorrelator correlator_;
+	unsigned int integrationLength_ = 0;	// W, half of the window
+	
+	std::vector<float> correlation_;	// r(tau)
+	std::vector<double> energy_;		// Running sum of the squared samples
+	std::vector<float> difference_;		// Difference d(tau)
+	std::vector<float> normalised_;		// Normalised difference d'(tau)
+};
@@ -11,34 +11,101 @@ C++ Real-Time Audio Programming with Bela - Lecture 17: Block-based processing
 fft-circular-buffer: show spectrum of signal from overlapping FFT windows
 */
 
+#include <atomic>
 #include <cmath>
 #include <cstring>
 #include <vector>
 
 #include <Bela.h>
-#include <libraries/Fft/Fft.h>
 #include <libraries/Gui/Gui.h>
-#include <libraries/math_neon/math_neon.h>
 
 #include "MonoFilePlayer.h"
-#include "CircularBuffer.h"
-#include "CircularBufferStaticReturn.h"
+#include "MultiChannelAnalyzer.h"
+#include "SpectrumAnalyzer.h"
+#include "SpectrumEncoder.h"
+#include "StageTiming.h"
 
 // System parameters
-#define DETECT_DOMINANT_IS_HARMONIC true
-#define USE_WAV_FILE false
+const bool kUseWavFile = false;	// Analyse the sound file instead of the input
+const bool kStreamWavFile = true;	// Read the sound file from disk while it plays, instead of loading all of it
+const float kWavFileSampleRate = 44100;	// Sample rate of the sound file
+const float kWavFileDetuneCents = 0;	// Pitch shift of the sound file, to test the tuning display
+const unsigned int kMaxInputChannels = 6;	// Input channels analysed (fewer if the board has fewer)
 
-// FFT-related variables
-const int kDownsample = 16;  // Downsampling factor before FFT
-Fft gFft;					// FFT processing object
-const int kFftSize = 2048;	// FFT window size in samples
-const int kHopSize = 512;	// How often we calculate a window
+// Spectrum and pitch analysis (multi-rate pyramid, FFT per octave band,
+// fundamental detection), see SpectrumAnalyzer.h for the rates and sizes
+const unsigned int kNumLevels = 6;	// Octave bands of the pyramid
+const unsigned int kLevelFftSize = 256;	// FFT size of every level, can be changed on the GUI
+const unsigned int kHopSize = 8192;	// Input samples between two analyses, can be changed on the GUI
+const SpectrumStage::Window kWindow = SpectrumStage::kWindowHann;	// FFT window
+const PitchDetector::Type kDetector = PitchDetector::kHarmonic;	// Harmonic, HPS, YIN or McLeod, can be changed on the GUI
+const bool kPhaseRefinement = true;	// Refine the fundamental by the phase of its bins
+const unsigned int kMaxVoices = 4;	// Polyphonic mode: most notes shown per hop, 0 for off
 
-// Circular buffer for assembling a window of samples
-const int kBufferSize = 16384;
-CircularBufferStaticReturn<float> gInputBuffer(kBufferSize, kFftSize);
-std::vector<float> gUnwrappedBuffer(kFftSize);
-int gHopCounter = 0;
+// One analyzer per input channel, with the hops staggered across the
+// channels. Each is replaced by a new one when the GUI changes the analysis
+// settings (see AnalyzerSlot.h), every worker holds them under its own
+// reader number.
+MultiChannelAnalyzer gAnalyzers;
+const unsigned int kAnalysisReader = 0;
+const unsigned int kTuningReader = 1;
+
+// Channel whose spectrum and tuning are shown on the GUI, chosen there
+std::atomic<unsigned int> gDisplayChannel(0);
+
+// Fundamental frequency and MIDI note of every channel, sent to the GUI
+// after each analysis
+std::vector<float> gChannelResults;
+
+// Level and onset gate: no FFT in silence, only every few hops during a
+// steady note, dense hops after an onset (see AnalysisGate.h)
+const bool kGateEnabled = true;
+const float kGateSilenceDb = -60.0;	// Input level below which the last result is held [dBFS]
+const float kGateOnsetDb = 9.0;	// Rise of the band energies that counts as an onset [dB]
+const unsigned int kGateSustainHopInterval = 4;	// Every how many hops a steady note is analysed
+
+// Spectrum frames to the GUI: range and resolution of the display, dB
+// quantisation and frame rate limit (see SpectrumEncoder.h)
+const float kGuiMinFrequency = 20.0;	// Lowest frequency the GUI can show [Hz]
+const float kGuiMaxFrequency = 5000.0;	// Highest frequency the GUI can show [Hz]
+const unsigned int kGuiBinsPerOctave = 24;	// Must divide SpectrumAnalyzer::kLogBinsPerOctave
+const SpectrumEncoder::Encoding kGuiEncoding = SpectrumEncoder::kEncodingInt8;
+const float kGuiMaxFrameRate = 10.0;	// Frames per second
+SpectrumEncoder gSpectrumEncoder;
+
+// Channel and analyzer (swap count of its slot) the last frame was encoded
+// from: the time of a new analyzer starts at 0, so the rate limit restarts
+unsigned int gEncodedChannel = 0;
+unsigned int gEncodedSwaps = 0;
+
+// Tuning bank: off, tune to kTuningReference, or follow the detected note
+const SpectrumAnalyzer::TuningMode kTuningMode = SpectrumAnalyzer::kTuningFollow;
+const float kTuningReference = 440.0;	// Reference frequency [Hz] for kTuningReference
+const unsigned int kTuningGuiInterval = 2048;	// Frames between two tuning updates to the GUI
+
+// Lower priority task running the FFT outside the audio thread
+AuxiliaryTask gAnalysisTask;
+
+#if STAGE_TIMING
+// Lowest priority task printing the per-stage timing every few seconds
+// (build with -DSTAGE_TIMING=1)
+const float kTimingDumpInterval = 10.0;	// Seconds between two dumps
+AuxiliaryTask gTimingTask;
+unsigned int gTimingDumpCounter = 0;
+#endif
+
+// Lower priority task sending the tuning bank results to the GUI
+AuxiliaryTask gTuningTask;
+unsigned int gTuningGuiCounter = 0;
+
+// Lowest priority task reading the analysis settings from the GUI and
+// setting up a new analyzer when they change
+const float kReconfigureInterval = 0.5;	// Seconds between two checks
+AuxiliaryTask gReconfigureTask;
+unsigned int gReconfigureCounter = 0;
+
+// Block of samples of the sound file handed to the analyzer
+std::vector<float> gInputBlock;
 
 // Name of the sound file (in project folder)
 std::string gFilename = "guitar-c3.wav"; 
@@ -50,173 +117,249 @@ MonoFilePlayer gPlayer;
 Gui gSpectrumGui;
 
 
-bool setup(BelaContext *context, void *userData)
+// Analysis worker: analyse all queued windows of all channels and send the
+// results to the GUI, the spectrum only of the displayed channel
+void analysis_task(void *arg)
 {
-	#if USE_WAV_FILE
-	// Load the audio file
-	if(!gPlayer.setup(gFilename)) {
-    	rt_printf("Error loading audio file '%s'\n", gFilename.c_str());
-    	return false;
+	const unsigned int displayChannel = gDisplayChannel.load(std::memory_order_relaxed);
+	bool newResults = false;
+	for (unsigned int channel = 0; channel < gAnalyzers.num_channels(); channel++) {
+		SpectrumAnalyzer *analyzer = gAnalyzers.slot(channel).acquire(kAnalysisReader);
+		while (analyzer->analyse_next_window()) {
+			STAGE_TIMER(kStageGuiSend);
+			gChannelResults[2 * channel] = analyzer->fundamental_frequency();
+			gChannelResults[2 * channel + 1] = analyzer->midi_note_number();
+			newResults = true;
+			if (channel != displayChannel) continue;
+			
+			// Time of the hop, for the frame rate limit
+			const unsigned int swaps = gAnalyzers.slot(channel).swaps();
+			if (channel != gEncodedChannel || swaps != gEncodedSwaps) {
+				gSpectrumEncoder.reset();
+				gEncodedChannel = channel;
+				gEncodedSwaps = swaps;
+			}
+			if (gSpectrumEncoder.encode(analyzer->spectrum().data(), analyzer->window_end_time())) {
+				gSpectrumGui.sendBuffer(0, gSpectrumEncoder.frame().data(), gSpectrumEncoder.frame().size());
+			}
+			gSpectrumGui.sendBuffer(1, analyzer->fundamental_frequency());
+			gSpectrumGui.sendBuffer(2, analyzer->midi_note_number());
+			
+			// MIDI notes of the polyphonic mode, strongest first, 0 for none
+			if (kMaxVoices > 0) {
+				float voices[kMaxVoices > 0 ? kMaxVoices : 1] = {0};
+				for (unsigned int v = 0; v < analyzer->voices().size() && v < kMaxVoices; v++) {
+					voices[v] = analyzer->voices()[v].midiNote;
+				}
+				gSpectrumGui.sendBuffer(5, voices, kMaxVoices);
+			}
+		}
+		gAnalyzers.slot(channel).release(kAnalysisReader);
 	}
+	if (newResults) gSpectrumGui.sendBuffer(4, gChannelResults.data(), gChannelResults.size());
+}
+
+// Tuning worker: send target frequency, deviation in cents and lock state
+// of the displayed channel
+void tuning_task(void *arg)
+{
+	AnalyzerSlot& slot = gAnalyzers.slot(gDisplayChannel.load(std::memory_order_relaxed));
+	SpectrumAnalyzer *analyzer = slot.acquire(kTuningReader);
+	float tuning[3] = {analyzer->tuning_target(), analyzer->tuning_cents(), analyzer->tuning_locked() ? 1.0f : 0.0f};
+	slot.release(kTuningReader);
+	gSpectrumGui.sendBuffer(3, tuning, 3);
+}
 
-	// Print some useful info
-    rt_printf("Loaded the audio file '%s' with %d frames (%.1f seconds)\n", 
-    			gFilename.c_str(), gPlayer.size(),
-    			gPlayer.size() / context->audioSampleRate);
-    #endif
+// Reconfiguration worker: FFT size, hop size, detector and displayed
+// channel as last set on the GUI (all 0 until the first time)
+void reconfigure_task(void *arg)
+{
+	gAnalyzers.collect();
 	
-	// Set up the FFT and its input buffer
-	gFft.setup(kFftSize);
-	gInputBuffer.setup();
+	const float *settings = gSpectrumGui.getDataBuffer(0).getAsFloat();
+	if (settings[0] <= 0) return;
+	unsigned int displayChannel = settings[3] > 0 ? settings[3] : 0;
+	if (displayChannel >= gAnalyzers.num_channels()) displayChannel = gAnalyzers.num_channels() - 1;
+	gDisplayChannel.store(displayChannel, std::memory_order_relaxed);
 	
-	// GUI to show the spectrum
-	gSpectrumGui.setup(context->projectName);
-
-	return true;
+	const SpectrumAnalyzer::Config& current = gAnalyzers.config();
+	unsigned int fftSize = settings[0], hopSize = settings[1];
+	int detector = settings[2];
+	if (fftSize == current.levelFftSize && hopSize == current.hopSize && detector == current.detector) return;
+	
+	SpectrumAnalyzer::Config config = current;
+	config.levelFftSize = fftSize;
+	config.hopSize = hopSize;
+	config.detector = (PitchDetector::Type)detector;
+	if (detector < 0 || detector >= PitchDetector::kNumTypes || !gAnalyzers.reconfigure(config)) {
+		rt_printf("Invalid analysis settings: %u point FFT, hop of %u, detector %d\n", fftSize, hopSize, detector);
+		return;
+	}
+	rt_printf("Analysis set to %u point FFTs, hop of %u, %s detector\n", config.levelFftSize, config.hopSize,
+		PitchDetector::type_name(config.detector));
 }
 
-
-// This function is used to find local maxima at multiples of an index in a given vector.
-// More specifically for this project, this function is used to find local maxima in
-// the spectrum at multiples of the dominant frequency in order to determine if the 
-// dominant frequency is actually a harmonic
-unsigned int findMaximumAroundIndex(std::vector<float> *vec, unsigned int idx, float divisor, float deviation) {
-	// Define search area
-	int minIdx = floor((1.0 - deviation) / divisor * idx);
-	int maxIdx = ceil((1.0 + deviation) / divisor * idx);
-	
-	// Limit to array bounds
-	if (minIdx < 0) minIdx = 0;
-	if (maxIdx > (*vec).size()) maxIdx = (*vec).size();
-	
-	// Initialise maximum
-	float current, maximum = 0.0;
-	unsigned int maximumIdx;
-	
-	// Search
-	for (int i = minIdx; i < maxIdx; i++) {
-		current = (*vec)[i];
-		if (current > maximum) {
-			maximum = current;
-			maximumIdx = i;
-		}
-	}
-	
-	return maximumIdx;
+#if STAGE_TIMING
+// Timing worker: print min/mean/p99/max of every stage
+void timing_task(void *arg)
+{
+	print_stage_timing();
 }
+#endif
 
 
-// This function handles the FFT processing in this example once the buffer has
-// been assembled.
-void process_fft(float sampleRate)
+bool setup(BelaContext *context, void *userData)
 {
-	static std::vector<float> fftCurrentOut(kFftSize / 2);	// Current FFT energy
-	static float dominantMag;
-	static unsigned int dominantFreqIdx, fundamentalFreqIdx;
-	
-	// Process the FFT based on the time domain input
-	gFft.fft(gUnwrappedBuffer);
-		
-	// Copy the lower half of the FFT bins to a buffer and find the global maximum
-	dominantMag = 0;
-	float current;
-	for (int n = 0; n < kFftSize / 2; n++) {
-		current = gFft.fda(n);
-		fftCurrentOut[n] = current;
-		if (current > dominantMag) {
-			dominantMag = current;
-			dominantFreqIdx = n;
+	if (kUseWavFile) {
+		// Load the audio file, or only its start if it is streamed
+		bool loaded = kStreamWavFile ? gPlayer.setupStreaming(gFilename) : gPlayer.setup(gFilename);
+		if(!loaded) {
+			rt_printf("Error loading audio file '%s'\n", gFilename.c_str());
+			return false;
+		}
+
+		// Play it at its own rate and shifted in pitch
+		float rate = kWavFileSampleRate / context->audioSampleRate * powf(2, kWavFileDetuneCents / 1200);
+		if(!gPlayer.setPlaybackRate(rate)) {
+			rt_printf("Error setting the playback rate %f of the audio file\n", rate);
+			return false;
 		}
+		
+		// Print some useful info
+		rt_printf("Loaded the audio file '%s' with %d frames (%.1f seconds)\n", 
+				gFilename.c_str(), gPlayer.size(),
+				gPlayer.size() / context->audioSampleRate);
 	}
 	
-	// Check if the dominant frequency is actually a harmonic
-	#if DETECT_DOMINANT_IS_HARMONIC
-	
-	// Check if maximum is actually second harmonic
-	bool dominantFreqIsSecondHarmonic = false;
-	unsigned int halfFreqMaxIdx = findMaximumAroundIndex(&fftCurrentOut, dominantFreqIdx, 2.0, 0.03);
-	if (fftCurrentOut[halfFreqMaxIdx] > 0.7 * dominantMag) {
-		dominantFreqIsSecondHarmonic = true;
-		fundamentalFreqIdx = halfFreqMaxIdx;
+	// Set up the analyzer and the input block
+	SpectrumAnalyzer::Config config;
+	config.numLevels = kNumLevels;
+	config.levelFftSize = kLevelFftSize;
+	config.hopSize = kHopSize;
+	config.window = kWindow;
+	config.detector = kDetector;
+	config.phaseRefinement = kPhaseRefinement;
+	config.maxVoices = kMaxVoices;
+	config.gate.enabled = kGateEnabled;
+	config.gate.silenceDb = kGateSilenceDb;
+	config.gate.onsetDb = kGateOnsetDb;
+	config.gate.sustainHopInterval = kGateSustainHopInterval;
+	config.tuningMode = kTuningMode;
+	config.tuningReference = kTuningReference;
+	unsigned int numChannels = kUseWavFile ? 1 : context->audioInChannels;
+	if (numChannels > kMaxInputChannels) numChannels = kMaxInputChannels;
+	if (!gAnalyzers.setup(context->audioSampleRate, context->audioFrames, numChannels, config)) {
+		rt_printf("Error setting up the spectrum analyzer\n");
+		return false;
 	}
+	gChannelResults.assign(2 * numChannels, 0);
+	rt_printf("Analysing %u input channels\n", numChannels);
+	gInputBlock.resize(context->audioFrames);
 	
-	// Check if maximum is actually third harmonic
-	bool dominantFreqIsThirdHarmonic = false;
-	unsigned int thirdFreqMaxIdx = findMaximumAroundIndex(&fftCurrentOut, dominantFreqIdx, 3.0, 0.03);
-	if (fftCurrentOut[thirdFreqMaxIdx] > 0.7 * dominantMag) {
-		dominantFreqIsThirdHarmonic = true;
-		fundamentalFreqIdx = thirdFreqMaxIdx;
+	// Compact spectrum frames for the GUI
+	if (!gSpectrumEncoder.setup(SpectrumAnalyzer::kNumLogBins, SpectrumAnalyzer::kLogMinFrequency,
+								SpectrumAnalyzer::kLogBinsPerOctave, kGuiMinFrequency, kGuiMaxFrequency,
+								kGuiBinsPerOctave, kGuiEncoding, kGuiMaxFrameRate)) {
+		rt_printf("Error setting up the spectrum encoder\n");
+		return false;
 	}
 	
-	// If the dominant frequency is discovered to be either both or neither 
-	// a second and third harmonic, the index is invalid and the same will
-	// be sent twice for dominant and suspected fundamental
-	if (dominantFreqIsSecondHarmonic == dominantFreqIsThirdHarmonic) {
-		fundamentalFreqIdx = dominantFreqIdx;
-	}
+	// Analysis worker, scheduled whenever a window has been queued
+	gAnalysisTask = Bela_createAuxiliaryTask(analysis_task, BELA_AUDIO_PRIORITY - 10, "analysis-task");
 	
-	// Dont check if the dominant frequency is actually a harmonic
-	#else
-	fundamentalFreqIdx = dominantFreqIdx;
-	#endif
+	// Tuning worker, scheduled at a fixed rate if the tuning bank is on
+	gTuningTask = Bela_createAuxiliaryTask(tuning_task, BELA_AUDIO_PRIORITY - 20, "tuning-task");
 	
-	// Calculate accurate frequency using parabolic interpolation
-	// Get maximum and its neighbours
-	float left =   fftCurrentOut[fundamentalFreqIdx-1];
-	float middle = fftCurrentOut[fundamentalFreqIdx];
-	float right =  fftCurrentOut[fundamentalFreqIdx+1];
+	// Reconfiguration worker, allocating at the lowest priority
+	gReconfigureTask = Bela_createAuxiliaryTask(reconfigure_task, 0, "reconfigure-task");
 	
-	// Calculate frequency deviation from bin
-	float deltaFreq = (right - left) / (2 * (2 * middle - left - right));
-	
-	// Convert index + deviation to frequency
-	float fundamentalFreq = (fundamentalFreqIdx + deltaFreq) * sampleRate / (kFftSize * kDownsample);
+	#if STAGE_TIMING
+	// Timing worker, at the lowest priority
+	gTimingTask = Bela_createAuxiliaryTask(timing_task, 0, "timing-task");
+	#endif
 	
-	// Calculate MIDI note number (log2(x) is ln(x)/ln(2))
-	float midiNoteNumber = 12.0 / M_LN2 * logf_neon(fundamentalFreq / 440.0) + 69.0;
+	// GUI to show the spectrum
+	gSpectrumGui.setup(context->projectName);
 	
-	// Send the values to the GUI
-	gSpectrumGui.sendBuffer(0, fftCurrentOut);
-	gSpectrumGui.sendBuffer(1, fundamentalFreq);
-	gSpectrumGui.sendBuffer(2, midiNoteNumber);
+	// Analysis settings from the GUI: FFT size, hop size, detector and
+	// displayed channel
+	gSpectrumGui.setBuffer('f', 4);
+
+	return true;
 }
 
 
 void render(BelaContext *context, void *userData)
 {
-	for(unsigned int n = 0; n < context->audioFrames; n++) {
-		// Read the next sample from the wav-file buffer
-		#if USE_WAV_FILE
-        float in = gPlayer.process();
-        
-        // Read microphone input
-        #else
-        float in = audioRead(context, n, 0);
-        #endif
-        
-        // Downsampling
-        if (n % kDownsample == 0) {
-			// Store the sample in input buffer for the FFT
-			gInputBuffer.write_element(in);
-			
-			// Increment the hop counter and start a new FFT if we've reached the hop size
-			if (++gHopCounter == kHopSize) {
-				gUnwrappedBuffer = gInputBuffer.get_last_elements();
-				process_fft(context->audioSampleRate);
-				gHopCounter = 0;
-			}
-        }
+	STAGE_TIMER(kStageRender);
+	
+	bool newWindow;
+	if (kUseWavFile) {
+		// Read the next block from the wav-file buffer
+		gPlayer.processBlock(gInputBlock.data(), context->audioFrames);
 		
-		// Write the audio to the output if file is played
-		#if USE_WAV_FILE
-		for(unsigned int channel = 0; channel < context->audioOutChannels; channel++) {
-			audioWrite(context, n, channel, in);
+		// Write the audio to the output as the file is played
+		for(unsigned int n = 0; n < context->audioFrames; n++) {
+			for(unsigned int channel = 0; channel < context->audioOutChannels; channel++) {
+				audioWrite(context, n, channel, gInputBlock[n]);
+			}
+		}
+		newWindow = gAnalyzers.process_block(gInputBlock.data(), context->audioFrames, 1, false);
+	} else {
+		// All input channels at once, split into one block per channel
+		newWindow = gAnalyzers.process_block(context->audioIn, context->audioFrames, context->audioInChannels,
+											 context->flags & BELA_FLAG_INTERLEAVED);
+	}
+	
+	// Wake up the worker if a window is ready. Newly configured analyzers
+	// are swapped in by process_block().
+	if (newWindow) Bela_scheduleAuxiliaryTask(gAnalysisTask);
+	
+	// Update the tuning display much faster than the hops
+	if (kTuningMode != SpectrumAnalyzer::kTuningOff) {
+		gTuningGuiCounter += context->audioFrames;
+		if (gTuningGuiCounter >= kTuningGuiInterval) {
+			gTuningGuiCounter = 0;
+			Bela_scheduleAuxiliaryTask(gTuningTask);
 		}
-		#endif
 	}
+	
+	// Check the analysis settings of the GUI
+	gReconfigureCounter += context->audioFrames;
+	if (gReconfigureCounter >= kReconfigureInterval * context->audioSampleRate) {
+		gReconfigureCounter = 0;
+		Bela_scheduleAuxiliaryTask(gReconfigureTask);
+	}
+	
+	#if STAGE_TIMING
+	gTimingDumpCounter += context->audioFrames;
+	if (gTimingDumpCounter >= kTimingDumpInterval * context->audioSampleRate) {
+		gTimingDumpCounter = 0;
+		Bela_scheduleAuxiliaryTask(gTimingTask);
+	}
+	#endif
 }
 
 void cleanup(BelaContext *context, void *userData)
 {
-
+	// Report how well the worker kept up with the last configuration
+	for (unsigned int channel = 0; channel < gAnalyzers.num_channels(); channel++) {
+		const SpectrumAnalyzer *analyzer = gAnalyzers.slot(channel).audio_analyzer();
+		rt_printf("Channel %u: %u windows analysed, %u dropped, %u late, %u gated, %u skipped while tuned (%.0f%% of %u hops skipped)\n",
+			channel, analyzer->hop_count(), analyzer->dropped_windows(), analyzer->late_windows(),
+			analyzer->gated_hops(), analyzer->skipped_hops(), 100.0 * analyzer->skipped_fraction(),
+			analyzer->total_hops());
+	}
+	rt_printf("Analyzers reconfigured %u times\n", gAnalyzers.slot(0).swaps());
+	if (kUseWavFile && kStreamWavFile) {
+		rt_printf("Sound file streamed with %u samples in memory, %u underruns (%u samples)\n",
+			gPlayer.memorySize(), gPlayer.underruns(), gPlayer.underrunFrames());
+	}
+	
+	#if STAGE_TIMING
+	// Time spent in every stage, to compare with the block duration
+	rt_printf("Render budget: %.1f us per block of %u frames\n",
+		1e6 * context->audioFrames / context->audioSampleRate, context->audioFrames);
+	print_stage_timing();
+	#endif
 }
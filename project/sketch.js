@@ -16,13 +16,17 @@ C++ Real-Time Audio Programming with Bela - Lecture 17: Block-based processing
 // a number of additional features and controls.
 
 var guiSketch = new p5(function( p ) {
-	// Global variables
-	const sampleRate = 44100 / 16;
+	// Global variables: version of the spectrum frames (see SpectrumEncoder.h)
+	const spectrumFrameVersion = 1;
 	const textLineDistance = 30;
 	
 	// Holding paused info
 	var graphPaused = false;
-	var spectrumBuffer, detectedFundamentalFreq, detectedFundamentalMIDI;
+	var spectrumDb = [], detectedFundamentalFreq, detectedFundamentalMIDI;
+	var channelResults = [], polyphonicNotes = [];
+	
+	// Log-frequency grid of the last spectrum frame
+	var spectrumFirstFrequency = 20, spectrumBinsPerOctave = 24;
 		
 	// Graph position
 	const graphStartX = p.windowWidth  * 0.1;
@@ -32,19 +36,28 @@ var guiSketch = new p5(function( p ) {
 	const graphLengthX = graphEndX - graphStartX;
 	const graphLengthY = graphEndY - graphStartY;
 	
-	// Settings
-	const settingsSectionTitles = ["Frequency", "Magnitude"];
+	// Settings. The analysis section is sent to render.cpp, which sets up
+	// new analyzers with it: FFT size (power of two), hop size (multiple of
+	// 128), detector (0 harmonic, 1 HPS, 2 YIN, 3 McLeod) and the input
+	// channel whose spectrum and tuning are shown (from 0)
+	const settingsSectionTitles = ["Frequency", "Magnitude", "Analysis"];
 	const settingsTitles = [["Min", "Max", "Steps"],
-						    ["Min", "Max", "Steps"]];
-	const settingsMins = [[0, 0, 1],
-						  [-50, -30, 1]];
-	const settingsMaxs = [[20000, 20000, 20],
-						  [30, 50, 10]];
-	const settingsStd = [[0, 1000, 10],
-						  [-20, 40, 6]];
-	var   settingsCurr = [[0, 1000, 10],
-						  [-20, 40, 6]];
-	var   settingsInputs = [[],[]];
+						    ["Min", "Max", "Steps"],
+						    ["FFT", "Hop", "Detector", "Channel"]];
+	const settingsMins = [[20, 40, 1],
+						  [-120, -80, 1],
+						  [64, 1024, 0, 0]];
+	const settingsMaxs = [[2500, 5000, 20],
+						  [-20, 20, 10],
+						  [1024, 65536, 3, 7]];
+	const settingsStd = [[25, 5000, 8],
+						  [-90, 0, 6],
+						  [256, 8192, 0, 0]];
+	var   settingsCurr = [[25, 5000, 8],
+						  [-90, 0, 6],
+						  [256, 8192, 0, 0]];
+	var   settingsInputs = [[],[],[]];
+	const analysisSection = 2;
 	
 	// Settings section parameters
 	const settingsStartX = graphStartX;
@@ -54,7 +67,7 @@ var guiSketch = new p5(function( p ) {
 	const settingsTextLen = 0;
 	
 	// Results section parameters
-	const resultsStartX = graphStartX + 300;
+	const resultsStartX = graphStartX + 450;
 	const resultsStartY = graphEndY + 30;
 	
 	// Tuning section parameters
@@ -87,7 +100,7 @@ var guiSketch = new p5(function( p ) {
 		// Set button
 		button_set = p.createButton('Set');
 		button_set.position(xPos + 10 + button_reset.width, yPos);
-		button_set.mousePressed(set_all_settings);
+		button_set.mousePressed(function() { set_all_settings(false); });
 		
 		// Pause/resume button
 		button_pause = p.createButton('Pause/resume');
@@ -120,6 +133,11 @@ var guiSketch = new p5(function( p ) {
 		} else if (num > max) {
 			num = max;
 		}
+		
+		// Nearest FFT size and hop size the analyzer accepts
+		if (sec == analysisSection && set_idx == 0) num = Math.pow(2, Math.round(Math.log2(num)));
+		if (sec == analysisSection && set_idx == 1) num = Math.max(128, 128 * Math.round(num / 128));
+		settingsInputs[sec][set_idx].value(num);
 		settingsCurr[sec][set_idx] = num;
 	}
 	
@@ -138,13 +156,46 @@ var guiSketch = new p5(function( p ) {
 				}
 			}
 		}
+		
+		// Analysis settings to render.cpp
+		Bela.data.sendBuffer(0, 'float', settingsCurr[analysisSection]);
+	}
+	
+	function index_to_freq(index) {
+		// The spectrum is merged from several rates into a log-frequency grid,
+		// its start and resolution are given by the frame
+		return spectrumFirstFrequency * Math.pow(2, index / spectrumBinsPerOctave);
+	}
+	
+	function decode_spectrum_frame(buffer) {
+		// Bytes of the frame, whether it arrives as typed array or string
+		let bytes;
+		if (typeof buffer === "string") bytes = Uint8Array.from(buffer, c => c.charCodeAt(0));
+		else if (ArrayBuffer.isView(buffer)) bytes = new Uint8Array(buffer.buffer, buffer.byteOffset, buffer.byteLength);
+		else bytes = Uint8Array.from(buffer);
+		if (bytes.length < 16 || bytes[0] != spectrumFrameVersion) return false;
+		
+		// Header (little endian), then the quantised dB values
+		const view = new DataView(bytes.buffer, bytes.byteOffset, bytes.byteLength);
+		const bytesPerValue = view.getUint8(1);
+		const numValues = view.getUint16(4, true);
+		if (bytes.length < 16 + numValues * bytesPerValue) return false;
+		spectrumBinsPerOctave = view.getUint16(6, true);
+		spectrumFirstFrequency = view.getUint32(8, true) / 1000;
+		const zeroDb = view.getInt16(12, true) / 100;
+		const stepDb = view.getUint16(14, true) / 1000;
+		
+		spectrumDb = new Array(numValues);
+		for (let i = 0; i < numValues; i++) {
+			const value = bytesPerValue == 1 ? view.getInt8(16 + i) : view.getInt16(16 + 2 * i, true);
+			spectrumDb[i] = zeroDb + value * stepDb;
+		}
+		return true;
 	}
 	
-	function index_to_freq(index, fftsize) {
-		// For the parameter "fftsize", twice the number of received FFT bins
-		// have to be given. This is because only half of the obtained FFT amplitude
-		// results is unique, and only half is transmitted.
-		return index * sampleRate / fftsize;
+	function freq_to_rel(freq, freqMin, freqMax) {
+		// Relative position on the logarithmic frequency axis
+		return Math.log(freq / freqMin) / Math.log(freqMax / freqMin);
 	}
 	
 	function freq_to_text(freq) {
@@ -186,19 +237,30 @@ var guiSketch = new p5(function( p ) {
 			if(!buffers.length) return;
 			
 			// Get buffer infos
-			spectrumBuffer = buffers[0];
+			decode_spectrum_frame(buffers[0]);
 			detectedFundamentalFreq = parseFloat(buffers[1]);
 			detectedFundamentalMIDI = parseFloat(buffers[2]);
+			
+			// Tuning bank (target frequency, cents, locked), more precise
+			// and faster than the spectrum while it is locked onto a note
+			if (buffers.length > 3 && buffers[3][2] > 0) {
+				detectedFundamentalMIDI = 69 + 12 * Math.log2(buffers[3][0] / 440) + buffers[3][1] / 100;
+			}
+			
+			// Fundamental frequency and MIDI note of every input channel
+			if (buffers.length > 4) channelResults = buffers[4];
+			
+			// MIDI notes of the polyphonic mode, 0 for none
+			if (buffers.length > 5) polyphonicNotes = buffers[5];
 		}
 		
 		// Interpretation of the buffer info
-		const fftNumberOfBins = spectrumBuffer.length;
+		const fftNumberOfBins = spectrumDb.length;
 		
 		// Read settings
 		const freqMin = settingsCurr[0][0];
 		const freqMax = settingsCurr[0][1];
-		const freqRange = freqMax - freqMin;
-		const freqStep = freqRange / settingsCurr[0][2];
+		const freqSteps = settingsCurr[0][2];
 		const magMin = settingsCurr[1][0];
 		const magMax = settingsCurr[1][1];
 		const magRange = magMax - magMin;
@@ -235,7 +297,7 @@ var guiSketch = new p5(function( p ) {
 		p.push();
 		p.translate(-40, graphLengthY/2);
 		p.rotate(radians(270));
-		p.text("Magnitude [dB]", 0, 0);
+		p.text("Amplitude [dBFS]", 0, 0);
 		p.pop();
 		
 		if (graphPaused) {
@@ -249,15 +311,15 @@ var guiSketch = new p5(function( p ) {
 		p.noFill();
 		p.stroke(1,0,0);
 		p.beginShape();
-		for (let i = 0; i < fftNumberOfBins && i < spectrumBuffer.length; i++) {
+		for (let i = 0; i < fftNumberOfBins; i++) {
 			// X Position
-			let freqVal = index_to_freq(i, fftNumberOfBins * 2);
-			let xRel = (freqVal - freqMin) / freqRange;
+			let freqVal = index_to_freq(i);
+			let xRel = freq_to_rel(freqVal, freqMin, freqMax);
 			if (xRel < 0) continue; // Below minimum, try next point
 			if (xRel > 1) break;    // Above maximum, end graph
 			
 			// Y Position
-			let magVal = 20*(Math.log10(spectrumBuffer[i]));
+			let magVal = spectrumDb[i];
 			let yRel = (magMax - magVal) / magRange;
 			if (yRel < 0) yRel = 0;
 			if (yRel > 1) yRel = 1;
@@ -290,14 +352,17 @@ var guiSketch = new p5(function( p ) {
 		p.textAlign(CENTER);
 		p.stroke(0, 0, 0, 1);
 		p.strokeWeight(0.2);
-		let xPosFundamental = graphLengthX * (detectedFundamentalFreq - freqMin) / freqRange;
-		p.line(xPosFundamental, 0, xPosFundamental, graphLengthY);
-		for(let freq = freqMin; freq <= freqMax; freq += freqStep)
+		if (detectedFundamentalFreq > 0) {
+			let xPosFundamental = graphLengthX * freq_to_rel(detectedFundamentalFreq, freqMin, freqMax);
+			p.line(xPosFundamental, 0, xPosFundamental, graphLengthY);
+		}
+		for(let step = 0; step <= freqSteps; step++)
 		{
-			// Draw line
+			// Draw line (equally spaced on the logarithmic axis)
+			let freq = freqMin * Math.pow(freqMax / freqMin, step / freqSteps);
 			p.stroke(0, 0, 0, 0.3);
 			p.strokeWeight(0.2);
-			let xPos = graphLengthX * (freq - freqMin) / freqRange;
+			let xPos = graphLengthX * step / freqSteps;
 			p.line(xPos, 0, xPos, graphLengthY);
 			
 			// Draw label
@@ -358,6 +423,29 @@ var guiSketch = new p5(function( p ) {
 		
 		p.translate(0, textLineDistance);
 		p.text("MIDI note: " + detectedFundamentalMIDI.toFixed(2), 0, 0);
+		
+		// Notes of the polyphonic mode, if it is on
+		if (polyphonicNotes.length > 0) {
+			let notesText = "";
+			for (let v = 0; v < polyphonicNotes.length; v++) {
+				if (polyphonicNotes[v] > 0) notesText += midi_to_text(Math.round(polyphonicNotes[v])) + " ";
+			}
+			p.translate(0, textLineDistance);
+			p.text("Notes: " + (notesText.length > 0 ? notesText : "-"), 0, 0);
+		}
+		
+		// Note and deviation of every channel, two to a line
+		p.textSize(12);
+		for (let channel = 0; 2 * channel + 1 < channelResults.length; channel++) {
+			if (channel % 2 == 0) p.translate(0, 0.6 * textLineDistance);
+			let midi = channelResults[2 * channel + 1];
+			let channelText = channel + ": -";
+			if (channelResults[2 * channel] > 0) {
+				let cents = Math.round(100 * (midi - Math.round(midi)));
+				channelText = channel + ": " + midi_to_text(Math.round(midi)) + " " + (cents >= 0 ? "+" : "") + cents;
+			}
+			p.text(channelText, (channel % 2) * 90, 0);
+		}
 		p.pop();
 		
 		